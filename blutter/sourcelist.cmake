@@ -1,4 +1,19 @@
 set(SRCS 
+    A64Decoder.cpp
+    A64Decoder.h
+    AnalysisCache.cpp
+    AnalysisCache.h
+    AnalysisDb.h
+    AnalysisDbWriter.cpp
+    AnalysisDbWriter.h
+    ArchiveWriter.cpp
+    ArchiveWriter.h
+    AsmIndex.cpp
+    AsmIndex.h
+    CallGraph.cpp
+    CallGraph.h
+    ClassHierarchy.cpp
+    ClassHierarchy.h
     CodeAnalyzer.cpp
     CodeAnalyzer.h
     CodeAnalyzer_arm64.cpp
@@ -17,6 +32,8 @@ set(SRCS
     DartLibrary.h
     DartLoader.cpp
     DartLoader.h
+    DartPool.cpp
+    DartPool.h
     DartStub.cpp
     DartStub.h
     DartThreadInfo.cpp
@@ -29,9 +46,21 @@ set(SRCS
     Disassembler_arm64.h
     ElfHelper.cpp
     ElfHelper.h
+    FieldXrefs.cpp
+    FieldXrefs.h
     FridaWriter.cpp
     FridaWriter.h
     HtArrayIterator.h
+    MappedFile.cpp
+    MappedFile.h
+    OutputManifest.cpp
+    OutputManifest.h
+    OutputSink.cpp
+    OutputSink.h
+    PackageSignatures.cpp
+    PackageSignatures.h
+    PoolXrefs.cpp
+    PoolXrefs.h
     Util.cpp
     Util.h
     VarValue.cpp
@@ -0,0 +1,468 @@
+#include "pch.h"
+#include "A64Decoder.h"
+#include <chrono>
+
+namespace A64 {
+
+#define REG_LIST(prefix) \
+	prefix##0, prefix##1, prefix##2, prefix##3, prefix##4, prefix##5, prefix##6, prefix##7, prefix##8, prefix##9, \
+	prefix##10, prefix##11, prefix##12, prefix##13, prefix##14, prefix##15, prefix##16, prefix##17, prefix##18, prefix##19, \
+	prefix##20, prefix##21, prefix##22, prefix##23, prefix##24, prefix##25, prefix##26, prefix##27, prefix##28, prefix##29, \
+	prefix##30
+
+static constexpr arm64_reg XRegs[] = { REG_LIST(ARM64_REG_X) };
+static constexpr arm64_reg WRegs[] = { REG_LIST(ARM64_REG_W) };
+static constexpr arm64_reg DRegs[] = { REG_LIST(ARM64_REG_D), ARM64_REG_D31 };
+static constexpr arm64_reg SRegs[] = { REG_LIST(ARM64_REG_S), ARM64_REG_S31 };
+#undef REG_LIST
+
+// general purpose register. register number 31 is SP or ZR depended on instruction
+static inline arm64_reg gpReg(uint32_t n, bool is64, bool isSp = false)
+{
+	if (n == 31) {
+		if (isSp)
+			return is64 ? ARM64_REG_SP : ARM64_REG_WSP;
+		return is64 ? ARM64_REG_XZR : ARM64_REG_WZR;
+	}
+	return is64 ? XRegs[n] : WRegs[n];
+}
+
+static inline cs_arm64_op& addReg(cs_arm64& detail, arm64_reg reg)
+{
+	auto& op = detail.operands[detail.op_count++];
+	op.type = ARM64_OP_REG;
+	op.reg = reg;
+	return op;
+}
+
+static inline cs_arm64_op& addImm(cs_arm64& detail, int64_t imm)
+{
+	auto& op = detail.operands[detail.op_count++];
+	op.type = ARM64_OP_IMM;
+	op.imm = imm;
+	return op;
+}
+
+static inline cs_arm64_op& addMem(cs_arm64& detail, arm64_reg base, arm64_reg index, int32_t disp)
+{
+	auto& op = detail.operands[detail.op_count++];
+	op.type = ARM64_OP_MEM;
+	op.mem.base = base;
+	op.mem.index = index;
+	op.mem.disp = disp;
+	return op;
+}
+
+// register of load/store data. return ARM64_REG_INVALID for unsupported size
+static inline arm64_reg ldstReg(uint32_t n, uint32_t size, bool isSimd)
+{
+	if (isSimd) {
+		if (size == 3)
+			return DRegs[n];
+		if (size == 2)
+			return SRegs[n];
+		return ARM64_REG_INVALID;
+	}
+	return gpReg(n, size == 3);
+}
+
+static inline unsigned int ldstId(uint32_t size, bool isSimd, bool isLoad, bool isUnscaled)
+{
+	if (isSimd || size >= 2) {
+		if (isUnscaled)
+			return isLoad ? ARM64_INS_LDUR : ARM64_INS_STUR;
+		return isLoad ? ARM64_INS_LDR : ARM64_INS_STR;
+	}
+	if (size == 0) {
+		if (isUnscaled)
+			return isLoad ? ARM64_INS_LDURB : ARM64_INS_STURB;
+		return isLoad ? ARM64_INS_LDRB : ARM64_INS_STRB;
+	}
+	if (isUnscaled)
+		return isLoad ? ARM64_INS_LDURH : ARM64_INS_STURH;
+	return isLoad ? ARM64_INS_LDRH : ARM64_INS_STRH;
+}
+
+// ldr/str Rt, [Xn, #imm]
+static unsigned int decodeLoadStoreUImm(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	const uint32_t size = code >> 30;
+	const bool isSimd = (code >> 26) & 1;
+	const uint32_t opc = (code >> 22) & 3;
+	// opc 2 and 3 are sign extended load, prefetch and 128 bits register
+	if (opc > 1)
+		return ARM64_INS_INVALID;
+	const auto rt = ldstReg(code & 31, size, isSimd);
+	if (rt == ARM64_REG_INVALID)
+		return ARM64_INS_INVALID;
+
+	const int32_t disp = ((code >> 10) & 0xfff) << size;
+	addReg(detail, rt);
+	addMem(detail, gpReg((code >> 5) & 31, true, true), ARM64_REG_INVALID, disp);
+	return ldstId(size, isSimd, opc == 1, false);
+}
+
+// ldur/stur Rt, [Xn, #simm] and ldr/str Rt, [Xn, #simm]!
+static unsigned int decodeLoadStoreSImm(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	const uint32_t size = code >> 30;
+	const bool isSimd = (code >> 26) & 1;
+	const uint32_t opc = (code >> 22) & 3;
+	const uint32_t idxType = (code >> 10) & 3;
+	// post index form has different operands between capstone versions. unprivileged form is never used.
+	if (opc > 1 || (idxType != 0 && idxType != 3))
+		return ARM64_INS_INVALID;
+	const auto rt = ldstReg(code & 31, size, isSimd);
+	if (rt == ARM64_REG_INVALID)
+		return ARM64_INS_INVALID;
+
+	const auto disp = (int32_t)SignExtend((code >> 12) & 0x1ff, 9);
+	addReg(detail, rt);
+	addMem(detail, gpReg((code >> 5) & 31, true, true), ARM64_REG_INVALID, disp);
+	if (idxType == 3)
+		detail.writeback = true;
+	return ldstId(size, isSimd, opc == 1, idxType == 0);
+}
+
+// ldr/str Rt, [Xn, Xm{, lsl #size}]
+static unsigned int decodeLoadStoreReg(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	const uint32_t size = code >> 30;
+	const bool isSimd = (code >> 26) & 1;
+	const uint32_t opc = (code >> 22) & 3;
+	const uint32_t option = (code >> 13) & 7;
+	const bool hasShift = (code >> 12) & 1;
+	// only 64 bits index register without extension. byte access with shift is printed differently.
+	if (opc > 1 || option != 3 || (hasShift && size == 0))
+		return ARM64_INS_INVALID;
+	const auto rt = ldstReg(code & 31, size, isSimd);
+	if (rt == ARM64_REG_INVALID)
+		return ARM64_INS_INVALID;
+
+	addReg(detail, rt);
+	auto& op = addMem(detail, gpReg((code >> 5) & 31, true, true), gpReg((code >> 16) & 31, true), 0);
+	if (hasShift) {
+		op.shift.type = ARM64_SFT_LSL;
+		op.shift.value = size;
+	}
+	return ldstId(size, isSimd, opc == 1, false);
+}
+
+// ldp/stp Rt, Rt2, [Xn, #imm]{!}
+static unsigned int decodeLoadStorePair(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	const uint32_t opc = code >> 30;
+	const bool isSimd = (code >> 26) & 1;
+	const bool isLoad = (code >> 22) & 1;
+	const bool isPreIndex = (code >> 23) & 1;
+	uint32_t scale;
+	arm64_reg rt, rt2;
+	if (isSimd) {
+		if (opc == 0) {
+			scale = 2;
+			rt = SRegs[code & 31];
+			rt2 = SRegs[(code >> 10) & 31];
+		}
+		else if (opc == 1) {
+			scale = 3;
+			rt = DRegs[code & 31];
+			rt2 = DRegs[(code >> 10) & 31];
+		}
+		else {
+			return ARM64_INS_INVALID;
+		}
+	}
+	else {
+		// opc 1 is ldpsw
+		if (opc != 0 && opc != 2)
+			return ARM64_INS_INVALID;
+		scale = opc == 2 ? 3 : 2;
+		rt = gpReg(code & 31, opc == 2);
+		rt2 = gpReg((code >> 10) & 31, opc == 2);
+	}
+
+	const auto disp = (int32_t)(SignExtend((code >> 15) & 0x7f, 7) * (1 << scale));
+	addReg(detail, rt);
+	addReg(detail, rt2);
+	addMem(detail, gpReg((code >> 5) & 31, true, true), ARM64_REG_INVALID, disp);
+	if (isPreIndex)
+		detail.writeback = true;
+	return isLoad ? ARM64_INS_LDP : ARM64_INS_STP;
+}
+
+// add/sub/adds/subs Rd, Rn, #imm{, lsl #12} and the mov/cmp/cmn aliases
+static unsigned int decodeAddSubImm(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	const bool is64 = code >> 31;
+	const bool isSub = (code >> 30) & 1;
+	const bool setFlags = (code >> 29) & 1;
+	const bool isShift = (code >> 22) & 1;
+	const uint32_t imm = (code >> 10) & 0xfff;
+	const uint32_t rn = (code >> 5) & 31;
+	const uint32_t rd = code & 31;
+	// 32 bits stack pointer is never used in Dart code
+	if (!is64 && (rn == 31 || rd == 31))
+		return ARM64_INS_INVALID;
+
+	if (!setFlags) {
+		if (!isSub && imm == 0 && !isShift && (rd == 31 || rn == 31)) {
+			addReg(detail, gpReg(rd, is64, true));
+			addReg(detail, gpReg(rn, is64, true));
+			return ARM64_INS_MOV;
+		}
+		addReg(detail, gpReg(rd, is64, true));
+	}
+	else {
+		detail.update_flags = true;
+		if (rd != 31)
+			addReg(detail, gpReg(rd, is64));
+	}
+	addReg(detail, gpReg(rn, is64, true));
+	auto& op = addImm(detail, imm);
+	if (isShift) {
+		op.shift.type = ARM64_SFT_LSL;
+		op.shift.value = 12;
+	}
+
+	if (setFlags && rd == 31)
+		return isSub ? ARM64_INS_CMP : ARM64_INS_CMN;
+	if (setFlags)
+		return isSub ? ARM64_INS_SUBS : ARM64_INS_ADDS;
+	return isSub ? ARM64_INS_SUB : ARM64_INS_ADD;
+}
+
+// add/sub/adds/subs Rd, Rn, Rm{, shift #amount} and the cmp/cmn aliases
+static unsigned int decodeAddSubShiftedReg(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	const bool is64 = code >> 31;
+	const bool isSub = (code >> 30) & 1;
+	const bool setFlags = (code >> 29) & 1;
+	const uint32_t shift = (code >> 22) & 3;
+	const uint32_t amount = (code >> 10) & 63;
+	const uint32_t rn = (code >> 5) & 31;
+	const uint32_t rd = code & 31;
+	// shift 3 is reserved. neg/negs aliases are not supported
+	if (shift == 3 || (!is64 && amount >= 32) || (isSub && rn == 31))
+		return ARM64_INS_INVALID;
+
+	if (setFlags)
+		detail.update_flags = true;
+	if (!setFlags || rd != 31)
+		addReg(detail, gpReg(rd, is64));
+	addReg(detail, gpReg(rn, is64));
+	auto& op = addReg(detail, gpReg((code >> 16) & 31, is64));
+	// capstone does not show "lsl #0"
+	if (shift != 0 || amount != 0) {
+		op.shift.type = shift == 0 ? ARM64_SFT_LSL : (shift == 1 ? ARM64_SFT_LSR : ARM64_SFT_ASR);
+		op.shift.value = amount;
+	}
+
+	if (setFlags && rd == 31)
+		return isSub ? ARM64_INS_CMP : ARM64_INS_CMN;
+	if (setFlags)
+		return isSub ? ARM64_INS_SUBS : ARM64_INS_ADDS;
+	return isSub ? ARM64_INS_SUB : ARM64_INS_ADD;
+}
+
+// movz/movk Rd, #imm{, lsl #shift}
+static unsigned int decodeMoveWide(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	const bool is64 = code >> 31;
+	const uint32_t opc = (code >> 29) & 3;
+	const uint32_t hw = (code >> 21) & 3;
+	const int64_t imm = (code >> 5) & 0xffff;
+	if (!is64 && hw >= 2)
+		return ARM64_INS_INVALID;
+
+	if (opc == 2) {
+		// the alias of movz with shifted immediate is different between capstone versions
+		if (hw != 0)
+			return ARM64_INS_INVALID;
+		addReg(detail, gpReg(code & 31, is64));
+		addImm(detail, imm);
+#if CS_API_MAJOR >= 5
+		return ARM64_INS_MOV;
+#else
+		return ARM64_INS_MOVZ;
+#endif
+	}
+	if (opc == 3) {
+		addReg(detail, gpReg(code & 31, is64));
+		auto& op = addImm(detail, imm);
+		if (hw != 0) {
+			op.shift.type = ARM64_SFT_LSL;
+			op.shift.value = hw * 16;
+		}
+		return ARM64_INS_MOVK;
+	}
+	// movn
+	return ARM64_INS_INVALID;
+}
+
+// mov Rd, Rm (alias of orr Rd, ZR, Rm)
+static unsigned int decodeMoveReg(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	const bool is64 = code >> 31;
+	addReg(detail, gpReg(code & 31, is64));
+	addReg(detail, gpReg((code >> 16) & 31, is64));
+	return ARM64_INS_MOV;
+}
+
+// b/bl label
+static unsigned int decodeBranchImm(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	addImm(detail, address + SignExtend(code & 0x3ffffff, 26) * 4);
+	return (code >> 31) ? ARM64_INS_BL : ARM64_INS_B;
+}
+
+// b.cond label
+static unsigned int decodeBranchCond(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	detail.cc = (arm64_cc)(ARM64_CC_EQ + (code & 15));
+	addImm(detail, address + SignExtend((code >> 5) & 0x7ffff, 19) * 4);
+	return ARM64_INS_B;
+}
+
+// cbz/cbnz Rt, label
+static unsigned int decodeCompareBranch(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	addReg(detail, gpReg(code & 31, code >> 31));
+	addImm(detail, address + SignExtend((code >> 5) & 0x7ffff, 19) * 4);
+	return ((code >> 24) & 1) ? ARM64_INS_CBNZ : ARM64_INS_CBZ;
+}
+
+// tbz/tbnz Rt, #bit, label
+static unsigned int decodeTestBranch(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	const uint32_t bit = ((code >> 26) & 0x20) | ((code >> 19) & 0x1f);
+	addReg(detail, gpReg(code & 31, bit >= 32));
+	addImm(detail, bit);
+	addImm(detail, address + SignExtend((code >> 5) & 0x3fff, 14) * 4);
+	return ((code >> 24) & 1) ? ARM64_INS_TBNZ : ARM64_INS_TBZ;
+}
+
+// br/blr Xn
+static unsigned int decodeBranchReg(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	addReg(detail, gpReg((code >> 5) & 31, true));
+	return ((code >> 21) & 1) ? ARM64_INS_BLR : ARM64_INS_BR;
+}
+
+struct DecodeEntry {
+	uint32_t mask;
+	uint32_t value;
+	unsigned int (*decode)(uint32_t code, uint64_t address, cs_arm64& detail);
+};
+
+// ordered by frequency in Dart AOT code
+static const DecodeEntry decodeTable[] = {
+	{ 0x3b200000, 0x38000000, decodeLoadStoreSImm },
+	{ 0x3b000000, 0x39000000, decodeLoadStoreUImm },
+	{ 0x7fe0ffe0, 0x2a0003e0, decodeMoveReg },
+	{ 0x1f800000, 0x11000000, decodeAddSubImm },
+	{ 0x7c000000, 0x14000000, decodeBranchImm },
+	{ 0x1f800000, 0x12800000, decodeMoveWide },
+	{ 0x3b800000, 0x29800000, decodeLoadStorePair }, // pre index
+	{ 0x3b800000, 0x29000000, decodeLoadStorePair }, // signed offset
+	{ 0xff000010, 0x54000000, decodeBranchCond },
+	{ 0x7e000000, 0x36000000, decodeTestBranch },
+	{ 0x7e000000, 0x34000000, decodeCompareBranch },
+	{ 0x1f200000, 0x0b000000, decodeAddSubShiftedReg },
+	{ 0x3b200c00, 0x38200800, decodeLoadStoreReg },
+	{ 0xffdffc1f, 0xd61f0000, decodeBranchReg },
+};
+
+unsigned int DecodeInsn(uint32_t code, uint64_t address, cs_arm64& detail)
+{
+	for (const auto& entry : decodeTable) {
+		if ((code & entry.mask) == entry.value) {
+			// same initialization as capstone
+			memset(&detail, 0, sizeof(detail));
+			for (auto& op : detail.operands)
+				op.vector_index = -1;
+			return entry.decode(code, address, detail);
+		}
+	}
+	return ARM64_INS_INVALID;
+}
+
+bool DecodePcRelative(uint32_t code, uint64_t address, uint32_t& immMask, uint64_t& target)
+{
+	if ((code & 0x7c000000) == 0x14000000) {
+		// B, BL
+		immMask = 0x03ffffff;
+		target = address + SignExtend(code & immMask, 26) * 4;
+	}
+	else if ((code & 0xff000010) == 0x54000000 || (code & 0x7e000000) == 0x34000000 || (code & 0x3b000000) == 0x18000000) {
+		// B.cond, CBZ, CBNZ, LDR (literal)
+		immMask = 0x00ffffe0;
+		target = address + SignExtend((code >> 5) & 0x7ffff, 19) * 4;
+	}
+	else if ((code & 0x7e000000) == 0x36000000) {
+		// TBZ, TBNZ
+		immMask = 0x0007ffe0;
+		target = address + SignExtend((code >> 5) & 0x3fff, 14) * 4;
+	}
+	else if ((code & 0x1f000000) == 0x10000000) {
+		// ADR, ADRP
+		immMask = 0x60ffffe0;
+		const auto imm = SignExtend((((code >> 5) & 0x7ffff) << 2) | ((code >> 29) & 3), 21);
+		target = (code & 0x80000000) ? (address & ~0xfffull) + (imm << 12) : address + imm;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+void BenchmarkDecoder(const uint8_t* code, size_t code_size, uint64_t address)
+{
+	csh handle;
+	if (cs_open(CS_ARCH_ARM64, CS_MODE_LITTLE_ENDIAN, &handle) != CS_ERR_OK)
+		throw std::runtime_error("Cannot open capstone engine");
+	cs_option(handle, CS_OPT_DETAIL, CS_OPT_ON);
+	cs_option(handle, CS_OPT_SKIPDATA, CS_OPT_ON);
+	auto insn = cs_malloc(handle);
+
+	auto startTime = std::chrono::steady_clock::now();
+	size_t numCs = 0;
+	{
+		auto ptr = code;
+		auto size = code_size;
+		auto addr = address;
+		while (cs_disasm_iter(handle, &ptr, &size, &addr, insn))
+			numCs++;
+	}
+	const auto csTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	// native decoder with capstone fallback for unsupported instructions
+	startTime = std::chrono::steady_clock::now();
+	size_t numNative = 0;
+	size_t numFallback = 0;
+	cs_arm64 detail;
+	for (size_t i = 0; i + 4 <= code_size; i += 4) {
+		uint32_t insnCode;
+		memcpy(&insnCode, code + i, 4);
+		if (DecodeInsn(insnCode, address + i, detail) != ARM64_INS_INVALID) {
+			numNative++;
+		}
+		else {
+			auto ptr = code + i;
+			size_t size = 4;
+			uint64_t addr = address + i;
+			cs_disasm_iter(handle, &ptr, &size, &addr, insn);
+			numFallback++;
+		}
+	}
+	const auto nativeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	cs_free(insn, 1);
+	cs_close(&handle);
+
+	const auto numInsns = numNative + numFallback;
+	std::cout << std::format("capstone with detail: {} instructions in {:.3f}s ({:.1f}M insn/s)\n", numCs, csTime, numCs / csTime / 1e6);
+	std::cout << std::format("native decoder: {} instructions in {:.3f}s ({:.1f}M insn/s), {:.1f}% decoded natively\n",
+		numInsns, nativeTime, numInsns / nativeTime / 1e6, numInsns ? numNative * 100.0 / numInsns : 0.0);
+}
+
+}
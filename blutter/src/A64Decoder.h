@@ -0,0 +1,25 @@
+#pragma once
+#include <capstone/capstone.h>
+
+// table-driven decoder for the aarch64 instructions that the code analyzer mostly inspects
+// (ldr/str/ldur/stur/ldp/stp, add/sub/cmp, mov/movz/movk, b/bl/b.cond/cbz/cbnz/tbz/tbnz/br/blr).
+// the operands are filled in capstone layout, so the result can be used as capstone instruction detail.
+namespace A64 {
+
+inline int64_t SignExtend(uint32_t val, int bits)
+{
+	return (int64_t)((uint64_t)val << (64 - bits)) >> (64 - bits);
+}
+
+// PC relative instruction (B, BL, B.cond, CBZ, CBNZ, TBZ, TBNZ, LDR (literal), ADR, ADRP) for code hashing.
+// immMask is the immediate bits in the instruction and target is the absolute target address.
+// return false if the instruction is not PC relative
+bool DecodePcRelative(uint32_t code, uint64_t address, uint32_t& immMask, uint64_t& target);
+
+// return capstone instruction id. ARM64_INS_INVALID if the instruction is not supported (capstone must be used)
+unsigned int DecodeInsn(uint32_t code, uint64_t address, cs_arm64& detail);
+
+// compare decoding throughput of this decoder against capstone with detail
+void BenchmarkDecoder(const uint8_t* code, size_t code_size, uint64_t address);
+
+}
@@ -0,0 +1,439 @@
+#include "pch.h"
+#include "AnalysisCache.h"
+#include "DartApp.h"
+#include "A64Decoder.h"
+#include <fstream>
+#include <vm/version.h>
+
+#ifndef NO_CODE_ANALYSIS
+
+// increase it when the cached data or IL text is changed
+static constexpr uint32_t CACHE_FORMAT_VERSION = 7;
+static constexpr char CACHE_MAGIC[8] = { 'B', 'L', 'T', 'R', 'A', 'N', 'A', 'C' };
+
+static constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325;
+static constexpr uint64_t FNV_PRIME = 0x100000001b3;
+
+static uint64_t hashString(const std::string& s, uint64_t hash = FNV_OFFSET)
+{
+	for (auto c : s)
+		hash = (hash ^ (uint8_t)c) * FNV_PRIME;
+	return hash;
+}
+
+template <typename T>
+static void writeVal(std::ostream& os, const T& val)
+{
+	os.write(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+static void writeString(std::ostream& os, const std::string& s)
+{
+	writeVal(os, (uint32_t)s.size());
+	os.write(s.data(), s.size());
+}
+
+template <typename T>
+static T readVal(std::istream& is)
+{
+	T val{};
+	is.read(reinterpret_cast<char*>(&val), sizeof(T));
+	return val;
+}
+
+static std::string readString(std::istream& is)
+{
+	const auto len = readVal<uint32_t>(is);
+	if (!is || len > 0x1000000)
+		throw std::runtime_error("invalid analysis cache string");
+	std::string s(len, '\0');
+	is.read(s.data(), len);
+	return s;
+}
+
+AnalysisCache::AnalysisCache(DartApp& app, std::filesystem::path path)
+	: app(app), path(std::move(path)), poolIds(app.GetPool().Length(), 0)
+{
+	load();
+}
+
+void AnalysisCache::load()
+{
+	std::ifstream is(path, std::ios::binary);
+	if (!is)
+		return;
+
+	char magic[sizeof(CACHE_MAGIC)];
+	is.read(magic, sizeof(magic));
+	if (!is || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || readVal<uint32_t>(is) != CACHE_FORMAT_VERSION ||
+		readString(is) != dart::Version::SnapshotString())
+	{
+		// cache from other blutter or Dart version. it will be replaced
+		std::cerr << std::format("Ignore incompatible analysis cache {}\n", path.string());
+		return;
+	}
+
+	try {
+		const auto numEntries = readVal<uint64_t>(is);
+		entries.reserve(numEntries);
+		for (uint64_t i = 0; i < numEntries; i++) {
+			const auto key = readVal<uint64_t>(is);
+			Entry entry{ readVal<uint32_t>(is) };
+			entry.stackSize = readVal<uint32_t>(is);
+			entry.annotations.resize(readVal<uint32_t>(is));
+			for (auto& annotation : entry.annotations) {
+				annotation.idx = readVal<uint32_t>(is);
+				annotation.dataType = readVal<uint8_t>(is);
+				annotation.val = readVal<uint64_t>(is);
+			}
+			entry.ils.resize(readVal<uint32_t>(is));
+			for (auto& il : entry.ils) {
+				il.kind = readVal<uint8_t>(is);
+				il.start = readVal<uint32_t>(is);
+				il.end = readVal<uint32_t>(is);
+				il.val = readVal<int64_t>(is);
+				il.text = readString(is);
+			}
+			entry.fieldAccesses.resize(readVal<uint32_t>(is));
+			for (auto& access : entry.fieldAccesses) {
+				access.start = readVal<uint32_t>(is);
+				access.isStore = readVal<uint8_t>(is) != 0;
+				access.field = readString(is);
+			}
+			if (!is)
+				throw std::runtime_error("truncated analysis cache");
+			entries.emplace(key, std::move(entry));
+		}
+	}
+	catch (std::exception& e) {
+		std::cerr << std::format("Ignore broken analysis cache {}: {}\n", path.string(), e.what());
+		entries.clear();
+	}
+}
+
+void AnalysisCache::Save()
+{
+	// write to temporary file first. a broken cache file is worse than no cache
+	auto tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream os(tmpPath, std::ios::binary);
+		os.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		writeVal(os, CACHE_FORMAT_VERSION);
+		writeString(os, dart::Version::SnapshotString());
+		writeVal(os, (uint64_t)entries.size());
+		for (const auto& [key, entry] : entries) {
+			writeVal(os, key);
+			writeVal(os, entry.elapsedUs);
+			writeVal(os, entry.stackSize);
+			writeVal(os, (uint32_t)entry.annotations.size());
+			for (const auto& annotation : entry.annotations) {
+				writeVal(os, annotation.idx);
+				writeVal(os, annotation.dataType);
+				writeVal(os, annotation.val);
+			}
+			writeVal(os, (uint32_t)entry.ils.size());
+			for (const auto& il : entry.ils) {
+				writeVal(os, il.kind);
+				writeVal(os, il.start);
+				writeVal(os, il.end);
+				writeVal(os, il.val);
+				writeString(os, il.text);
+			}
+			writeVal(os, (uint32_t)entry.fieldAccesses.size());
+			for (const auto& access : entry.fieldAccesses) {
+				writeVal(os, access.start);
+				writeVal(os, (uint8_t)access.isStore);
+				writeString(os, access.field);
+			}
+		}
+		if (!os)
+			throw std::runtime_error(std::format("failed to write analysis cache {}", tmpPath.string()));
+	}
+	std::filesystem::rename(tmpPath, path);
+}
+
+bool AnalysisCache::Restore(AnalyzedFnData& fnData, uint32_t& elapsedUs)
+{
+	auto& dartFn = fnData.dartFn;
+	const auto& fnCode = scanCode(dartFn);
+	auto itr = entries.find(fnCode.key);
+	if (itr == entries.end())
+		return false;
+	const auto& entry = itr->second;
+
+	// validate all annotations before modifying the analyzed data
+	const uint64_t start = dartFn.Address();
+	auto& asmTexts = fnData.asmTexts;
+	const auto lastAddr = asmTexts.Data().back().addr;
+	for (const auto& annotation : entry.annotations) {
+		const auto addr = start + annotation.idx * 4;
+		if (addr > lastAddr || asmTexts.AtAddr(addr).addr != addr)
+			return false;
+		if (annotation.dataType == AsmText::PoolOffset && !fnCode.poolRefs.contains(annotation.idx))
+			return false;
+		uint64_t target;
+		if (annotation.dataType == AsmText::Call && !getCallTarget(dartFn, annotation.idx, target))
+			return false;
+	}
+	std::vector<FieldAccess> fieldAccesses;
+	fieldAccesses.reserve(entry.fieldAccesses.size());
+	for (const auto& access : entry.fieldAccesses) {
+		auto field = findField(access.field);
+		if (field == nullptr)
+			return false;
+		fieldAccesses.push_back(FieldAccess{ start + access.start, field, access.isStore });
+	}
+	fnData.fieldAccesses = std::move(fieldAccesses);
+
+	for (const auto& annotation : entry.annotations) {
+		auto& asmText = asmTexts.AtAddr(start + annotation.idx * 4);
+		switch (annotation.dataType) {
+		case AsmText::ThreadOffset:
+			asmText.threadOffset = annotation.val;
+			break;
+		case AsmText::PoolOffset:
+			// pool offset might be changed in new version
+			asmText.poolOffset = fnCode.poolRefs.at(annotation.idx);
+			break;
+		case AsmText::Boolean:
+			asmText.boolVal = annotation.val != 0;
+			break;
+		case AsmText::Call:
+			getCallTarget(dartFn, annotation.idx, asmText.callAddress);
+			break;
+		}
+		asmText.dataType = annotation.dataType;
+	}
+
+	fnData.il_insns.reserve(entry.ils.size());
+	for (const auto& il : entry.ils) {
+		AddrRange range(start + il.start, start + il.end);
+		switch (il.kind) {
+		case ILInstr::GdtCall:
+			// targets are from current app
+			fnData.AddIL(std::make_unique<GdtCallInstr>(range, il.val, app.GetGdtTargets(il.val)));
+			break;
+		case ILInstr::ClosureCall:
+			fnData.AddIL(std::make_unique<ClosureCallInstr>(range, (int32_t)(il.val >> 32), (int32_t)il.val));
+			break;
+		case ILInstr::Unknown:
+			fnData.AddIL(std::make_unique<CachedInstr>(ILInstr::Unknown, range, il.text, ILInstr::Unknown));
+			break;
+		default:
+			fnData.AddIL(std::make_unique<CachedInstr>(ILInstr::Cached, range, il.text, (ILInstr::ILKind)il.kind));
+			break;
+		}
+	}
+
+	fnData.stackSize = entry.stackSize;
+	elapsedUs = entry.elapsedUs;
+	return true;
+}
+
+bool AnalysisCache::Add(AnalyzedFnData& fnData, uint32_t elapsedUs)
+{
+	auto& dartFn = fnData.dartFn;
+	const auto& fnCode = scanCode(dartFn);
+	if (entries.contains(fnCode.key))
+		return true;
+
+	const uint64_t start = dartFn.Address();
+	Entry entry{ elapsedUs, fnData.stackSize };
+	for (const auto& asmText : fnData.asmTexts.Data()) {
+		if (asmText.dataType == AsmText::None)
+			continue;
+		const auto idx = (uint32_t)((asmText.addr - start) / 4);
+		uint64_t val = 0;
+		switch (asmText.dataType) {
+		case AsmText::ThreadOffset:
+			val = asmText.threadOffset;
+			break;
+		case AsmText::PoolOffset: {
+			// only pool access sequence that is normalized in the key can be restored
+			auto ref = fnCode.poolRefs.find(idx);
+			if (ref == fnCode.poolRefs.end() || ref->second != (int64_t)asmText.poolOffset)
+				return false;
+			break;
+		}
+		case AsmText::Boolean:
+			val = asmText.boolVal;
+			break;
+		case AsmText::Call: {
+			uint64_t target;
+			if (!getCallTarget(dartFn, idx, target) || target != asmText.callAddress)
+				return false;
+			break;
+		}
+		}
+		entry.annotations.push_back(Annotation{ idx, asmText.dataType, val });
+	}
+
+	entry.ils.reserve(fnData.il_insns.size());
+	for (const auto& il : fnData.il_insns) {
+		CachedIL cached{ (uint8_t)il->OriginalKind(), (uint32_t)(il->Start() - start), (uint32_t)(il->End() - start), 0 };
+		switch (il->Kind()) {
+		case ILInstr::Unknown:
+			break;
+		case ILInstr::GdtCall:
+			cached.val = reinterpret_cast<GdtCallInstr*>(il.get())->Offset();
+			break;
+		case ILInstr::ClosureCall: {
+			auto closureCall = reinterpret_cast<ClosureCallInstr*>(il.get());
+			cached.val = ((int64_t)closureCall->numArg << 32) | (uint32_t)closureCall->numTypeArg;
+			break;
+		}
+		default:
+			cached.text = il->ToString();
+			break;
+		}
+		entry.ils.push_back(std::move(cached));
+	}
+
+	for (const auto& access : fnData.fieldAccesses) {
+		auto name = access.field->FullName();
+		if (findField(name) != access.field)
+			return false;
+		entry.fieldAccesses.push_back(CachedFieldAccess{ (uint32_t)(access.addr - start), access.isStore, std::move(name) });
+	}
+
+	entries.emplace(fnCode.key, std::move(entry));
+	return true;
+}
+
+DartField* AnalysisCache::findField(const std::string& fullName)
+{
+	if (fieldsByName.empty()) {
+		for (auto lib : app.libs) {
+			for (auto cls : lib->classes) {
+				for (auto field : cls->Fields()) {
+					// mark duplicated name as unusable
+					auto [itr, inserted] = fieldsByName.emplace(field->FullName(), field);
+					if (!inserted)
+						itr->second = nullptr;
+				}
+			}
+		}
+	}
+	auto itr = fieldsByName.find(fullName);
+	return itr != fieldsByName.end() ? itr->second : nullptr;
+}
+
+uint64_t AnalysisCache::poolIdentity(int64_t offset)
+{
+	const auto idx = dart::ObjectPool::IndexFromOffset(offset);
+	if (idx < 0 || idx >= (intptr_t)poolIds.size())
+		return hashString(std::format("invalid {:#x}", offset));
+
+	auto& id = poolIds[idx];
+	if (id == 0) {
+		// the analyzer uses only the value of pool object
+		const auto& entry = app.GetPool().EntryAt(idx);
+		const auto txt = entry.value ? entry.value->ToString() : std::format("{:#x}", entry.rawVal);
+		id = hashString(std::format("{}|{}|{}", (int)entry.kind, entry.cid, txt));
+	}
+	return id;
+}
+
+uint64_t AnalysisCache::callIdentity(uint64_t target)
+{
+	auto itr = callIds.find(target);
+	if (itr != callIds.end())
+		return itr->second;
+
+	// address of unknown target is changed in new version. it makes the key changed (no cache)
+	auto fn = app.GetFunction(target);
+	const auto id = hashString(fn ? fn->FullName() : std::format("{:#x}", target));
+	callIds.emplace(target, id);
+	return id;
+}
+
+// arm64 specific
+bool AnalysisCache::getCallTarget(DartFunction& dartFn, uint32_t idx, uint64_t& target)
+{
+	const auto word = ((const uint32_t*)dartFn.MemAddress())[idx];
+	// B, BL
+	if ((word & 0x7c000000) != 0x14000000)
+		return false;
+	target = dartFn.Address() + idx * 4 + A64::SignExtend(word & 0x03ffffff, 26) * 4;
+	return true;
+}
+
+const AnalysisCache::FnCode& AnalysisCache::scanCode(DartFunction& dartFn)
+{
+	if (lastScan.dartFn == &dartFn)
+		return lastScan;
+	lastScan.dartFn = &dartFn;
+	lastScan.poolRefs.clear();
+
+	const auto code = (const uint32_t*)dartFn.MemAddress();
+	const uint64_t start = dartFn.Address();
+	const uint64_t end = dartFn.AddressEnd();
+	const auto numWords = (uint32_t)(dartFn.Size() / 4);
+	constexpr uint32_t ppBase = (uint32_t)dart::PP << 5;
+
+	uint64_t hash = FNV_OFFSET;
+	auto mix = [&hash](uint64_t val) { hash = (hash ^ val) * FNV_PRIME; };
+	// function info that the analyzer uses
+	mix(dartFn.Size());
+	mix((dartFn.IsStatic() ? 1 : 0) | (dartFn.IsClosure() ? 2 : 0) | (dartFn.IsAsync() ? 4 : 0));
+	mix(dartFn.NumParam());
+	if (!dartFn.IsStatic())
+		mix(hashString(dartFn.Class().FullName()));
+
+	for (uint32_t i = 0; i < numWords; i++) {
+		const uint32_t word = code[i];
+		// pool object access sequences (see FunctionAnalyzer::getObjectPoolInstruction())
+		if ((word & 0xffc003e0) == (0xf9400000 | ppBase)) {
+			// LDR Xt, [PP, #imm]
+			const int64_t offset = ((word >> 10) & 0xfff) * 8;
+			lastScan.poolRefs[i] = offset;
+			mix(word & ~0x003ffc00u);
+			mix(poolIdentity(offset));
+			continue;
+		}
+		if ((word & 0xffc003e0) == (0x91400000 | ppBase) && i + 1 < numWords) {
+			// ADD Xd, PP, #imm, LSL 12 then LDR, LDP or ADD with Xd
+			const uint32_t word2 = code[i + 1];
+			const uint32_t rnBase = (word & 0x1f) << 5;
+			uint32_t immMask2 = 0;
+			int64_t low = 0;
+			if ((word2 & 0xffc003e0) == (0xf9400000 | rnBase)) {
+				immMask2 = 0x003ffc00;
+				low = ((word2 >> 10) & 0xfff) * 8;
+			}
+			else if ((word2 & 0xffc003e0) == (0xa9400000 | rnBase)) {
+				immMask2 = 0x003f8000;
+				low = A64::SignExtend((word2 >> 15) & 0x7f, 7) * 8;
+			}
+			else if ((word2 & 0xffc003e0) == (0x91000000 | rnBase)) {
+				immMask2 = 0x003ffc00;
+				low = (word2 >> 10) & 0xfff;
+			}
+			if (immMask2 != 0) {
+				const int64_t offset = ((int64_t)((word >> 10) & 0xfff) << 12) + low;
+				lastScan.poolRefs[i] = offset;
+				mix(word & ~0x003ffc00u);
+				mix(word2 & ~immMask2);
+				mix(poolIdentity(offset));
+				i++;
+				continue;
+			}
+		}
+
+		// PC relative instructions
+		uint32_t immMask;
+		uint64_t target;
+		if (!A64::DecodePcRelative(word, start + i * 4, immMask, target)) {
+			mix(word);
+			continue;
+		}
+		mix(word & ~immMask);
+		mix((target >= start && target < end) ? target - start : callIdentity(target));
+	}
+
+	lastScan.key = hash;
+	return lastScan;
+}
+
+#endif // NO_CODE_ANALYSIS
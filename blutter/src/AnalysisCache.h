@@ -0,0 +1,78 @@
+#pragma once
+#include "CodeAnalyzer.h"
+#include <filesystem>
+
+class DartApp;
+class DartFunction;
+
+// persistent analysis results of functions. it is for analyzing new versions of same app
+//   so only changed and new functions are analyzed.
+// a function key is the hash of its code with normalized pool offsets and call targets
+//   plus identities of the referenced pool objects and call targets.
+class AnalysisCache
+{
+public:
+	AnalysisCache(DartApp& app, std::filesystem::path path);
+	AnalysisCache() = delete;
+	AnalysisCache(const AnalysisCache&) = delete;
+	AnalysisCache& operator=(const AnalysisCache&) = delete;
+
+	// fill asm annotations and ILs of the function from cache. elapsedUs is the time of original analysis
+	bool Restore(AnalyzedFnData& fnData, uint32_t& elapsedUs);
+	// add the analyzed function. return false if the result cannot be cached
+	bool Add(AnalyzedFnData& fnData, uint32_t elapsedUs);
+	void Save();
+
+	size_t NumEntries() const { return entries.size(); }
+
+private:
+	struct Annotation {
+		uint32_t idx; // instruction index
+		uint8_t dataType;
+		uint64_t val;
+	};
+	struct CachedIL {
+		// kind of analyzed IL. only GdtCall and ClosureCall are recreated (for call graph). others are restored as text
+		uint8_t kind;
+		uint32_t start; // offset from function address
+		uint32_t end;
+		int64_t val; // selector offset of GdtCall or packed arguments count of ClosureCall
+		std::string text;
+	};
+	struct CachedFieldAccess {
+		uint32_t start; // offset from function address
+		bool isStore;
+		std::string field; // DartField::FullName()
+	};
+	struct Entry {
+		uint32_t elapsedUs;
+		uint32_t stackSize;
+		std::vector<Annotation> annotations;
+		std::vector<CachedIL> ils;
+		std::vector<CachedFieldAccess> fieldAccesses;
+	};
+	struct FnCode {
+		DartFunction* dartFn{ nullptr };
+		uint64_t key{ 0 };
+		// instruction index to pool offset of pool access sequence in current code
+		std::unordered_map<uint32_t, int64_t> poolRefs;
+	};
+
+	void load();
+	// implementation is specific to architecture
+	const FnCode& scanCode(DartFunction& dartFn);
+	static bool getCallTarget(DartFunction& dartFn, uint32_t idx, uint64_t& target);
+	uint64_t poolIdentity(int64_t offset);
+	uint64_t callIdentity(uint64_t target);
+	// nullptr if not found or the name is not unique
+	DartField* findField(const std::string& fullName);
+
+	DartApp& app;
+	std::filesystem::path path;
+	std::unordered_map<uint64_t, Entry> entries;
+	// identity hash of pool entries (0 if not computed yet)
+	std::vector<uint64_t> poolIds;
+	std::unordered_map<uint64_t, uint64_t> callIds;
+	FnCode lastScan;
+	std::unordered_map<std::string, DartField*> fieldsByName;
+};
@@ -0,0 +1,232 @@
+#pragma once
+// header-only reader of blutter analysis database (analysis.db). it has no dependency on blutter or Dart VM,
+//   so other tools can copy this file and query the database directly from memory mapped file.
+//
+// file layout (every column is 8 bytes aligned):
+//   Header
+//   ColumnDesc columns[numColumns]
+//   column data
+// every table is stored as columns (arrays with one element per row). a reader uses only the columns it knows,
+//   so new columns can be added without breaking old readers. a missing column is read as empty.
+// strings are StrRef into the Strings column (not null terminated). same strings are stored once.
+// rows that belong to another row are grouped and the owner has a start index column with numRows + 1 elements
+//   (e.g. fields of class i are ClsFieldStart[i] to ClsFieldStart[i + 1]).
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+class AnalysisDb
+{
+public:
+	static constexpr char Magic[8] = { 'B', 'L', 'T', 'R', 'A', 'D', 'B', '\0' };
+	// increased only when existing columns are changed. adding columns does not change the version
+	static constexpr uint32_t Version = 1;
+	static constexpr uint32_t None = UINT32_MAX;
+
+	enum Column : uint32_t {
+		Strings = 0, // char
+
+		// libraries
+		LibUrl = 100, // StrRef
+		LibName, // StrRef
+		LibKnownPackage, // StrRef. label of matched package signature
+		LibClassStart, // uint32_t[numLibs + 1]. classes are grouped by library
+
+		// classes
+		ClsId = 200, // uint32_t. Dart class id
+		ClsLib, // uint32_t. library row
+		ClsName, // StrRef. name with type parameters
+		ClsParent, // uint32_t. class row of super class or None
+		ClsSize, // int32_t. instance size
+		ClsTypeArgOffset, // int32_t. offset of type arguments field or -1 (kNoTypeArguments)
+		ClsFieldStart, // uint32_t[numClasses + 1]. fields are grouped by class
+		ClsFunctionStart, // uint32_t[numClasses + 1] into ClsFunctions
+		ClsFunctions, // uint32_t. function rows grouped by class
+
+		// fields
+		FldClass = 300, // uint32_t. class row
+		FldName, // StrRef
+		FldOffset, // uint32_t. instance offset or static field offset
+		FldFlags, // uint8_t. FieldFlag
+		FldType, // StrRef. empty if unknown
+
+		// functions (sorted by address)
+		FnAddr = 400, // uint64_t
+		FnSize, // uint32_t
+		FnClass, // uint32_t. class row
+		FnName, // StrRef. full name
+		FnSignature, // StrRef. "ReturnType (params)". empty if no info
+		FnKind, // uint8_t. FunctionKind
+		FnFlags, // uint8_t. FunctionFlag
+		FnNumParams, // uint16_t
+		FnStackSize, // uint32_t. 0 if not analyzed
+		FnILStart, // uint32_t[numFunctions + 1]. ILs are grouped by function
+
+		// stubs (sorted by address)
+		StubAddr = 500, // uint64_t
+		StubSize, // uint32_t
+		StubKind, // uint32_t. kind of blutter stub (depends on Dart version)
+		StubName, // StrRef
+
+		// object pool (row is pool index)
+		PoolKind = 600, // uint8_t. kind of blutter pool entry
+		PoolCid, // int32_t
+		PoolValue, // uint64_t. raw value of number and bool
+		PoolText, // StrRef. string value or description
+
+		// ILs of analyzed functions
+		ILStart = 700, // uint32_t. offset from function address
+		ILEnd, // uint32_t
+		ILKind, // uint8_t. kind of blutter IL (depends on blutter version)
+		ILText, // StrRef
+
+		// call edges (sorted by caller)
+		EdgeCaller = 800, // uint64_t. function address
+		EdgeCallee, // uint64_t. function or stub address. 0 if unknown (closure call)
+		EdgeKind, // uint8_t. EdgeKind
+
+		// object pool cross references (sorted by pool index)
+		PoolRefIdx = 900, // uint32_t
+		PoolRefAddr, // uint64_t. instruction address
+		PoolRefFn, // uint64_t. function address
+
+		// field cross references (sorted by field)
+		FieldRefField = 1000, // uint32_t. field row
+		FieldRefAddr, // uint64_t. IL address
+		FieldRefFn, // uint64_t. function address
+		FieldRefStore, // uint8_t. 1 for write
+	};
+
+	enum FunctionKind : uint8_t { Normal = 0, Constructor, Getter, Setter };
+	enum FunctionFlag : uint8_t {
+		FnNative = 1 << 0,
+		FnClosure = 1 << 1,
+		FnFfi = 1 << 2,
+		FnStatic = 1 << 3,
+		FnConst = 1 << 4,
+		FnAbstract = 1 << 5,
+		FnAsync = 1 << 6,
+		FnAnalyzed = 1 << 7,
+	};
+	enum FieldFlag : uint8_t {
+		FldStatic = 1 << 0,
+		FldLate = 1 << 1,
+		FldFinal = 1 << 2,
+		FldConst = 1 << 3,
+	};
+	enum EdgeKind : uint8_t { Direct = 0, TailCall, Dispatch, Closure };
+
+	struct StrRef {
+		uint32_t offset;
+		uint32_t length;
+	};
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t numColumns;
+		uint64_t fileSize;
+	};
+	struct ColumnDesc {
+		uint32_t id;
+		uint32_t elemSize;
+		uint64_t count;
+		uint64_t offset;
+	};
+
+	// data is whole database file (usually memory mapped). it must be 8 bytes aligned and alive while reading
+	AnalysisDb(const void* data, size_t size) : data((const uint8_t*)data), size(size) {
+		if (size < sizeof(Header))
+			throw std::runtime_error("truncated analysis database");
+		hdr = reinterpret_cast<const Header*>(data);
+		if (memcmp(hdr->magic, Magic, sizeof(Magic)) != 0)
+			throw std::runtime_error("not an analysis database");
+		if (hdr->version != Version)
+			throw std::runtime_error("unsupported analysis database version");
+		if (hdr->fileSize != size || hdr->numColumns > (size - sizeof(Header)) / sizeof(ColumnDesc))
+			throw std::runtime_error("truncated analysis database");
+		columns = reinterpret_cast<const ColumnDesc*>(this->data + sizeof(Header));
+		for (uint32_t i = 0; i < hdr->numColumns; i++) {
+			const auto& col = columns[i];
+			if (col.offset % 8 != 0 || col.offset > size || (col.elemSize && col.count > (size - col.offset) / col.elemSize))
+				throw std::runtime_error("broken column in analysis database");
+			byId.push_back(&col);
+		}
+		// lookup by binary search. the first one is used if a column id is duplicated
+		std::stable_sort(byId.begin(), byId.end(), [](const ColumnDesc* a, const ColumnDesc* b) { return a->id < b->id; });
+		const auto chars = Get<char>(Strings);
+		strings = std::string_view(chars.data(), chars.size());
+	}
+
+	// elements of the column. empty if the column is not in the database
+	template <typename T>
+	std::span<const T> Get(Column id) const {
+		auto itr = std::lower_bound(byId.begin(), byId.end(), id, [](const ColumnDesc* col, uint32_t id) { return col->id < id; });
+		if (itr == byId.end() || (*itr)->id != id)
+			return {};
+		if ((*itr)->elemSize != sizeof(T))
+			throw std::runtime_error("wrong element type of analysis database column");
+		return std::span<const T>(reinterpret_cast<const T*>(data + (*itr)->offset), (*itr)->count);
+	}
+
+	std::string_view Str(StrRef ref) const {
+		if (ref.offset > strings.size() || ref.length > strings.size() - ref.offset)
+			throw std::runtime_error("broken string in analysis database");
+		return std::string_view(strings.data() + ref.offset, ref.length);
+	}
+	std::string_view Str(Column id, size_t row) const {
+		const auto refs = Get<StrRef>(id);
+		if (row >= refs.size())
+			throw std::runtime_error("broken string in analysis database");
+		return Str(refs[row]);
+	}
+
+	size_t NumLibraries() const { return Get<StrRef>(LibUrl).size(); }
+	size_t NumClasses() const { return Get<uint32_t>(ClsId).size(); }
+	size_t NumFields() const { return Get<uint32_t>(FldClass).size(); }
+	size_t NumFunctions() const { return Get<uint64_t>(FnAddr).size(); }
+	size_t NumStubs() const { return Get<uint64_t>(StubAddr).size(); }
+	size_t NumPoolEntries() const { return Get<uint8_t>(PoolKind).size(); }
+	size_t NumILs() const { return Get<uint32_t>(ILStart).size(); }
+	size_t NumEdges() const { return Get<uint64_t>(EdgeCaller).size(); }
+
+	// row of function or stub at the address. None if not found
+	uint32_t FindFunction(uint64_t addr) const { return findSorted(Get<uint64_t>(FnAddr), addr); }
+	uint32_t FindStub(uint64_t addr) const { return findSorted(Get<uint64_t>(StubAddr), addr); }
+	// row range [first, last) in a group column (e.g. ClsFieldStart for fields of a class)
+	std::pair<uint32_t, uint32_t> Group(Column startId, uint32_t row) const {
+		const auto starts = Get<uint32_t>(startId);
+		if ((size_t)row + 1 >= starts.size())
+			throw std::runtime_error("row is out of group column in analysis database");
+		return { starts[row], starts[row + 1] };
+	}
+	// row range of call edges from the function
+	std::pair<uint32_t, uint32_t> Callees(uint64_t fnAddr) const { return equalRange(Get<uint64_t>(EdgeCaller), fnAddr); }
+	// row range of instructions that load the pool entry
+	std::pair<uint32_t, uint32_t> PoolRefs(uint32_t poolIdx) const { return equalRange(Get<uint32_t>(PoolRefIdx), poolIdx); }
+	// row range of accesses to the field
+	std::pair<uint32_t, uint32_t> FieldRefs(uint32_t fieldRow) const { return equalRange(Get<uint32_t>(FieldRefField), fieldRow); }
+
+private:
+	template <typename T>
+	static uint32_t findSorted(std::span<const T> col, T val) {
+		auto itr = std::lower_bound(col.begin(), col.end(), val);
+		return itr != col.end() && *itr == val ? (uint32_t)(itr - col.begin()) : None;
+	}
+	template <typename T>
+	static std::pair<uint32_t, uint32_t> equalRange(std::span<const T> col, T val) {
+		auto [first, last] = std::equal_range(col.begin(), col.end(), val);
+		return { (uint32_t)(first - col.begin()), (uint32_t)(last - col.begin()) };
+	}
+
+	const uint8_t* data;
+	size_t size;
+	const Header* hdr;
+	const ColumnDesc* columns;
+	// columns sorted by id
+	std::vector<const ColumnDesc*> byId;
+	std::string_view strings;
+};
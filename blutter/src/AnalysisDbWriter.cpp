@@ -0,0 +1,371 @@
+#include "pch.h"
+#include "AnalysisDbWriter.h"
+#include "AnalysisDb.h"
+#include "DartApp.h"
+#include "CallGraph.h"
+#include "Util.h"
+#include "MappedFile.h"
+
+// columns are kept in memory until all tables are built. same strings are stored once
+class DbBuilder {
+public:
+	template <typename T>
+	void Add(AnalysisDb::Column id, const std::vector<T>& vals) {
+		columns.push_back(Column{ id, (uint32_t)sizeof(T), vals.size(), std::string((const char*)vals.data(), vals.size() * sizeof(T)) });
+	}
+
+	AnalysisDb::StrRef Str(std::string_view s) {
+		if (s.empty())
+			return AnalysisDb::StrRef{ 0, 0 };
+		auto [itr, inserted] = strRefs.try_emplace(std::string(s), AnalysisDb::StrRef{ (uint32_t)strings.size(), (uint32_t)s.size() });
+		if (inserted) {
+			if (strings.size() + s.size() > UINT32_MAX)
+				throw std::runtime_error("too many strings for analysis database");
+			strings += s;
+		}
+		return itr->second;
+	}
+
+	// return the file size
+	uint64_t Write(const std::filesystem::path& path) {
+		columns.push_back(Column{ AnalysisDb::Strings, 1, strings.size(), std::move(strings) });
+
+		std::vector<AnalysisDb::ColumnDesc> descs;
+		uint64_t offset = MappedFile::AlignUp(sizeof(AnalysisDb::Header) + columns.size() * sizeof(AnalysisDb::ColumnDesc));
+		for (const auto& col : columns) {
+			descs.push_back(AnalysisDb::ColumnDesc{ col.id, col.elemSize, col.count, offset });
+			offset = MappedFile::AlignUp(offset + col.data.size());
+		}
+		AnalysisDb::Header hdr{};
+		memcpy(hdr.magic, AnalysisDb::Magic, sizeof(AnalysisDb::Magic));
+		hdr.version = AnalysisDb::Version;
+		hdr.numColumns = (uint32_t)columns.size();
+		hdr.fileSize = offset;
+
+		IndexFileWriter of(path);
+		of.WriteVal(hdr);
+		of.WriteArray(descs);
+		of.Pad();
+		for (const auto& col : columns) {
+			of.Write(col.data.data(), col.data.size());
+			of.Pad();
+		}
+		of.Commit();
+		return hdr.fileSize;
+	}
+
+private:
+	struct Column {
+		uint32_t id;
+		uint32_t elemSize;
+		uint64_t count;
+		std::string data;
+	};
+	std::vector<Column> columns;
+	std::string strings;
+	std::unordered_map<std::string, AnalysisDb::StrRef> strRefs;
+};
+
+// "ReturnType (T a, [T b], {required T c})" like the function head in asm. empty if signature is dropped
+static std::string signatureText(DartFunction& dartFn)
+{
+	auto& sig = dartFn.Signature();
+	if (sig.ReturnType() == nullptr)
+		return std::string();
+
+	fmt::memory_buffer out;
+	sig.ReturnType()->AppendTo(out);
+	Util::Append(out, " (");
+	bool inNamed = false;
+	for (int i = 0; i < sig.NumParam(); i++) {
+		auto& param = sig.Param(i);
+		if (i != 0)
+			Util::Append(out, ", ");
+		// only named parameters have a name in AOT snapshot
+		if (!param.name.empty() && !inNamed) {
+			Util::Append(out, "{");
+			inNamed = true;
+		}
+		if (param.isRequired)
+			Util::Append(out, "required ");
+		if (param.type)
+			param.type->AppendTo(out);
+		else
+			Util::Append(out, "dynamic");
+		if (!param.name.empty()) {
+			Util::Append(out, " ");
+			Util::Append(out, param.name);
+		}
+	}
+	if (inNamed)
+		Util::Append(out, "}");
+	Util::Append(out, ")");
+	return fmt::to_string(out);
+}
+
+void AnalysisDbWriter::Create(DartApp& app, const std::filesystem::path& path, const std::filesystem::path& callGraphPath)
+{
+	DbBuilder db;
+
+	// libraries. classes without library are in the last row
+	std::vector<DartLibrary*> libs = app.libs;
+	libs.push_back(&app.nativeLib);
+	std::vector<DartClass*> classes;
+	{
+		std::vector<AnalysisDb::StrRef> urls, names, knownPackages;
+		std::vector<uint32_t> classStart{ 0 };
+		for (auto lib : libs) {
+			urls.push_back(db.Str(lib->url));
+			names.push_back(db.Str(lib->name));
+			knownPackages.push_back(db.Str(lib->knownPackage));
+			classes.insert(classes.end(), lib->classes.begin(), lib->classes.end());
+			classStart.push_back((uint32_t)classes.size());
+		}
+		db.Add(AnalysisDb::LibUrl, urls);
+		db.Add(AnalysisDb::LibName, names);
+		db.Add(AnalysisDb::LibKnownPackage, knownPackages);
+		db.Add(AnalysisDb::LibClassStart, classStart);
+	}
+	std::unordered_map<const DartClass*, uint32_t> clsRow;
+	for (uint32_t i = 0; i < classes.size(); i++)
+		clsRow[classes[i]] = i;
+
+	// functions are sorted by address for binary search. rows of a class are in ClsFunctions
+	std::vector<DartFunction*> functions;
+	for (auto cls : classes)
+		functions.insert(functions.end(), cls->Functions().begin(), cls->Functions().end());
+	std::stable_sort(functions.begin(), functions.end(), [](DartFunction* a, DartFunction* b) { return a->Address() < b->Address(); });
+	std::unordered_map<const DartFunction*, uint32_t> fnRow;
+	for (uint32_t i = 0; i < functions.size(); i++)
+		fnRow[functions[i]] = i;
+
+	std::unordered_map<const DartField*, uint32_t> fieldRow;
+	{
+		std::vector<uint32_t> ids, libIdx, parents, fieldStart{ 0 }, fnStart{ 0 }, clsFns;
+		std::vector<AnalysisDb::StrRef> names;
+		std::vector<int32_t> sizes, typeArgOffsets;
+		std::vector<uint32_t> fldClass, fldOffset;
+		std::vector<AnalysisDb::StrRef> fldName, fldType;
+		std::vector<uint8_t> fldFlags;
+		fmt::memory_buffer typeName;
+		for (uint32_t lib = 0; lib < libs.size(); lib++) {
+			for (auto cls : libs[lib]->classes) {
+				ids.push_back(cls->Id());
+				libIdx.push_back(lib);
+				names.push_back(db.Str(cls->FullName()));
+				auto parentItr = cls->Parent() ? clsRow.find(cls->Parent()) : clsRow.end();
+				parents.push_back(parentItr != clsRow.end() ? parentItr->second : AnalysisDb::None);
+				sizes.push_back(cls->Size());
+				typeArgOffsets.push_back(cls->TypeArgumentsOffset());
+
+				for (auto field : cls->Fields()) {
+					fieldRow[field] = (uint32_t)fldClass.size();
+					fldClass.push_back(clsRow.at(cls));
+					fldName.push_back(db.Str(field->Name()));
+					fldOffset.push_back(field->Offset());
+					fldFlags.push_back((field->IsStatic() ? AnalysisDb::FldStatic : 0) | (field->IsLate() ? AnalysisDb::FldLate : 0) |
+						(field->IsFinal() ? AnalysisDb::FldFinal : 0) | (field->IsConst() ? AnalysisDb::FldConst : 0));
+					typeName.clear();
+					if (field->Type())
+						field->Type()->AppendTo(typeName);
+					fldType.push_back(db.Str(std::string_view(typeName.data(), typeName.size())));
+				}
+				fieldStart.push_back((uint32_t)fldClass.size());
+
+				for (auto dartFn : cls->Functions())
+					clsFns.push_back(fnRow.at(dartFn));
+				fnStart.push_back((uint32_t)clsFns.size());
+			}
+		}
+		db.Add(AnalysisDb::ClsId, ids);
+		db.Add(AnalysisDb::ClsLib, libIdx);
+		db.Add(AnalysisDb::ClsName, names);
+		db.Add(AnalysisDb::ClsParent, parents);
+		db.Add(AnalysisDb::ClsSize, sizes);
+		db.Add(AnalysisDb::ClsTypeArgOffset, typeArgOffsets);
+		db.Add(AnalysisDb::ClsFieldStart, fieldStart);
+		db.Add(AnalysisDb::ClsFunctionStart, fnStart);
+		db.Add(AnalysisDb::ClsFunctions, clsFns);
+		db.Add(AnalysisDb::FldClass, fldClass);
+		db.Add(AnalysisDb::FldName, fldName);
+		db.Add(AnalysisDb::FldOffset, fldOffset);
+		db.Add(AnalysisDb::FldFlags, fldFlags);
+		db.Add(AnalysisDb::FldType, fldType);
+	}
+
+	{
+		std::vector<uint64_t> addrs;
+		std::vector<uint32_t> sizes, fnClass, stackSizes, ilStart{ 0 };
+		std::vector<AnalysisDb::StrRef> names, sigs;
+		std::vector<uint8_t> kinds, flags;
+		std::vector<uint16_t> numParams;
+		std::vector<uint32_t> ilStarts, ilEnds;
+		std::vector<uint8_t> ilKinds;
+		std::vector<AnalysisDb::StrRef> ilTexts;
+		fmt::memory_buffer ilText;
+		for (auto dartFn : functions) {
+			addrs.push_back(dartFn->Address());
+			sizes.push_back((uint32_t)dartFn->Size());
+			fnClass.push_back(clsRow.at(&dartFn->Class()));
+			names.push_back(db.Str(dartFn->FullName()));
+			sigs.push_back(db.Str(signatureText(*dartFn)));
+			kinds.push_back((uint8_t)dartFn->Kind());
+			uint8_t flag = (dartFn->IsNative() ? AnalysisDb::FnNative : 0) | (dartFn->IsClosure() ? AnalysisDb::FnClosure : 0) |
+				(dartFn->IsFfi() ? AnalysisDb::FnFfi : 0) | (dartFn->IsStatic() ? AnalysisDb::FnStatic : 0) |
+				(dartFn->IsConst() ? AnalysisDb::FnConst : 0) | (dartFn->IsAbstract() ? AnalysisDb::FnAbstract : 0) |
+				(dartFn->IsAsync() ? AnalysisDb::FnAsync : 0);
+			numParams.push_back((uint16_t)dartFn->NumParam());
+			uint32_t stackSize = 0;
+#ifndef NO_CODE_ANALYSIS
+			auto fnData = dartFn->GetAnalyzedData();
+			// functions that are skipped (e.g. --skip-known) have analyzed data without ILs
+			if (dartFn->Size() > 0 && fnData != nullptr && !fnData->ILs().empty()) {
+				flag |= AnalysisDb::FnAnalyzed;
+				stackSize = fnData->stackSize;
+				// ILs might be from other function with same code
+				const int64_t delta = fnData->sameCodeDelta - (int64_t)dartFn->Address();
+				for (auto& il : fnData->ILs()) {
+					if (il->Kind() == ILInstr::Unknown)
+						continue;
+					ilStarts.push_back((uint32_t)(il->Start() + delta));
+					ilEnds.push_back((uint32_t)(il->End() + delta));
+					ilKinds.push_back((uint8_t)il->OriginalKind());
+					ilText.clear();
+					il->AppendTo(ilText);
+					ilTexts.push_back(db.Str(std::string_view(ilText.data(), ilText.size())));
+				}
+			}
+#endif
+			flags.push_back(flag);
+			stackSizes.push_back(stackSize);
+			ilStart.push_back((uint32_t)ilStarts.size());
+		}
+		db.Add(AnalysisDb::FnAddr, addrs);
+		db.Add(AnalysisDb::FnSize, sizes);
+		db.Add(AnalysisDb::FnClass, fnClass);
+		db.Add(AnalysisDb::FnName, names);
+		db.Add(AnalysisDb::FnSignature, sigs);
+		db.Add(AnalysisDb::FnKind, kinds);
+		db.Add(AnalysisDb::FnFlags, flags);
+		db.Add(AnalysisDb::FnNumParams, numParams);
+		db.Add(AnalysisDb::FnStackSize, stackSizes);
+		db.Add(AnalysisDb::FnILStart, ilStart);
+		db.Add(AnalysisDb::ILStart, ilStarts);
+		db.Add(AnalysisDb::ILEnd, ilEnds);
+		db.Add(AnalysisDb::ILKind, ilKinds);
+		db.Add(AnalysisDb::ILText, ilTexts);
+	}
+
+	{
+		std::vector<DartStub*> stubs;
+		for (auto& [_, stub] : app.stubs)
+			stubs.push_back(stub);
+		std::sort(stubs.begin(), stubs.end(), [](DartStub* a, DartStub* b) { return a->Address() < b->Address(); });
+		std::vector<uint64_t> addrs;
+		std::vector<uint32_t> sizes, kinds;
+		std::vector<AnalysisDb::StrRef> names;
+		for (auto stub : stubs) {
+			addrs.push_back(stub->Address());
+			sizes.push_back((uint32_t)stub->Size());
+			kinds.push_back((uint32_t)stub->kind);
+			names.push_back(db.Str(stub->FullName()));
+		}
+		db.Add(AnalysisDb::StubAddr, addrs);
+		db.Add(AnalysisDb::StubSize, sizes);
+		db.Add(AnalysisDb::StubKind, kinds);
+		db.Add(AnalysisDb::StubName, names);
+	}
+
+	{
+		const auto& pool = app.GetPool();
+		std::vector<uint8_t> kinds;
+		std::vector<int32_t> cids;
+		std::vector<uint64_t> vals;
+		std::vector<AnalysisDb::StrRef> texts;
+		for (intptr_t i = 0; i < pool.Length(); i++) {
+			const auto& entry = pool.EntryAt(i);
+			kinds.push_back(entry.kind);
+			cids.push_back(entry.cid);
+			vals.push_back(entry.rawVal);
+			texts.push_back(db.Str(entry.kind == DartPoolEntry::String || !pool.HasDescriptions() ? entry.text : entry.desc));
+		}
+		db.Add(AnalysisDb::PoolKind, kinds);
+		db.Add(AnalysisDb::PoolCid, cids);
+		db.Add(AnalysisDb::PoolValue, vals);
+		db.Add(AnalysisDb::PoolText, texts);
+	}
+
+	size_t numEdges = 0;
+	if (std::filesystem::exists(callGraphPath)) {
+		// call graph nodes are sorted by address, so edges are sorted by caller
+		CallGraph graph{ callGraphPath };
+		std::vector<uint64_t> callers, callees;
+		std::vector<uint8_t> kinds;
+		for (uint32_t node = 0; node < graph.NumNodes(); node++) {
+			for (const auto& edge : graph.Callees(node)) {
+				callers.push_back(graph.Address(node));
+				callees.push_back(edge.node != CallGraph::UnknownNode ? graph.Address(edge.node) : 0);
+				kinds.push_back((uint8_t)edge.kind);
+			}
+		}
+		numEdges = callers.size();
+		db.Add(AnalysisDb::EdgeCaller, callers);
+		db.Add(AnalysisDb::EdgeCallee, callees);
+		db.Add(AnalysisDb::EdgeKind, kinds);
+	}
+
+#ifndef NO_CODE_ANALYSIS
+	{
+		// (pool index, instruction address, function address) and (field row, IL address, function address, is store)
+		std::vector<std::tuple<uint32_t, uint64_t, uint64_t>> poolRefs;
+		std::vector<std::tuple<uint32_t, uint64_t, uint64_t, uint8_t>> fieldRefs;
+		const auto poolLen = app.GetPool().Length();
+		for (auto dartFn : functions) {
+			auto fnData = dartFn->GetAnalyzedData();
+			if (dartFn->Size() == 0 || fnData == nullptr)
+				continue;
+			for (const auto& block : fnData->Blocks()) {
+				for (auto offset : block.poolRefs) {
+					const auto& asmText = fnData->asmTexts.AtAddr(dartFn->Address() + offset);
+					const auto idx = dart::ObjectPool::IndexFromOffset(asmText.poolOffset);
+					if (idx >= 0 && idx < poolLen)
+						poolRefs.emplace_back((uint32_t)idx, asmText.addr, dartFn->Address());
+				}
+			}
+			for (const auto& access : fnData->fieldAccesses) {
+				auto itr = fieldRow.find(access.field);
+				if (itr != fieldRow.end())
+					fieldRefs.emplace_back(itr->second, access.addr, dartFn->Address(), access.isStore);
+			}
+		}
+		std::sort(poolRefs.begin(), poolRefs.end());
+		std::sort(fieldRefs.begin(), fieldRefs.end());
+
+		std::vector<uint32_t> poolIdx, fields;
+		std::vector<uint64_t> poolAddrs, poolFns, fieldAddrs, fieldFns;
+		std::vector<uint8_t> isStores;
+		for (const auto& [idx, addr, fnAddr] : poolRefs) {
+			poolIdx.push_back(idx);
+			poolAddrs.push_back(addr);
+			poolFns.push_back(fnAddr);
+		}
+		for (const auto& [field, addr, fnAddr, isStore] : fieldRefs) {
+			fields.push_back(field);
+			fieldAddrs.push_back(addr);
+			fieldFns.push_back(fnAddr);
+			isStores.push_back(isStore);
+		}
+		db.Add(AnalysisDb::PoolRefIdx, poolIdx);
+		db.Add(AnalysisDb::PoolRefAddr, poolAddrs);
+		db.Add(AnalysisDb::PoolRefFn, poolFns);
+		db.Add(AnalysisDb::FieldRefField, fields);
+		db.Add(AnalysisDb::FieldRefAddr, fieldAddrs);
+		db.Add(AnalysisDb::FieldRefFn, fieldFns);
+		db.Add(AnalysisDb::FieldRefStore, isStores);
+	}
+#endif
+
+	const auto fileSize = db.Write(path);
+	std::cout << std::format("Analysis database: {} libraries, {} classes, {} functions, {} call edges ({:.1f} MB)\n",
+		libs.size(), classes.size(), functions.size(), numEdges, fileSize / (1024.0 * 1024.0));
+}
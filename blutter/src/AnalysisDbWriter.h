@@ -0,0 +1,13 @@
+#pragma once
+#include <filesystem>
+
+class DartApp;
+
+// write all loaded and analyzed information to one analysis database file (see AnalysisDb.h for reading it).
+//   call edges are read from the call graph file (no file when code analysis is disabled),
+//   so it must be called after CallGraph::Create(). pool descriptions are used if they are rendered (after dumping)
+class AnalysisDbWriter
+{
+public:
+	static void Create(DartApp& app, const std::filesystem::path& path, const std::filesystem::path& callGraphPath);
+};
@@ -0,0 +1,224 @@
+#include "pch.h"
+#include "ArchiveWriter.h"
+#include <array>
+#include <stdexcept>
+
+static constexpr uint32_t ZIP_LOCAL_HEADER_SIG = 0x04034b50;
+static constexpr uint32_t ZIP_DATA_DESCRIPTOR_SIG = 0x08074b50;
+static constexpr uint32_t ZIP_CENTRAL_HEADER_SIG = 0x02014b50;
+static constexpr uint32_t ZIP64_END_SIG = 0x06064b50;
+static constexpr uint32_t ZIP64_LOCATOR_SIG = 0x07064b50;
+static constexpr uint32_t ZIP_END_SIG = 0x06054b50;
+// data descriptor after data, UTF-8 name
+static constexpr uint16_t ZIP_FLAGS = 0x0808;
+// all entries have same time (1980-01-01 00:00), so same input gives same archive
+static constexpr uint16_t ZIP_TIME = 0;
+static constexpr uint16_t ZIP_DATE = (1 << 5) | 1;
+
+// crc32 (zip polynomial) with 8 tables for processing 8 bytes per step
+static constexpr auto CRC_TABLES = [] {
+	std::array<std::array<uint32_t, 256>, 8> tables{};
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (int j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+		tables[0][i] = crc;
+	}
+	for (uint32_t i = 0; i < 256; i++) {
+		for (int t = 1; t < 8; t++)
+			tables[t][i] = (tables[t - 1][i] >> 8) ^ tables[0][tables[t - 1][i] & 0xff];
+	}
+	return tables;
+}();
+
+static uint32_t crc32(uint32_t crc, const uint8_t* p, size_t size)
+{
+	crc = ~crc;
+	while (size >= 8) {
+		uint32_t lo, hi;
+		memcpy(&lo, p, 4);
+		memcpy(&hi, p + 4, 4);
+		lo ^= crc;
+		crc = CRC_TABLES[7][lo & 0xff] ^ CRC_TABLES[6][(lo >> 8) & 0xff] ^ CRC_TABLES[5][(lo >> 16) & 0xff] ^ CRC_TABLES[4][lo >> 24] ^
+			CRC_TABLES[3][hi & 0xff] ^ CRC_TABLES[2][(hi >> 8) & 0xff] ^ CRC_TABLES[1][(hi >> 16) & 0xff] ^ CRC_TABLES[0][hi >> 24];
+		p += 8;
+		size -= 8;
+	}
+	while (size-- > 0)
+		crc = CRC_TABLES[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+// little endian record builder
+class ZipRecord {
+public:
+	ZipRecord& U16(uint16_t val) { return add(val, 2); }
+	ZipRecord& U32(uint32_t val) { return add(val, 4); }
+	ZipRecord& U64(uint64_t val) { return add(val, 8); }
+	ZipRecord& Bytes(const std::string& s) {
+		data.insert(data.end(), s.begin(), s.end());
+		return *this;
+	}
+	const uint8_t* Data() const { return data.data(); }
+	size_t Size() const { return data.size(); }
+
+private:
+	ZipRecord& add(uint64_t val, int size) {
+		for (int i = 0; i < size; i++)
+			data.push_back((uint8_t)(val >> (i * 8)));
+		return *this;
+	}
+
+	std::vector<uint8_t> data;
+};
+
+ArchiveWriter::ArchiveWriter(const std::filesystem::path& path) : path(path)
+{
+#ifdef _WIN32
+	fp = _wfopen(path.c_str(), L"wb");
+#else
+	fp = fopen(path.c_str(), "wb");
+#endif
+	if (fp == nullptr)
+		throw std::runtime_error(std::format("cannot open {}", path.string()));
+	// entry data comes in big blocks from OutputSink
+	setvbuf(fp, nullptr, _IONBF, 0);
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+	try {
+		Close();
+	}
+	catch (...) {
+	}
+}
+
+void ArchiveWriter::BeginEntry(const std::string& name)
+{
+	entryMutex.lock();
+	startEntry(name);
+}
+
+void ArchiveWriter::startEntry(const std::string& name)
+{
+	if (failed) {
+		entryMutex.unlock();
+		throw std::runtime_error(std::format("cannot write {}", path.string()));
+	}
+
+	current = Entry{ name, 0, 0, offset };
+	ZipRecord rec;
+	rec.U32(ZIP_LOCAL_HEADER_SIG).U16(20).U16(ZIP_FLAGS).U16(0).U16(ZIP_TIME).U16(ZIP_DATE)
+		.U32(0).U32(0).U32(0).U16((uint16_t)name.size()).U16(0).Bytes(name);
+	try {
+		writeData(rec.Data(), rec.Size());
+	}
+	catch (...) {
+		AbortEntry();
+		throw;
+	}
+}
+
+void ArchiveWriter::Write(const char* data, size_t size)
+{
+	if (failed)
+		throw std::runtime_error(std::format("cannot write {}", path.string()));
+	current.crc = crc32(current.crc, (const uint8_t*)data, size);
+	current.size += size;
+	// data descriptor has only 32 bits sizes
+	if (current.size >= 0xffffffff) {
+		failed = true;
+		throw std::runtime_error(std::format("{} in {} is too large", current.name, path.string()));
+	}
+	writeData(data, size);
+}
+
+void ArchiveWriter::EndEntry()
+{
+	std::lock_guard lock(entryMutex, std::adopt_lock);
+	ZipRecord rec;
+	rec.U32(ZIP_DATA_DESCRIPTOR_SIG).U32(current.crc).U32((uint32_t)current.size).U32((uint32_t)current.size);
+	writeData(rec.Data(), rec.Size());
+	entryIdx.emplace(current.name, entries.size());
+	entries.push_back(std::move(current));
+}
+
+uint64_t ArchiveWriter::EntryDataOffset(const std::string& name) const
+{
+	auto itr = entryIdx.find(name);
+	if (itr == entryIdx.end())
+		throw std::runtime_error(std::format("{} is not in {}", name, path.string()));
+	const auto& entry = entries[itr->second];
+	// local header is fixed 30 bytes and the name (no extra field)
+	return entry.offset + 30 + entry.name.size();
+}
+
+void ArchiveWriter::AbortEntry()
+{
+	failed = true;
+	entryMutex.unlock();
+}
+
+void ArchiveWriter::writeData(const void* data, size_t size)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	if (fwrite(data, 1, size, fp) != size) {
+		failed = true;
+		throw std::runtime_error(std::format("cannot write {}", path.string()));
+	}
+	offset += size;
+	writeTime += std::chrono::steady_clock::now() - startTime;
+}
+
+void ArchiveWriter::Close()
+{
+	if (fp == nullptr)
+		return;
+
+	bool ok = !failed;
+	uint64_t dataSize = 0;
+	try {
+		const auto cdOffset = offset;
+		for (const auto& entry : entries) {
+			const bool needZip64 = entry.offset >= 0xffffffff;
+			ZipRecord rec;
+			rec.U32(ZIP_CENTRAL_HEADER_SIG).U16(needZip64 ? 45 : 20).U16(needZip64 ? 45 : 20).U16(ZIP_FLAGS).U16(0).U16(ZIP_TIME).U16(ZIP_DATE)
+				.U32(entry.crc).U32((uint32_t)entry.size).U32((uint32_t)entry.size)
+				.U16((uint16_t)entry.name.size()).U16(needZip64 ? 12 : 0).U16(0).U16(0).U16(0).U32(0)
+				.U32(needZip64 ? 0xffffffff : (uint32_t)entry.offset).Bytes(entry.name);
+			if (needZip64)
+				rec.U16(1).U16(8).U64(entry.offset);
+			writeData(rec.Data(), rec.Size());
+			dataSize += entry.size;
+		}
+		const auto cdSize = offset - cdOffset;
+
+		const bool needZip64 = entries.size() >= 0xffff || cdOffset >= 0xffffffff || cdSize >= 0xffffffff;
+		if (needZip64) {
+			const auto zip64EndOffset = offset;
+			ZipRecord rec;
+			rec.U32(ZIP64_END_SIG).U64(44).U16(45).U16(45).U32(0).U32(0)
+				.U64(entries.size()).U64(entries.size()).U64(cdSize).U64(cdOffset);
+			rec.U32(ZIP64_LOCATOR_SIG).U32(0).U64(zip64EndOffset).U32(1);
+			writeData(rec.Data(), rec.Size());
+		}
+		ZipRecord rec;
+		const auto numEntries = (uint16_t)std::min<size_t>(entries.size(), 0xffff);
+		rec.U32(ZIP_END_SIG).U16(0).U16(0).U16(numEntries).U16(numEntries)
+			.U32(needZip64 ? 0xffffffff : (uint32_t)cdSize).U32(needZip64 ? 0xffffffff : (uint32_t)cdOffset).U16(0);
+		writeData(rec.Data(), rec.Size());
+	}
+	catch (...) {
+		ok = false;
+	}
+	ok = fclose(fp) == 0 && ok;
+	fp = nullptr;
+	if (!ok)
+		throw std::runtime_error(std::format("cannot write {}", path.string()));
+
+	const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(writeTime).count();
+	const auto mbytes = offset / (1024.0 * 1024.0);
+	std::cout << std::format("Wrote {} files ({:.1f} MB data, {:.1f} MB archive, stored without compression) to {} in {} ms ({:.1f} MB/s)\n",
+		entries.size(), dataSize / (1024.0 * 1024.0), mbytes, path.filename().string(), elapsedMs, elapsedMs ? mbytes * 1000 / elapsedMs : 0.0);
+}
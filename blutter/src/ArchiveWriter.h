@@ -0,0 +1,62 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// zip archive that is written as a stream. entry data is written directly to the file (no seeking back) and
+//   the sizes are written after the data. the central directory (index of all entries) is written on Close().
+// only one entry is written at a time. the writer of an entry owns the archive from BeginEntry() to EndEntry().
+// entries are stored without compression because no compression library is linked.
+//   zip64 records are written only when the archive is larger than 4GB or has too many entries
+class ArchiveWriter
+{
+public:
+	explicit ArchiveWriter(const std::filesystem::path& path);
+	ArchiveWriter() = delete;
+	ArchiveWriter(const ArchiveWriter&) = delete;
+	ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+	~ArchiveWriter();
+
+	// wait until no entry is written then start the new entry
+	void BeginEntry(const std::string& name);
+	void Write(const char* data, size_t size);
+	// the archive is released even on error
+	void EndEntry();
+	// release the archive after an error. the archive is unusable
+	void AbortEntry();
+
+	// write the central directory and close the file. throw if the archive cannot be written
+	void Close();
+
+	const std::filesystem::path& Path() const { return path; }
+	// file offset of the content of a written entry. entries are stored, so the content can be read directly
+	uint64_t EntryDataOffset(const std::string& name) const;
+
+private:
+	struct Entry {
+		std::string name;
+		uint32_t crc;
+		uint64_t size;
+		uint64_t offset;
+	};
+
+	void startEntry(const std::string& name);
+	void writeData(const void* data, size_t size);
+
+	FILE* fp{ nullptr };
+	std::filesystem::path path;
+	// locked from start to end of an entry
+	std::mutex entryMutex;
+	std::vector<Entry> entries;
+	// entry name to index in entries
+	std::unordered_map<std::string, size_t> entryIdx;
+	Entry current;
+	uint64_t offset{ 0 };
+	bool failed{ false };
+	std::chrono::steady_clock::duration writeTime{ 0 };
+};
@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "AsmIndex.h"
+#include "DartClass.h"
+#include "DartFunction.h"
+#include "OutputSink.h"
+#include <fstream>
+#include <numeric>
+
+static constexpr char ASMINDEX_MAGIC[8] = { 'B', 'L', 'T', 'R', 'A', 'S', 'M', 'I' };
+static constexpr uint32_t ASMINDEX_VERSION = 1;
+
+struct AsmIndexHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t numFiles;
+	uint32_t numClasses;
+	uint32_t numFunctions;
+	uint64_t namesSize;
+};
+
+AsmIndex::AsmIndex(const std::filesystem::path& path) : file(path), baseDir(path.parent_path())
+{
+	const auto hdr = file.At<AsmIndexHeader>(0);
+	if (memcmp(hdr->magic, ASMINDEX_MAGIC, sizeof(ASMINDEX_MAGIC)) != 0 || hdr->version != ASMINDEX_VERSION)
+		throw std::runtime_error(std::format("{} is not an asm index file of this blutter version", path.string()));
+
+	numFiles = hdr->numFiles;
+	numClasses = hdr->numClasses;
+	numFunctions = hdr->numFunctions;
+	const size_t numNames = (size_t)numFiles + numClasses + numFunctions;
+	size_t offset = sizeof(AsmIndexHeader);
+	functions = file.At<Function>(offset, numFunctions);
+	offset += sizeof(Function) * numFunctions;
+	classes = file.At<Class>(offset, numClasses);
+	offset += sizeof(Class) * numClasses;
+	byName = file.At<uint32_t>(offset, numFunctions);
+	offset = MappedFile::AlignUp(offset + sizeof(uint32_t) * numFunctions);
+	nameOffsets = file.At<uint32_t>(offset, numNames + 1);
+	offset = MappedFile::AlignUp(offset + sizeof(uint32_t) * (numNames + 1));
+	names = file.At<char>(offset, hdr->namesSize);
+}
+
+std::string_view AsmIndex::name(uint32_t idx) const
+{
+	return std::string_view(names + nameOffsets[idx], nameOffsets[idx + 1] - nameOffsets[idx]);
+}
+
+uint32_t AsmIndex::FindFunction(uint64_t addr) const
+{
+	auto itr = std::lower_bound(functions, functions + numFunctions, addr, [](const Function& fn, uint64_t addr) {
+		return fn.addr < addr;
+	});
+	if (itr == functions + numFunctions || itr->addr != addr)
+		return NotFound;
+	return (uint32_t)(itr - functions);
+}
+
+std::vector<uint32_t> AsmIndex::FindFunctions(std::string_view fullName) const
+{
+	// binary search on function indexes that are sorted by name
+	auto itr = std::lower_bound(byName, byName + numFunctions, fullName, [this](uint32_t idx, std::string_view name) {
+		return FunctionName(idx) < name;
+	});
+	std::vector<uint32_t> found;
+	for (; itr != byName + numFunctions && FunctionName(*itr) == fullName; ++itr)
+		found.push_back(*itr);
+	return found;
+}
+
+std::string AsmIndex::ReadText(uint32_t idx) const
+{
+	const auto& fn = functions[idx];
+	const auto path = baseDir / std::filesystem::path(std::string(FilePath(classes[fn.cls].file)));
+	std::ifstream is(path, std::ios::binary);
+	std::string text(fn.length, '\0');
+	if (!is.seekg(fn.offset) || !is.read(text.data(), text.size()))
+		throw std::runtime_error(std::format("cannot read {}", path.string()));
+	return text;
+}
+
+void AsmIndex::Create(std::vector<FileRanges>& files, const std::filesystem::path& path)
+{
+	const auto baseDir = std::filesystem::absolute(path).parent_path();
+
+	// files in the output archive become one file with their offsets in the archive
+	std::vector<std::string> filePaths;
+	std::unordered_map<std::string, uint32_t> fileIdx;
+	std::vector<Class> classes;
+	std::vector<std::string> classNames;
+	std::vector<std::pair<Function, DartFunction*>> rawFunctions;
+	for (auto& ranges : files) {
+		std::filesystem::path filePath = ranges.path;
+		uint64_t base = 0;
+		OutputSink::ArchiveLocation(ranges.path, filePath, base);
+		const auto relPath = std::filesystem::absolute(filePath).lexically_relative(baseDir).generic_string();
+		const auto [itr, inserted] = fileIdx.try_emplace(relPath, (uint32_t)filePaths.size());
+		if (inserted)
+			filePaths.push_back(relPath);
+
+		const auto firstCls = (uint32_t)classes.size();
+		for (const auto& cls : ranges.classes) {
+			classes.push_back(Class{ base + cls.offset, cls.length, itr->second, (uint32_t)cls.cls->Id() });
+			classNames.push_back(cls.cls->FullName());
+		}
+		for (const auto& fn : ranges.functions)
+			rawFunctions.emplace_back(Function{ fn.fn->Address(), base + fn.offset, fn.length, firstCls + fn.cls }, fn.fn);
+	}
+	std::stable_sort(rawFunctions.begin(), rawFunctions.end(), [](const auto& a, const auto& b) {
+		return a.first.addr < b.first.addr;
+	});
+
+	const auto numNames = filePaths.size() + classes.size() + rawFunctions.size();
+	std::vector<uint32_t> nameOffsets(numNames + 1, 0);
+	std::string names;
+	size_t nameIdx = 0;
+	auto addName = [&](const std::string& name) {
+		names += name;
+		nameOffsets[++nameIdx] = (uint32_t)names.size();
+	};
+	for (const auto& filePath : filePaths)
+		addName(filePath);
+	for (const auto& clsName : classNames)
+		addName(clsName);
+	std::vector<Function> functions;
+	functions.reserve(rawFunctions.size());
+	for (const auto& [fn, dartFn] : rawFunctions) {
+		functions.push_back(fn);
+		addName(dartFn->FullName());
+	}
+
+	const auto fnNameStart = filePaths.size() + classes.size();
+	auto fnName = [&](uint32_t idx) {
+		const auto start = nameOffsets[fnNameStart + idx];
+		return std::string_view(names.data() + start, nameOffsets[fnNameStart + idx + 1] - start);
+	};
+	std::vector<uint32_t> byName(functions.size());
+	std::iota(byName.begin(), byName.end(), 0);
+	std::stable_sort(byName.begin(), byName.end(), [&](uint32_t a, uint32_t b) {
+		return fnName(a) < fnName(b);
+	});
+
+	IndexFileWriter of(path);
+	AsmIndexHeader hdr{};
+	memcpy(hdr.magic, ASMINDEX_MAGIC, sizeof(ASMINDEX_MAGIC));
+	hdr.version = ASMINDEX_VERSION;
+	hdr.numFiles = (uint32_t)filePaths.size();
+	hdr.numClasses = (uint32_t)classes.size();
+	hdr.numFunctions = (uint32_t)functions.size();
+	hdr.namesSize = names.size();
+	of.WriteVal(hdr);
+	of.WriteArray(functions);
+	of.WriteArray(classes);
+	of.WriteArray(byName);
+	of.Pad();
+	of.WriteArray(nameOffsets);
+	of.Pad();
+	of.Write(names.data(), names.size());
+	of.Commit();
+
+	std::cout << std::format("Asm index: {} functions in {} classes of {} files\n", functions.size(), classes.size(), filePaths.size());
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "MappedFile.h"
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class DartClass;
+class DartFunction;
+
+// location of every function and class in the asm files. functions are sorted by address, so lookup by address is
+//   binary search. then the function text is read with one read from its file (or from the output archive).
+// file layout (every section is 8 bytes aligned):
+//   Header
+//   Function functions[numFunctions] (sorted by address)
+//   Class classes[numClasses]
+//   uint32_t byName[numFunctions] (function indexes sorted by name)
+//   uint32_t nameOffsets[numFiles + numClasses + numFunctions + 1], char names[]
+//     names are file paths (relative to the index directory), class names, then function names
+class AsmIndex
+{
+public:
+	struct Function {
+		uint64_t addr;
+		uint64_t offset; // byte offset of the text in the file
+		uint32_t length;
+		uint32_t cls; // index in classes
+	};
+	struct Class {
+		uint64_t offset;
+		uint64_t length;
+		uint32_t file;
+		uint32_t id;
+	};
+
+	// text ranges of one rendered asm file. it is filled while dumping
+	struct FileRanges {
+		struct ClassRange {
+			DartClass* cls;
+			uint64_t offset;
+			uint64_t length;
+		};
+		struct FunctionRange {
+			DartFunction* fn;
+			uint32_t cls; // index in classes of this file
+			uint64_t offset;
+			uint32_t length;
+		};
+		std::string path;
+		std::vector<ClassRange> classes;
+		std::vector<FunctionRange> functions;
+	};
+
+	explicit AsmIndex(const std::filesystem::path& path);
+	AsmIndex() = delete;
+	AsmIndex(const AsmIndex&) = delete;
+	AsmIndex& operator=(const AsmIndex&) = delete;
+
+	// create index file. the file paths are stored relative to the index directory.
+	//   a file in the output archive is stored as the archive path with offsets in the archive
+	static void Create(std::vector<FileRanges>& files, const std::filesystem::path& path);
+
+	uint32_t NumFunctions() const { return numFunctions; }
+	const Function& At(uint32_t idx) const { return functions[idx]; }
+	std::string_view FunctionName(uint32_t idx) const { return name(numFiles + numClasses + idx); }
+	std::string_view ClassName(uint32_t cls) const { return name(numFiles + cls); }
+	const Class& ClassAt(uint32_t cls) const { return classes[cls]; }
+	std::string_view FilePath(uint32_t file) const { return name(file); }
+
+	static constexpr uint32_t NotFound = UINT32_MAX;
+	uint32_t FindFunction(uint64_t addr) const;
+	// functions with the full name. there might be many functions with same name in different libraries
+	std::vector<uint32_t> FindFunctions(std::string_view fullName) const;
+
+	// asm text of the function. one seek and one read
+	std::string ReadText(uint32_t idx) const;
+
+private:
+	std::string_view name(uint32_t idx) const;
+
+	MappedFile file;
+	std::filesystem::path baseDir;
+	uint32_t numFiles;
+	uint32_t numClasses;
+	uint32_t numFunctions;
+	const Function* functions;
+	const Class* classes;
+	const uint32_t* byName;
+	const uint32_t* nameOffsets;
+	const char* names;
+};
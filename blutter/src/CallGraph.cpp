@@ -0,0 +1,227 @@
+#include "pch.h"
+#include "CallGraph.h"
+#include "DartApp.h"
+#include "CodeAnalyzer.h"
+
+static constexpr char CALLGRAPH_MAGIC[8] = { 'B', 'L', 'T', 'R', 'C', 'G', 'R', 'P' };
+static constexpr uint32_t CALLGRAPH_VERSION = 1;
+
+struct CallGraphHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t numNodes;
+	uint32_t numEdges;
+	uint32_t numCallerEdges;
+	uint64_t namesSize;
+};
+
+CallGraph::CallGraph(const std::filesystem::path& path) : file(path)
+{
+	const auto hdr = file.At<CallGraphHeader>(0);
+	if (memcmp(hdr->magic, CALLGRAPH_MAGIC, sizeof(CALLGRAPH_MAGIC)) != 0 || hdr->version != CALLGRAPH_VERSION)
+		throw std::runtime_error(std::format("{} is not a call graph file of this blutter version", path.string()));
+
+	numNodes = hdr->numNodes;
+	size_t offset = sizeof(CallGraphHeader);
+	addrs = file.At<uint64_t>(offset, numNodes);
+	offset += sizeof(uint64_t) * numNodes;
+	calleeOffsets = file.At<uint32_t>(offset, numNodes + 1);
+	offset = MappedFile::AlignUp(offset + sizeof(uint32_t) * (numNodes + 1));
+	callees = file.At<Edge>(offset, hdr->numEdges);
+	offset += sizeof(Edge) * hdr->numEdges;
+	callerOffsets = file.At<uint32_t>(offset, numNodes + 1);
+	offset = MappedFile::AlignUp(offset + sizeof(uint32_t) * (numNodes + 1));
+	callers = file.At<Edge>(offset, hdr->numCallerEdges);
+	offset += sizeof(Edge) * hdr->numCallerEdges;
+	nameOffsets = file.At<uint32_t>(offset, numNodes + 1);
+	offset = MappedFile::AlignUp(offset + sizeof(uint32_t) * (numNodes + 1));
+	names = file.At<char>(offset, hdr->namesSize);
+}
+
+uint32_t CallGraph::FindNode(uint64_t addr) const
+{
+	auto itr = std::lower_bound(addrs, addrs + numNodes, addr);
+	if (itr == addrs + numNodes || *itr != addr)
+		return UnknownNode;
+	return (uint32_t)(itr - addrs);
+}
+
+uint32_t CallGraph::FindNode(std::string_view name) const
+{
+	for (uint32_t i = 0; i < numNodes; i++) {
+		if (Name(i) == name)
+			return i;
+	}
+	return UnknownNode;
+}
+
+std::string_view CallGraph::Name(uint32_t node) const
+{
+	return std::string_view(names + nameOffsets[node], nameOffsets[node + 1] - nameOffsets[node]);
+}
+
+std::span<const CallGraph::Edge> CallGraph::Callees(uint32_t node) const
+{
+	return std::span<const Edge>(callees + calleeOffsets[node], calleeOffsets[node + 1] - calleeOffsets[node]);
+}
+
+std::span<const CallGraph::Edge> CallGraph::Callers(uint32_t node) const
+{
+	return std::span<const Edge>(callers + callerOffsets[node], callerOffsets[node + 1] - callerOffsets[node]);
+}
+
+std::vector<uint32_t> CallGraph::Reachable(uint32_t node) const
+{
+	std::vector<bool> visited(numNodes);
+	std::vector<uint32_t> result;
+	std::vector<uint32_t> stack{ node };
+	visited[node] = true;
+	while (!stack.empty()) {
+		const auto cur = stack.back();
+		stack.pop_back();
+		for (const auto& edge : Callees(cur)) {
+			if (edge.node == UnknownNode || visited[edge.node])
+				continue;
+			visited[edge.node] = true;
+			result.push_back(edge.node);
+			stack.push_back(edge.node);
+		}
+	}
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+const char* CallGraph::KindName(uint32_t kind)
+{
+	switch (kind) {
+	case Direct: return "call";
+	case TailCall: return "tail";
+	case Dispatch: return "dispatch";
+	case Closure: return "closure";
+	}
+	return "unknown";
+}
+
+#ifndef NO_CODE_ANALYSIS
+void CallGraph::Create(DartApp& app, const std::filesystem::path& path)
+{
+	struct RawEdge {
+		DartFnBase* caller;
+		DartFnBase* callee; // nullptr for closure call
+		uint32_t kind;
+	};
+	std::vector<RawEdge> rawEdges;
+	std::unordered_map<uint64_t, DartFnBase*> nodeFns;
+
+	for (auto lib : app.libs) {
+		if (lib->isInternal)
+			continue;
+		for (auto cls : lib->classes) {
+			for (auto dartFn : cls->Functions()) {
+				auto fnData = dartFn->GetAnalyzedData();
+				if (dartFn->Size() == 0 || fnData == nullptr)
+					continue;
+				nodeFns[dartFn->Address()] = dartFn;
+
+				// direct calls are in block summaries (also for the functions from analysis cache)
+				for (const auto& block : fnData->Blocks()) {
+					for (auto offset : block.calls) {
+						const auto& asmText = fnData->asmTexts.AtAddr(dartFn->Address() + offset);
+						auto callee = app.GetFunction(asmText.callAddress);
+						if (callee == nullptr)
+							continue;
+						const auto word = *(const uint32_t*)(app.base() + asmText.addr);
+						// BL or B
+						const uint32_t kind = (word & 0xfc000000) == 0x94000000 ? Direct : TailCall;
+						nodeFns[callee->Address()] = callee;
+						rawEdges.push_back(RawEdge{ dartFn, callee, kind });
+					}
+				}
+				for (const auto& il : fnData->ILs()) {
+					if (il->Kind() == ILInstr::GdtCall) {
+						for (auto callee : reinterpret_cast<GdtCallInstr*>(il.get())->Targets()) {
+							nodeFns[callee->Address()] = callee;
+							rawEdges.push_back(RawEdge{ dartFn, callee, Dispatch });
+						}
+					}
+					else if (il->Kind() == ILInstr::ClosureCall) {
+						rawEdges.push_back(RawEdge{ dartFn, nullptr, Closure });
+					}
+				}
+			}
+		}
+	}
+
+	// node index is sorted by address, so lookup by address is binary search
+	std::vector<DartFnBase*> nodes;
+	nodes.reserve(nodeFns.size());
+	for (auto& [_, fn] : nodeFns)
+		nodes.push_back(fn);
+	std::sort(nodes.begin(), nodes.end(), [](DartFnBase* a, DartFnBase* b) { return a->Address() < b->Address(); });
+	std::unordered_map<DartFnBase*, uint32_t> nodeIdx;
+	for (uint32_t i = 0; i < nodes.size(); i++)
+		nodeIdx[nodes[i]] = i;
+
+	std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> edges; // caller, callee, kind
+	edges.reserve(rawEdges.size());
+	for (const auto& raw : rawEdges)
+		edges.emplace_back(nodeIdx.at(raw.caller), raw.callee ? nodeIdx.at(raw.callee) : UnknownNode, raw.kind);
+	std::sort(edges.begin(), edges.end());
+	edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+	const auto num = (uint32_t)nodes.size();
+	std::vector<uint32_t> calleeOffsets(num + 1, 0);
+	std::vector<uint32_t> callerOffsets(num + 1, 0);
+	for (const auto& [caller, callee, kind] : edges) {
+		calleeOffsets[caller + 1]++;
+		if (callee != UnknownNode)
+			callerOffsets[callee + 1]++;
+	}
+	for (uint32_t i = 0; i < num; i++) {
+		calleeOffsets[i + 1] += calleeOffsets[i];
+		callerOffsets[i + 1] += callerOffsets[i];
+	}
+	// edges are sorted by caller. callees can be copied directly
+	std::vector<Edge> callees;
+	callees.reserve(edges.size());
+	std::vector<Edge> callers(callerOffsets[num]);
+	auto callerPos = callerOffsets;
+	for (const auto& [caller, callee, kind] : edges) {
+		callees.push_back(Edge{ callee, kind });
+		if (callee != UnknownNode)
+			callers[callerPos[callee]++] = Edge{ caller, kind };
+	}
+
+	std::vector<uint32_t> nameOffsets(num + 1, 0);
+	std::string names;
+	for (uint32_t i = 0; i < num; i++) {
+		names += nodes[i]->FullName();
+		nameOffsets[i + 1] = (uint32_t)names.size();
+	}
+
+	IndexFileWriter of(path);
+	CallGraphHeader hdr{};
+	memcpy(hdr.magic, CALLGRAPH_MAGIC, sizeof(CALLGRAPH_MAGIC));
+	hdr.version = CALLGRAPH_VERSION;
+	hdr.numNodes = num;
+	hdr.numEdges = (uint32_t)callees.size();
+	hdr.numCallerEdges = (uint32_t)callers.size();
+	hdr.namesSize = names.size();
+	of.WriteVal(hdr);
+	for (auto fn : nodes) {
+		of.WriteVal((uint64_t)fn->Address());
+	}
+	of.WriteArray(calleeOffsets);
+	of.Pad();
+	of.WriteArray(callees);
+	of.WriteArray(callerOffsets);
+	of.Pad();
+	of.WriteArray(callers);
+	of.WriteArray(nameOffsets);
+	of.Pad();
+	of.Write(names.data(), names.size());
+	of.Commit();
+
+	std::cout << std::format("Call graph: {} functions, {} edges\n", num, callees.size());
+}
+#endif // NO_CODE_ANALYSIS
@@ -0,0 +1,66 @@
+#pragma once
+#include "MappedFile.h"
+#include <span>
+#include <string_view>
+#include <vector>
+
+class DartApp;
+
+// whole program call graph. it is created from analyzed functions and saved as a file that can be
+//   queried later without loading the app.
+// file layout (every section is 8 bytes aligned):
+//   Header
+//   uint64_t address[numNodes] (sorted)
+//   uint32_t calleeOffsets[numNodes + 1], Edge callees[numEdges]
+//   uint32_t callerOffsets[numNodes + 1], Edge callers[numCallerEdges]
+//   uint32_t nameOffsets[numNodes + 1], char names[]
+class CallGraph
+{
+public:
+	enum EdgeKind : uint32_t {
+		Direct = 0, // bl
+		TailCall,   // b to other function
+		Dispatch,   // global dispatch table
+		Closure,    // closure call (callee is unknown)
+	};
+	struct Edge {
+		uint32_t node; // UnknownNode if callee is unknown
+		uint32_t kind;
+	};
+	static constexpr uint32_t UnknownNode = UINT32_MAX;
+
+	explicit CallGraph(const std::filesystem::path& path);
+	CallGraph() = delete;
+	CallGraph(const CallGraph&) = delete;
+	CallGraph& operator=(const CallGraph&) = delete;
+
+#ifndef NO_CODE_ANALYSIS
+	// create call graph file from analyzed functions
+	static void Create(DartApp& app, const std::filesystem::path& path);
+#endif
+
+	uint32_t NumNodes() const { return numNodes; }
+	// return UnknownNode if not found. name lookup is linear search
+	uint32_t FindNode(uint64_t addr) const;
+	uint32_t FindNode(std::string_view name) const;
+	uint64_t Address(uint32_t node) const { return addrs[node]; }
+	std::string_view Name(uint32_t node) const;
+
+	std::span<const Edge> Callees(uint32_t node) const;
+	std::span<const Edge> Callers(uint32_t node) const;
+	// all functions that can be reached from the node (not include the node itself)
+	std::vector<uint32_t> Reachable(uint32_t node) const;
+
+	static const char* KindName(uint32_t kind);
+
+private:
+	MappedFile file;
+	uint32_t numNodes;
+	const uint64_t* addrs;
+	const uint32_t* calleeOffsets;
+	const Edge* callees;
+	const uint32_t* callerOffsets;
+	const Edge* callers;
+	const uint32_t* nameOffsets;
+	const char* names;
+};
@@ -0,0 +1,168 @@
+#include "pch.h"
+#include "ClassHierarchy.h"
+#include "DartClass.h"
+
+static constexpr uint32_t NoOrder = UINT32_MAX;
+
+ClassHierarchy::ClassHierarchy(const std::vector<DartClass*>& classes)
+{
+	const auto num = classes.size();
+
+	// count first, then fill (CSR)
+	childOffsets.assign(num + 1, 0);
+	implOffsets.assign(num + 1, 0);
+	for (auto dartCls : classes) {
+		if (dartCls == nullptr)
+			continue;
+		if (dartCls->Parent())
+			childOffsets[dartCls->Parent()->Id() + 1]++;
+		for (auto iface : dartCls->interfaces) {
+			if (iface)
+				implOffsets[iface->Id() + 1]++;
+		}
+		if (dartCls->mixin)
+			implOffsets[dartCls->mixin->Id() + 1]++;
+	}
+	for (size_t i = 0; i < num; i++) {
+		childOffsets[i + 1] += childOffsets[i];
+		implOffsets[i + 1] += implOffsets[i];
+	}
+
+	childList.resize(childOffsets[num]);
+	implList.resize(implOffsets[num]);
+	auto childPos = childOffsets;
+	auto implPos = implOffsets;
+	for (auto dartCls : classes) {
+		if (dartCls == nullptr)
+			continue;
+		if (dartCls->Parent())
+			childList[childPos[dartCls->Parent()->Id()]++] = dartCls;
+		for (auto iface : dartCls->interfaces) {
+			if (iface)
+				implList[implPos[iface->Id()]++] = dartCls;
+		}
+		if (dartCls->mixin)
+			implList[implPos[dartCls->mixin->Id()]++] = dartCls;
+	}
+
+	// number the super class tree. use explicit stack because the hierarchy can be deep
+	preOrder.assign(num, NoOrder);
+	postOrder.assign(num, NoOrder);
+	subtreeSize.assign(num, 0);
+	preOrderList.reserve(num);
+	uint32_t postCnt = 0;
+	std::vector<std::pair<DartClass*, uint32_t>> stack;
+	for (auto root : classes) {
+		if (root == nullptr || root->Parent() != nullptr)
+			continue;
+		stack.emplace_back(root, childOffsets[root->Id()]);
+		preOrder[root->Id()] = (uint32_t)preOrderList.size();
+		preOrderList.push_back(root);
+		while (!stack.empty()) {
+			auto& [dartCls, next] = stack.back();
+			const auto id = dartCls->Id();
+			if (next < childOffsets[id + 1]) {
+				auto child = childList[next++];
+				preOrder[child->Id()] = (uint32_t)preOrderList.size();
+				preOrderList.push_back(child);
+				stack.emplace_back(child, childOffsets[child->Id()]);
+			}
+			else {
+				postOrder[id] = postCnt++;
+				subtreeSize[id] = (uint32_t)preOrderList.size() - preOrder[id];
+				stack.pop_back();
+			}
+		}
+	}
+
+	// transitive super types of every class (sorted class ids include itself). a class is done after its direct super types
+	std::vector<std::vector<uint32_t>> supers(num);
+	std::vector<uint8_t> state(num, 0); // 0: not visited, 1: visiting, 2: done
+	auto forEachDirectSuper = [](const DartClass& dartCls, auto&& fn) {
+		if (dartCls.Parent())
+			fn(*dartCls.Parent());
+		for (auto iface : dartCls.interfaces) {
+			if (iface)
+				fn(*iface);
+		}
+		if (dartCls.mixin)
+			fn(*dartCls.mixin);
+	};
+	std::vector<DartClass*> pending;
+	for (auto dartCls : classes) {
+		if (dartCls == nullptr || state[dartCls->Id()] == 2)
+			continue;
+		pending.push_back(dartCls);
+		while (!pending.empty()) {
+			auto cur = pending.back();
+			const auto id = cur->Id();
+			if (state[id] == 0) {
+				state[id] = 1;
+				forEachDirectSuper(*cur, [&](const DartClass& sup) {
+					if (state[sup.Id()] == 0)
+						pending.push_back(const_cast<DartClass*>(&sup));
+				});
+				continue;
+			}
+			pending.pop_back();
+			if (state[id] == 2)
+				continue;
+			auto& list = supers[id];
+			list.push_back(id);
+			forEachDirectSuper(*cur, [&](const DartClass& sup) {
+				const auto& supList = supers[sup.Id()];
+				list.insert(list.end(), supList.begin(), supList.end());
+			});
+			std::sort(list.begin(), list.end());
+			list.erase(std::unique(list.begin(), list.end()), list.end());
+			state[id] = 2;
+		}
+	}
+	superOffsets.assign(num + 1, 0);
+	for (size_t i = 0; i < num; i++)
+		superOffsets[i + 1] = superOffsets[i] + (uint32_t)supers[i].size();
+	superList.reserve(superOffsets[num]);
+	for (auto& list : supers)
+		superList.insert(superList.end(), list.begin(), list.end());
+}
+
+size_t ClassHierarchy::index(const DartClass& cls) const
+{
+	if (cls.Id() >= preOrder.size())
+		throw std::runtime_error(std::format("class id {} is not in the class hierarchy", cls.Id()));
+	return cls.Id();
+}
+
+std::span<DartClass* const> ClassHierarchy::Children(const DartClass& cls) const
+{
+	const auto id = index(cls);
+	return std::span<DartClass* const>(childList.data() + childOffsets[id], childOffsets[id + 1] - childOffsets[id]);
+}
+
+std::span<DartClass* const> ClassHierarchy::Implementors(const DartClass& cls) const
+{
+	const auto id = index(cls);
+	return std::span<DartClass* const>(implList.data() + implOffsets[id], implOffsets[id + 1] - implOffsets[id]);
+}
+
+std::span<DartClass* const> ClassHierarchy::Subtree(const DartClass& cls) const
+{
+	const auto id = index(cls);
+	return std::span<DartClass* const>(preOrderList.data() + preOrder[id], subtreeSize[id]);
+}
+
+bool ClassHierarchy::IsSubclassOf(const DartClass& cls, const DartClass& parent) const
+{
+	const auto id = index(cls);
+	const auto parentId = index(parent);
+	return preOrder[parentId] <= preOrder[id] && postOrder[id] <= postOrder[parentId];
+}
+
+bool ClassHierarchy::IsSubtypeOf(const DartClass& cls, const DartClass& type) const
+{
+	const auto id = index(cls);
+	const auto typeId = (uint32_t)index(type);
+	const auto first = superList.begin() + superOffsets[id];
+	const auto last = superList.begin() + superOffsets[id + 1];
+	return std::binary_search(first, last, typeId);
+}
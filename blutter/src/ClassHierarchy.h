@@ -0,0 +1,52 @@
+#pragma once
+#include <span>
+#include <vector>
+
+class DartClass;
+
+// downward index of class hierarchy. it is built once after all classes are loaded.
+// children and implementors are stored as CSR (offsets array + one list) indexed by class id.
+// classes are numbered by pre/post order of the super class tree, so all subclasses of a class
+//   are contiguous in pre-order list and subclass check is just comparing the numbers.
+class ClassHierarchy
+{
+public:
+	explicit ClassHierarchy(const std::vector<DartClass*>& classes);
+	ClassHierarchy() = delete;
+	ClassHierarchy(const ClassHierarchy&) = delete;
+	ClassHierarchy& operator=(const ClassHierarchy&) = delete;
+
+	// direct subclasses
+	std::span<DartClass* const> Children(const DartClass& cls) const;
+	// classes that directly implement or mix in the class
+	std::span<DartClass* const> Implementors(const DartClass& cls) const;
+	// the class and all its subclasses (pre-order)
+	std::span<DartClass* const> Subtree(const DartClass& cls) const;
+
+	// true if cls is parent or cls itself
+	bool IsSubclassOf(const DartClass& cls, const DartClass& parent) const;
+	// IsSubclassOf() or cls (or its parents) implements or mixes in the type
+	bool IsSubtypeOf(const DartClass& cls, const DartClass& type) const;
+
+	uint32_t PreOrder(const DartClass& cls) const { return preOrder.at(index(cls)); }
+	uint32_t PostOrder(const DartClass& cls) const { return postOrder.at(index(cls)); }
+
+private:
+	// throw if the class is not from the classes of this hierarchy
+	size_t index(const DartClass& cls) const;
+
+	// CSR of children and implementors. the range of class id i is [offsets[i], offsets[i+1])
+	std::vector<uint32_t> childOffsets;
+	std::vector<DartClass*> childList;
+	std::vector<uint32_t> implOffsets;
+	std::vector<DartClass*> implList;
+	// CSR of sorted transitive super types (parents, interfaces and mixins) including the class itself
+	std::vector<uint32_t> superOffsets;
+	std::vector<uint32_t> superList;
+
+	std::vector<uint32_t> preOrder;
+	std::vector<uint32_t> postOrder;
+	// number of classes in subtree (include itself)
+	std::vector<uint32_t> subtreeSize;
+	std::vector<DartClass*> preOrderList;
+};
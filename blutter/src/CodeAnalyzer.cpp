@@ -1,6 +1,9 @@
 #include "pch.h"
 #include "CodeAnalyzer.h"
 #include "DartApp.h"
+#include "AnalysisCache.h"
+#include <chrono>
+#include <map>
 
 #ifndef NO_CODE_ANALYSIS
 
@@ -9,13 +12,86 @@ AnalyzedFnData::AnalyzedFnData(DartApp& app, DartFunction& dartFn, AsmTexts asmT
 {
 }
 
+void AnalyzingState::ClearAllRegisters()
+{
+	for (auto val : frame->regs) {
+		if (val) {
+			own().regs.fill(nullptr);
+			break;
+		}
+	}
+}
+
+bool AnalyzingState::Merge(const AnalyzingState& other)
+{
+	if (frame == other.frame)
+		return false;
+	bool changed = false;
+	for (size_t i = 0; i < frame->regs.size(); i++) {
+		if (frame->regs[i] && frame->regs[i] != other.frame->regs[i]) {
+			own().regs[i] = nullptr;
+			changed = true;
+		}
+	}
+	ASSERT(frame->local_vars.size() == other.frame->local_vars.size());
+	for (size_t i = 0; i < frame->local_vars.size(); i++) {
+		if (frame->local_vars[i] && frame->local_vars[i] != other.frame->local_vars[i]) {
+			own().local_vars[i] = nullptr;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+CodeAnalyzer::CodeAnalyzer(DartApp& app) : app(app)
+{
+}
+
+CodeAnalyzer::~CodeAnalyzer() = default;
+
+void CodeAnalyzer::UseCache(std::filesystem::path path)
+{
+	cache = std::make_unique<AnalysisCache>(app, std::move(path));
+	std::cout << std::format("Loaded {} functions from analysis cache\n", cache->NumEntries());
+}
+
 void CodeAnalyzer::AnalyzeAll()
 {
-	Disassembler disasmer;
+	// most instruction details are never inspected. decode them only when needed
+	Disassembler disasmer{ Disassembler::OnDemandDetail };
+	const auto startTime = std::chrono::steady_clock::now();
+	size_t numFn = 0;
+	size_t numIL = 0;
+	size_t ilBytes = 0;
+	size_t ilHeapBytes = 0;
+
+	// functions with same code (trivial getters, forwarders, copied operators) are analyzed only once.
+	// besides the code hash, the key contains all function info that the analyzer uses.
+	//   the owner class matters only for instance method (type of "this" parameter)
+	using SameCodeKey = std::tuple<uint64_t, int64_t, intptr_t, int, int>;
+	struct SameCodeInfo {
+		AnalyzedFnData* fnData; // nullptr if the analyzed data cannot be shared
+		std::chrono::microseconds elapsed;
+	};
+	std::map<SameCodeKey, SameCodeInfo> sameCodeFns;
+	size_t numSameCode = 0;
+	std::chrono::microseconds savedTime{ 0 };
+	size_t numSkipped = 0;
+	size_t numCacheHit = 0;
+	std::chrono::microseconds cacheSavedTime{ 0 };
+	ValueTrackingStats trackingTotal;
+	struct BenchmarkInfo {
+		DartFunction* dartFn;
+		size_t numIL;
+		ValueTrackingStats tracking;
+		std::chrono::microseconds elapsed;
+	};
+	std::vector<BenchmarkInfo> benchmarks;
 
 	for (auto lib : app.libs) {
 		if (lib->isInternal)
 			continue;
+		const bool skipLib = skipKnownPackages && !lib->knownPackage.empty();
 		for (auto cls : lib->classes) {
 			for (auto dartFn : cls->Functions()) {
 				if (dartFn->Size() == 0)
@@ -23,39 +99,186 @@ void CodeAnalyzer::AnalyzeAll()
 
 				// start from PayloadAddress or Address?
 				// the assemblies will be deleted after finish analysis because assembly with details consume too much memory
-				auto asm_insns = disasmer.Disasm((uint8_t*)dartFn->MemAddress(), dartFn->Size(), dartFn->Address());
+				auto asm_insns = app.codeInsns ? app.codeInsns->View(dartFn->Address(), dartFn->Size()) :
+					disasmer.Disasm((uint8_t*)dartFn->MemAddress(), dartFn->Size(), dartFn->Address());
 
 				dartFn->SetAnalyzedData(std::make_unique<AnalyzedFnData>(app, *dartFn, convertAsm(asm_insns)));
+				auto fnData = dartFn->GetAnalyzedData();
+				numFn++;
+				if (skipLib) {
+					numSkipped++;
+					continue;
+				}
+
+				const int fnFlags = (dartFn->IsStatic() ? 1 : 0) | (dartFn->IsClosure() ? 2 : 0) | (dartFn->IsAsync() ? 4 : 0);
+				const SameCodeKey key{ codeHash(*dartFn), dartFn->Size(), dartFn->IsStatic() ? -1 : (intptr_t)cls->Id(), fnFlags, dartFn->NumParam() };
+				auto sameCodeItr = sameCodeFns.find(key);
+				if (sameCodeItr != sameCodeFns.end() && sameCodeItr->second.fnData) {
+					shareAnalyzedData(*fnData, *sameCodeItr->second.fnData);
+					numSameCode++;
+					savedTime += sameCodeItr->second.elapsed;
+					continue;
+				}
+
+				const auto fnStartTime = std::chrono::steady_clock::now();
+				auto& ilArena = fnData->ilArena;
+				bool fromCache = false;
+				uint32_t cachedElapsedUs = 0;
+				ValueTrackingStats tracking;
+				{
+					ILArena::Scope arenaScope{ ilArena };
+					fromCache = cache && cache->Restore(*fnData, cachedElapsedUs);
+					if (!fromCache)
+						tracking = asm2il(dartFn, asm_insns);
+					else
+						buildBlocks(*fnData, asm_insns);
+				}
+				numIL += ilArena.NumAllocs();
+				ilBytes += ilArena.BytesReserved();
+				ilHeapBytes += ilArena.HeapBytesEstimate();
+
+				auto fnElapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - fnStartTime);
+				if (fromCache) {
+					numCacheHit++;
+					cacheSavedTime += std::chrono::microseconds(cachedElapsedUs) - fnElapsed;
+					// report the original analysis time for the same code functions
+					fnElapsed = std::chrono::microseconds(cachedElapsedUs);
+				}
+				else {
+					trackingTotal.numBlocks += tracking.numBlocks;
+					trackingTotal.numVisits += tracking.numVisits;
+					trackingTotal.elapsedUs += tracking.elapsedUs;
+					if (benchmarkCount > 0)
+						benchmarks.push_back(BenchmarkInfo{ dartFn, fnData->il_insns.size(), tracking, fnElapsed });
+				}
+				const bool relocatable = isRelocatable(*fnData);
+				if (cache && !fromCache && relocatable)
+					cache->Add(*fnData, (uint32_t)fnElapsed.count());
 
-				asm2il(dartFn, asm_insns);
+				if (sameCodeItr == sameCodeFns.end()) {
+					sameCodeFns.emplace(key, SameCodeInfo{ relocatable ? fnData : nullptr, fnElapsed });
+				}
 			}
 		}
 	}
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+	const auto numInsns = app.codeInsns ? app.codeInsns->Count() : disasmer.NumInsns();
+	const auto numDetails = Disassembler::NumDetailDecoded();
+	std::cout << std::format("Analyzed {} functions ({} instructions, {} details decoded ({:.1f}%, {} without capstone), {} allocations) in {} ms\n",
+		numFn, numInsns, numDetails, numInsns ? numDetails * 100.0 / numInsns : 0.0, Disassembler::NumNativeDecoded(), disasmer.NumAllocs(), elapsed);
+	if (skipKnownPackages)
+		std::cout << std::format("Skipped analysis of {} functions in known packages\n", numSkipped);
+	std::cout << std::format("Reused analysis of same code for {} functions ({:.1f}%), saved about {} ms\n",
+		numSameCode, numFn ? numSameCode * 100.0 / numFn : 0.0, savedTime.count() / 1000);
+	std::cout << std::format("Created {} ILs: {:.1f} bytes/IL in arena ({:.1f} bytes/IL if allocated separately)\n",
+		numIL, numIL ? (double)ilBytes / numIL : 0.0, numIL ? (double)ilHeapBytes / numIL : 0.0);
+	std::cout << std::format("Tracked values in {} blocks with {} block visits ({:.2f} visits/block) in {} ms\n",
+		trackingTotal.numBlocks, trackingTotal.numVisits, trackingTotal.numBlocks ? (double)trackingTotal.numVisits / trackingTotal.numBlocks : 0.0,
+		trackingTotal.elapsedUs / 1000);
+
+	if (!benchmarks.empty()) {
+		const auto count = std::min<size_t>(benchmarkCount, benchmarks.size());
+		std::partial_sort(benchmarks.begin(), benchmarks.begin() + count, benchmarks.end(),
+			[](const BenchmarkInfo& a, const BenchmarkInfo& b) { return a.dartFn->Size() > b.dartFn->Size(); });
+		std::cout << std::format("{:>8} {:>7} {:>6} {:>7} {:>10} {:>11}  function\n", "size", "ILs", "blocks", "visits", "tracking", "analysis");
+		for (size_t i = 0; i < count; i++) {
+			const auto& info = benchmarks[i];
+			std::cout << std::format("{:>8} {:>7} {:>6} {:>7} {:>8}us {:>9}us  {}\n", info.dartFn->Size(), info.numIL,
+				info.tracking.numBlocks, info.tracking.numVisits, info.tracking.elapsedUs, info.elapsed.count(), info.dartFn->FullName());
+		}
+	}
+
+	if (cache) {
+		const auto numAnalyzed = numFn - numSameCode - numSkipped;
+		std::cout << std::format("Analysis cache: {} hits of {} functions ({:.1f}%), saved about {} ms\n",
+			numCacheHit, numAnalyzed, numAnalyzed ? numCacheHit * 100.0 / numAnalyzed : 0.0, std::max<int64_t>(cacheSavedTime.count(), 0) / 1000);
+		cache->Save();
+	}
+}
+
+void CodeAnalyzer::shareAnalyzedData(AnalyzedFnData& fnData, AnalyzedFnData& srcData)
+{
+	const int64_t delta = fnData.dartFn.Address() - srcData.dartFn.Address();
+	fnData.sameCode = &srcData;
+	fnData.sameCodeDelta = delta;
+	fnData.stackSize = srcData.stackSize;
+
+	fnData.fieldAccesses = srcData.fieldAccesses;
+	for (auto& access : fnData.fieldAccesses)
+		access.addr += delta;
+
+	// same code has same instructions. only the annotations from analysis are copied
+	auto& asmTexts = fnData.asmTexts.Data();
+	const auto& srcAsmTexts = srcData.asmTexts.Data();
+	ASSERT(asmTexts.size() == srcAsmTexts.size());
+	for (size_t i = 0; i < asmTexts.size(); i++) {
+		auto& asmText = asmTexts[i];
+		const auto& srcAsmText = srcAsmTexts[i];
+		asmText.dataType = srcAsmText.dataType;
+		switch (srcAsmText.dataType) {
+		case AsmText::ThreadOffset:
+			asmText.threadOffset = srcAsmText.threadOffset;
+			break;
+		case AsmText::PoolOffset:
+			asmText.poolOffset = srcAsmText.poolOffset;
+			break;
+		case AsmText::Boolean:
+			asmText.boolVal = srcAsmText.boolVal;
+			break;
+		case AsmText::Call:
+			// call target outside function is same address (see codeHash())
+			asmText.callAddress = srcData.dartFn.ContainsAddress(srcAsmText.callAddress) ? srcAsmText.callAddress + delta : srcAsmText.callAddress;
+			break;
+		}
+	}
+}
+
+bool CodeAnalyzer::isRelocatable(AnalyzedFnData& fnData)
+{
+	for (const auto& il : fnData.il_insns) {
+		// branch address is shown in IL text
+		if (il->OriginalKind() == ILInstr::BranchIfSmi)
+			return false;
+	}
+	return true;
 }
 
 #endif // NO_CODE_ANALYSIS
 
 std::string FnParamInfo::ToString() const
 {
-	std::string txt = type ? type->ToString() : "dynamic";
-	txt += ' ';
-	txt += name.empty() ? "_" : name;
+	fmt::memory_buffer out;
+	AppendTo(out);
+	return fmt::to_string(out);
+}
+
+void FnParamInfo::AppendTo(fmt::memory_buffer& out) const
+{
+	if (type)
+		type->AppendTo(out);
+	else
+		Util::Append(out, "dynamic");
+	out.push_back(' ');
+	if (name.empty())
+		out.push_back('_');
+	else
+		Util::Append(out, name);
 	if (val) {
-		txt += " = ";
-		txt += val->ToString();
+		Util::Append(out, " = ");
+		val->AppendTo(out);
 	}
 	if (valReg.IsSet() || localOffset) {
-		txt += " /* ";
+		Util::Append(out, " /* ");
 		if (valReg.IsSet()) {
-			txt += valReg.Name();
+			Util::Append(out, valReg.Name());
 			if (localOffset)
-				txt += ", ";
+				Util::Append(out, ", ");
 		}
 		if (localOffset)
-			txt += std::format("fp-{:#x}", -localOffset);
-		txt += " */";
+			fmt::format_to(std::back_inserter(out), "fp-{:#x}", -localOffset);
+		Util::Append(out, " */");
 	}
-	return txt;
 }
 
 FnParamInfo* FnParams::findValReg(A64::Register reg)
@@ -81,18 +304,22 @@ bool FnParams::movValReg(A64::Register dstReg, A64::Register srcReg)
 
 std::string FnParams::ToString() const
 {
-	std::string txt;
+	fmt::memory_buffer out;
+	AppendTo(out);
+	return fmt::to_string(out);
+}
+
+void FnParams::AppendTo(fmt::memory_buffer& out) const
+{
 	for (int i = 0; i < params.size(); i++) {
 		if (i != 0)
-			txt += ", ";
+			Util::Append(out, ", ");
 		if (i == numFixedParam)
-			txt += isNamedParam ? '{' : '[';
+			out.push_back(isNamedParam ? '{' : '[');
 
-		txt += params[i].ToString();
+		params[i].AppendTo(out);
 	}
 
 	if (numFixedParam < params.size())
-		txt += isNamedParam ? '}' : ']';
-
-	return txt;
+		out.push_back(isNamedParam ? '}' : ']');
 }
@@ -2,10 +2,13 @@
 #include "Disassembler.h"
 #include "il.h"
 #include <array>
+#include <filesystem>
 
 // forward declaration
 class DartApp;
 class DartFunction;
+class AnalysisCache;
+class DartField;
 
 struct AsmText {
 	enum DataType : uint8_t {
@@ -64,16 +67,17 @@ struct FnParamInfo {
 	int32_t localOffset{ 0 }; // offset from FP (local variable)
 	DartType* type{ nullptr };
 	std::string name;
-	std::unique_ptr<VarValue> val;
+	VarValuePtr val;
 	explicit FnParamInfo(A64::Register valReg) : valReg(valReg) {}
 	explicit FnParamInfo(A64::Register valReg, int32_t localOffset) : valReg(valReg), localOffset(localOffset) {}
-	explicit FnParamInfo(A64::Register valReg, std::unique_ptr<VarValue> val) : valReg(valReg), val(std::move(val)) {}
-	explicit FnParamInfo(A64::Register valReg, int32_t localOffset, DartType* type, std::string name, std::unique_ptr<VarValue> val)
+	explicit FnParamInfo(A64::Register valReg, VarValuePtr val) : valReg(valReg), val(std::move(val)) {}
+	explicit FnParamInfo(A64::Register valReg, int32_t localOffset, DartType* type, std::string name, VarValuePtr val)
 		: valReg(valReg), localOffset(localOffset), type(type), name(std::move(name)), val(std::move(val)) {}
 	explicit FnParamInfo(A64::Register valReg, std::string name) : valReg(valReg), name(std::move(name)) {}
 	explicit FnParamInfo(std::string name) : name(std::move(name)) {}
 
 	std::string ToString() const;
+	void AppendTo(fmt::memory_buffer& out) const;
 };
 
 struct FnParams {
@@ -87,38 +91,66 @@ struct FnParams {
 	FnParamInfo* findValReg(A64::Register reg);
 	bool movValReg(A64::Register dstReg, A64::Register srcReg);
 	std::string ToString() const;
+	void AppendTo(fmt::memory_buffer& out) const;
 
 	uint8_t numFixedParam{ 0 };
 	bool isNamedParam{ false };
 	std::vector<FnParamInfo> params;
 };
 
+// register and local variable values at a point of function.
+// the values are shared between copies until one of them is modified (copy-on-write),
+//   so taking a snapshot of the state at every branch is cheap.
 class AnalyzingState {
 public:
-	AnalyzingState(uint32_t stackSize) : local_vars{ stackSize / sizeof(void*), nullptr } { regs.fill(nullptr); }
+	AnalyzingState(uint32_t stackSize) : frame{ std::make_shared<Frame>(stackSize) } {}
 
-	void SetRegister(A64::Register reg, VarValue* val) { regs[reg] = val; }
-	void ClearRegister(A64::Register reg) { regs[reg] = nullptr; }
+	void SetRegister(A64::Register reg, VarValue* val) {
+		if (frame->regs[reg] != val)
+			own().regs[reg] = val;
+	}
+	void ClearRegister(A64::Register reg) { SetRegister(reg, nullptr); }
+	void ClearAllRegisters();
 	VarValue* MoveRegister(A64::Register dstReg, A64::Register srcReg) {
-		auto val = regs[srcReg];
+		auto val = frame->regs[srcReg];
 		if (dstReg != srcReg) {
-			regs[dstReg] = val;
-			regs[srcReg] = nullptr; // normally, Dart moves register for freeing the src register
+			SetRegister(dstReg, val);
+			ClearRegister(srcReg); // normally, Dart moves register for freeing the src register
 		}
 		return val;
 	}
-	VarValue* GetValue(A64::Register reg) { return regs[reg]; }
+	VarValue* GetValue(A64::Register reg) const { return frame->regs[reg]; }
+	const std::array<VarValue*, A64::Register::kNumberOfRegisters>& Regs() const { return frame->regs; }
 
 	static int localOffsetToIndex(int offset) { ASSERT(offset < 0);  return (-offset - sizeof(void*)) / sizeof(void*); }
 	static int indexToLocalOffset(int idx) { return -(idx + 1) * sizeof(void*); }
-	void SetLocal(int offset, VarValue* val) { local_vars[localOffsetToIndex(offset)] = val; }
-	VarValue* GetLocal(int offset) { return local_vars[localOffsetToIndex(offset)]; }
-
-//private:
-	// variable storage. only reference here.
-	std::array<VarValue*, A64::Register::kNumberOfRegisters> regs;
-	std::vector<VarValue*> local_vars;
-	std::vector<VarValue*> callee_args;
+	bool IsLocal(int offset) const { return offset < 0 && localOffsetToIndex(offset) < frame->local_vars.size(); }
+	void SetLocal(int offset, VarValue* val) {
+		const auto idx = localOffsetToIndex(offset);
+		if (frame->local_vars[idx] != val)
+			own().local_vars[idx] = val;
+	}
+	VarValue* GetLocal(int offset) const { return frame->local_vars[localOffsetToIndex(offset)]; }
+	const std::vector<VarValue*>& Locals() const { return frame->local_vars; }
+
+	// join point of branches. only the values that are same in both states are kept.
+	// return true if this state is changed
+	bool Merge(const AnalyzingState& other);
+
+private:
+	struct Frame {
+		Frame(uint32_t stackSize) : local_vars(stackSize / sizeof(void*), nullptr) { regs.fill(nullptr); }
+		// variable storage. only reference here.
+		std::array<VarValue*, A64::Register::kNumberOfRegisters> regs;
+		std::vector<VarValue*> local_vars;
+	};
+	Frame& own() {
+		if (frame.use_count() > 1)
+			frame = std::make_shared<Frame>(*frame);
+		return *frame;
+	}
+
+	std::shared_ptr<Frame> frame;
 };
 
 class AnalyzingVars {
@@ -148,6 +180,42 @@ private:
 	std::unique_ptr<VarValue> valCurrNumNameParam;
 };
 
+// instance or static field access found by analysis
+struct FieldAccess {
+	uint64_t addr; // start address of IL
+	DartField* field;
+	bool isStore;
+};
+
+// basic block of function ILs. a block starts at a branch target or after an IL that leaves by a branch.
+// offsets are from function start, so blocks can be shared by functions with same code.
+// the summary is created once with the block. later passes use it instead of walking instructions again
+//   and blocks are never modified after creation (safe to be read in parallel)
+struct BasicBlock {
+	uint32_t start; // offset from function start
+	uint32_t end;
+	uint32_t firstIL; // index in AnalyzedFnData::ILs()
+	uint32_t endIL;
+	std::vector<uint32_t> succs; // block index
+	std::vector<uint32_t> preds;
+
+	// summary. register bit is (1 << A64::Register)
+	uint64_t regsUsed{ 0 }; // read before written in the block
+	uint64_t regsDefined{ 0 };
+	std::vector<uint32_t> calls; // offset of direct call instructions (AsmText::Call)
+	std::vector<uint32_t> poolRefs; // offset of instructions that load object pool (AsmText::PoolOffset)
+	uint32_t numIndirectCalls{ 0 };
+	bool fallThrough{ true }; // last IL does not leave by unconditional branch or return
+};
+
+// cost of tracking register and local variable values in function body
+struct ValueTrackingStats {
+	uint32_t numBlocks{ 0 };
+	// processed blocks by worklist. a block is processed again when its entry state is changed by a back edge
+	uint32_t numVisits{ 0 };
+	uint32_t elapsedUs{ 0 };
+};
+
 class AnalyzedFnData {
 public:
 	AnalyzedFnData(DartApp& app, DartFunction& dartFn, AsmTexts asmTexts);
@@ -165,6 +233,8 @@ public:
 
 	DartApp& app;
 	DartFunction& dartFn;
+	// must be declared before any IL holder. ILs have to be destroyed before their memory is released
+	ILArena ilArena;
 	AsmTexts asmTexts;
 	cs_insn* last_ret{ nullptr };
 	uint32_t stackSize{ 0 }; // for local variables (this includes space for call arguments)
@@ -172,6 +242,7 @@ public:
 	uint64_t firstCheckStackOverflowAddr{ 0 };
 	FnParams params;
 	std::vector<std::unique_ptr<ILInstr>> il_insns;
+	std::vector<FieldAccess> fieldAccesses;
 	DartType* returnType{ nullptr };
 
 	//int firstParamOffset{ 0 };
@@ -182,11 +253,20 @@ public:
 	A64::Register typeArgumentReg;
 	int32_t typeArgumentLocalOffset{ 0 };
 
+	// set when the function code is same as another analyzed function. ILs are shared with it
+	//   and the IL addresses are the other function addresses (add sameCodeDelta to get this function addresses)
+	AnalyzedFnData* sameCode{ nullptr };
+	int64_t sameCodeDelta{ 0 };
+	std::vector<std::unique_ptr<ILInstr>>& ILs() { return sameCode ? sameCode->il_insns : il_insns; }
+	// empty if the function is not analyzed
+	std::vector<BasicBlock> blocks;
+	const std::vector<BasicBlock>& Blocks() const { return sameCode ? sameCode->blocks : blocks; }
+
 	void InitState() { state = std::make_unique<AnalyzingState>(stackSize); }
-	void DestroyState() { state.release(); }
+	void DestroyState() { state.reset(); }
 	AnalyzingState* State() const { return state.get(); }
 	void InitVars() { vars = std::make_unique<AnalyzingVars>(); }
-	void DestroyVars() { vars.release(); }
+	void DestroyVars() { vars.reset(); }
 	AnalyzingVars* Vars() const { return vars.get(); }
 
 private:
@@ -199,15 +279,33 @@ private:
 class CodeAnalyzer
 {
 public:
-	CodeAnalyzer(DartApp& app) : app(app) {};
-
+	CodeAnalyzer(DartApp& app);
+	~CodeAnalyzer();
+
+	// load analysis results of previous run from file. the file is updated after AnalyzeAll()
+	void UseCache(std::filesystem::path path);
+	// only disassemble functions in libraries that match known package signature
+	void SkipKnownPackages(bool skip) { skipKnownPackages = skip; }
+	// print analysis cost of the largest functions after analyzing all
+	void BenchmarkLargestFunctions(int count) { benchmarkCount = count; }
 	void AnalyzeAll();
 
 private:
 	static AsmTexts convertAsm(AsmInstructions& asm_insns);
+	// use analyzed data of other function that has same code
+	static void shareAnalyzedData(AnalyzedFnData& fnData, AnalyzedFnData& srcData);
+	// false if some ILs contain address inside the function (cannot be shared with other function)
+	static bool isRelocatable(AnalyzedFnData& fnData);
 	
 	// implementation is specific to architecture
-	void asm2il(DartFunction* dartFn, AsmInstructions& asm_insns);
+	ValueTrackingStats asm2il(DartFunction* dartFn, AsmInstructions& asm_insns);
+	// create basic blocks with summaries from ILs. entryIL is always a start of block
+	static void buildBlocks(AnalyzedFnData& fnData, AsmInstructions& asm_insns, size_t entryIL = 0);
+	// hash of function code. PC relative targets are normalized, so same code at different address has same hash
+	static uint64_t codeHash(DartFunction& dartFn);
 
 	DartApp& app;
+	std::unique_ptr<AnalysisCache> cache;
+	bool skipKnownPackages{ false };
+	int benchmarkCount{ 0 };
 };
@@ -3,7 +3,11 @@
 #include "DartApp.h"
 #include "VarValue.h"
 #include "DartThreadInfo.h"
+#include "A64Decoder.h"
 #include <source_location>
+#include <chrono>
+#include <optional>
+#include <queue>
 
 #ifndef NO_CODE_ANALYSIS
 
@@ -50,131 +54,20 @@ public:
 
 static VarValue* getPoolObject(DartApp& app, intptr_t offset, A64::Register dstReg)
 {
-	intptr_t idx = dart::ObjectPool::IndexFromOffset(offset);
-	auto& pool = app.GetObjectPool();
-	auto objType = pool.TypeAt(idx);
-	// see how the EntryType is handled from vm/object_service.cc - ObjectPool::PrintJSONImpl()
-	if (objType == dart::ObjectPool::EntryType::kTaggedObject) {
-		//val = (uintptr_t)pool.ObjectAt(idx);
-		auto ptr = pool.ObjectAt(idx);
-		// Smi is special case. Have to handle first
-		if (!ptr.IsHeapObject()) {
-			return new VarInteger(dart::RawSmiValue(dart::Smi::RawCast(ptr)), dart::kSmiCid);
-		}
-
-		if (ptr.IsRawNull())
-			return new VarNull();
-
-		auto& obj = dart::Object::Handle(ptr);
-		if (obj.IsString())
-			return new VarString(dart::String::Cast(obj).ToCString());
-
-		// use TypedData or TypedDataBase ?
-		if (obj.IsTypedData()) {
-			//dart::kTypedDataInt32ArrayCid;
-			//auto& data = dart::TypedData::Cast(obj);
-			return new VarExpression(std::format("{}", obj.ToCString()), (int32_t)obj.GetClassId());
-		}
-
-		switch (obj.GetClassId()) {
-		case dart::kSmiCid:
-			return new VarInteger(dart::Smi::Cast(obj).Value(), dart::kSmiCid);
-		case dart::kMintCid:
-			return new VarInteger(dart::Mint::Cast(obj).AsInt64Value(), dart::kMintCid);
-		case dart::kDoubleCid:
-			return new VarDouble(dart::Double::Cast(obj).value());
-		case dart::kBoolCid:
-			return new VarBoolean(dart::Bool::Cast(obj).value());
-		case dart::kNullCid:
-			return new VarNull();
-		case dart::kCodeCid: {
-			const auto& code = dart::Code::Cast(obj);
-			auto stub = app.GetFunction(code.EntryPoint() - app.base());
-			ASSERT(stub);
-			return new VarFunctionCode(*stub);
-		}
-		case dart::kFieldCid: {
-			const auto& field = dart::Field::Cast(obj);
-			auto dartCls = app.GetClass(field.Owner().untag()->id());
-			auto dartField = dartCls->FindField(field.TargetOffset());
-			//auto dartField = app.GetStaticField(field.TargetOffset());
-			ASSERT(dartField);
-			return new VarField(*dartField);
-		}
-		case dart::kImmutableArrayCid:
-			return new VarArray(dart::Array::Cast(obj).ptr());
-		// should function and closure be their var types?
-		case dart::kFunctionCid:
-		case dart::kClosureCid:
-		case dart::kConstMapCid:
-			// TODO: map
-		case dart::kConstSetCid:
-			// TODO: set
-			return new VarExpression(std::format("{}", obj.ToCString()), (int32_t)obj.GetClassId());
-#ifdef HAS_RECORD_TYPE
-		case dart::kRecordCid: {
-			// temporary expression for Record object (need full object for analysis)
-			//const auto& rec = dart::Record::Cast(obj);
-			return new VarExpression(std::format("{}", obj.ToCString()), (int32_t)obj.GetClassId());
-		}
-#endif
-		case dart::kTypeParametersCid:
-			throw std::runtime_error("Type parameter in Object Pool");
-		case dart::kTypeCid:
-			return new VarType(*app.TypeDb()->FindOrAdd(dart::Type::Cast(obj).ptr()));
-#ifdef HAS_RECORD_TYPE
-		case dart::kRecordTypeCid:
-			return new VarRecordType(*app.TypeDb()->FindOrAdd(dart::RecordType::Cast(obj).ptr()));
-#endif
-		case dart::kTypeParameterCid:
-			return new VarTypeParameter(*app.TypeDb()->FindOrAdd(dart::TypeParameter::Cast(obj).ptr()));
-		case dart::kFunctionTypeCid:
-			return new VarFunctionType(*app.TypeDb()->FindOrAdd(dart::FunctionType::Cast(obj).ptr()));
-		case dart::kTypeArgumentsCid: {
-			return new VarTypeArgument(*app.TypeDb()->FindOrAdd(dart::TypeArguments::Cast(obj).ptr()));
-		}
-		case dart::kSentinelCid:
-			return new VarSentinel();
-		case dart::kUnlinkedCallCid: {
-			intptr_t idx = dart::ObjectPool::IndexFromOffset(offset + 8);
-			ASSERT(pool.TypeAt(idx) == dart::ObjectPool::EntryType::kImmediate);
-			auto imm = pool.RawValueAt(idx);
-			auto dartFn = app.GetFunction(imm - app.base());
-			return new VarUnlinkedCall(*dartFn->AsStub());
-		}
-		case dart::kSubtypeTestCacheCid:
-			return new VarSubtypeTestCache();
-		case dart::kLibraryPrefixCid:
-			// TODO: handle LibraryPrefix object
-		case dart::kInstanceCid:
-			return new VarInstance(app.GetClass(dart::kInstanceCid));
-		}
-
-		if (obj.IsInstance()) {
-			auto dartCls = app.GetClass(obj.GetClassId());
-			if (dartCls->Id() < dart::kNumPredefinedCids) {
-				std::cerr << std::format("Unhandle predefined class {} ({})\n", dartCls->Name(), dartCls->Id());
-			}
-			return new VarInstance(dartCls);
-		}
-
-		throw std::runtime_error("unhandle object class in getPoolObject");
-		//auto txt = std::format("XXX: {}", obj.ToCString());
-		//return new VarExpression(txt);
-	}
-	else if (objType == dart::ObjectPool::EntryType::kImmediate) {
-		auto imm = pool.RawValueAt(idx);
-		if (dstReg.IsDecimal())
-			return new VarDouble(*((double*)&imm), VarType::NativeDouble);
-		return new VarInteger(imm, VarValue::NativeInt);
-	}
-	else if (objType == dart::ObjectPool::EntryType::kNativeFunction) {
-		//val = pool.RawValueAt(idx);
-		throw std::runtime_error("getting native function pool object from Dart code");
-	}
-	else {
-		throw std::runtime_error(std::format("unknown pool object type: {}", (int)objType).c_str());
+	// pool values are created when loading. they are shared by all ILs
+	const auto& entry = app.GetPool().At(offset);
+	if (entry.kind == DartPoolEntry::Immediate && dstReg.IsDecimal()) {
+		auto imm = entry.rawVal;
+		return new VarDouble(*((double*)&imm), VarType::NativeDouble);
 	}
+	if (entry.value)
+		return entry.value;
+
+	if (entry.kind == DartPoolEntry::NativeFunction)
+		throw std::runtime_error("getting native function pool object from Dart code");
+	if (entry.cid == dart::kTypeParametersCid)
+		throw std::runtime_error("Type parameter in Object Pool");
+	throw std::runtime_error(std::format("unhandle object class {} in getPoolObject", entry.cid));
 }
 
 static inline void handleDecompressPointer(AsmIterator& insn, arm64_reg reg) {
@@ -197,13 +90,38 @@ struct StoreLocalResult {
 	int fpOffset{ 0 };
 };
 
+// effects of one instruction for block summaries and value tracking. they are computed once per instruction,
+//   so the worklist iterations and the summaries do not read the instruction detail
+struct InsnEffect {
+	enum Kind : uint8_t {
+		None,
+		Call, // all registers are clobbered
+		Store, // reg0 to local variable at fpDisp (if the memory operand is a local variable)
+		StorePair, // reg0 and reg1
+		Load, // reg0 from local variable at fpDisp or unknown
+		LoadPair, // reg0 and reg1
+		Move, // reg0 = reg1 (reg1 is invalid if the source is not a register)
+		Clobber, // reg0 is written with unknown value
+	};
+	Kind kind{ None };
+	arm64_reg reg0{ ARM64_REG_INVALID };
+	arm64_reg reg1{ ARM64_REG_INVALID };
+	// base register that is updated by writeback. invalid if no writeback
+	arm64_reg writebackReg{ ARM64_REG_INVALID };
+	// displacement of memory operand "[FP, #disp]" without writeback. 0 if it is not
+	int32_t fpDisp{ 0 };
+	// tracked registers that are read and written by the instruction
+	uint64_t reads{ 0 };
+	uint64_t writes{ 0 };
+};
+
 class FunctionAnalyzer
 {
 public:
 	FunctionAnalyzer(AnalyzedFnData* fnInfo, DartFunction* dartFn, AsmInstructions& asm_insns, DartApp& app)
 		: fnInfo{ fnInfo }, dartFn{ dartFn }, asm_insns{ asm_insns }, app{ app } {}
 
-	void asm2il();
+	ValueTrackingStats asm2il();
 
 	// returns an instruction after the prologue
 	void handlePrologue(AsmIterator& insItr, uint64_t endPrologueAddr);
@@ -270,11 +188,23 @@ private:
 
 	ObjectPoolInstr getObjectPoolInstruction(AsmIterator& insn);
 	void printInsnException(InsnException& e);
+	// track register and local variable values in function body with branches.
+	//   the state after prologue is the entry state
+	ValueTrackingStats trackValues(size_t bodyStartIdx);
+	void applyIL(AnalyzingState& state, ILInstr& il);
+	void applyInsn(AnalyzingState& state, const InsnEffect& eff);
+	// must be called with the state before the IL
+	void recordFieldAccess(ILInstr& il);
+	DartField* findInstanceField(A64::Register objReg, int64_t offset);
 
 	AnalyzedFnData* fnInfo;
 	DartFunction* dartFn;
 	AsmInstructions& asm_insns;
 	DartApp& app;
+	// object of AllocateObject IL. one value per IL, so the values from different paths can be merged
+	std::unordered_map<ILInstr*, std::unique_ptr<VarInstance>> allocatedObjects;
+	// effect of every instruction (index is same as asm_insns). computed before building blocks
+	std::vector<InsnEffect> insnEffects;
 };
 
 typedef std::unique_ptr<ILInstr>(FunctionAnalyzer::* AsmMatcherFn)(AsmIterator& insn);
@@ -334,7 +264,7 @@ FunctionAnalyzer::ObjectPoolInstr FunctionAnalyzer::getObjectPoolInstruction(Asm
 			else {
 				FATAL("add from NULL_REG");
 			}
-			auto b = new VarBoolean(val);
+			auto b = VarConstants::Boolean(val);
 			setAsmTextDataBoolean(marker.Take(), val);
 			dstReg = A64::Register{ insn.ops(0).reg };
 			++insn;
@@ -743,8 +673,7 @@ void FunctionAnalyzer::handlePrologue(AsmIterator& insn, uint64_t endPrologueAdd
 		catch (InsnException& e) {
 			printInsnException(e);
 		}
-		fnInfo->DestroyState();
-		fnInfo->DestroyVars();
+		// the state is kept for tracking values in function body
 	}
 #endif
 
@@ -1413,9 +1342,11 @@ void FunctionAnalyzer::handleOptionalNamedParameters(AsmIterator& insn, arm64_re
 
 	fnInfo->params.isNamedParam = true;
 	// remove all reference to temporary variables for loading named parameters
-	for (auto& reg : fnInfo->State()->regs) {
-		if (reg && reg->RawTypeId() > VtNameBegin && reg->RawTypeId() < VtNameEnd)
-			reg = nullptr;
+	for (auto i = 0; i < A64::Register::kNumberOfRegisters; i++) {
+		const A64::Register reg = A64::Register::Value{ i };
+		auto val = fnInfo->State()->GetValue(reg);
+		if (val && val->RawTypeId() > VtNameBegin && val->RawTypeId() < VtNameEnd)
+			fnInfo->State()->ClearRegister(reg);
 	}
 }
 
@@ -1583,7 +1514,7 @@ std::unique_ptr<SetupParametersInstr> FunctionAnalyzer::processPrologueParameter
 
 		// very rare case, initialization here
 		if (insn.id() == ARM64_INS_MOV && insn.ops(1).reg == CSREG_DART_NULL) {
-			auto item = VarItem{ VarStorage::Immediate, new VarNull() };
+			auto item = VarItem{ VarStorage::Immediate, VarConstants::Null() };
 			fnInfo->Vars()->pending_ils.push_back(std::make_unique<LoadValueInstr>(AddrRange(insn.address(), insn.NextAddress()), A64::Register{insn.ops(0).reg}, std::move(item)));
 			++insn;
 		}
@@ -1910,14 +1841,14 @@ std::unique_ptr<SetupParametersInstr> FunctionAnalyzer::processPrologueParameter
 			param.valReg = A64::Register{};
 			param.localOffset = 0;
 		}
-		const auto& local_vars = fnInfo->State()->local_vars;
+		const auto& local_vars = fnInfo->State()->Locals();
 		for (auto i = 0; i < local_vars.size(); i++) {
 			const auto local = local_vars[i];
 			if (local && local->RawTypeId() == VarValue::Parameter) {
 				fnInfo->params[local->AsParam()->idx].localOffset = AnalyzingState::indexToLocalOffset(i);
 			}
 		}
-		auto& regs = fnInfo->State()->regs;
+		const auto& regs = fnInfo->State()->Regs();
 		for (auto i = 0; i < A64::Register::kNumberOfRegisters; i++) {
 			if (regs[i] && regs[i]->RawTypeId() == VarValue::Parameter) {
 				fnInfo->params[regs[i]->AsParam()->idx].valReg = A64::Register::Value{ i };
@@ -1955,7 +1886,7 @@ std::unique_ptr<LoadValueInstr> FunctionAnalyzer::processLoadValueInstr(AsmItera
 		dstReg = tmpReg;
 	}
 	else if (insn.id() == ARM64_INS_MOV && insn.ops(1).reg == CSREG_DART_NULL) {
-		auto item = VarItem{ VarStorage::Immediate, new VarNull() };
+		auto item = VarItem{ VarStorage::Immediate, VarConstants::Null() };
 		const auto dstReg = A64::Register{ insn.ops(0).reg };
 		++insn;
 		return std::make_unique<LoadValueInstr>(insn.Wrap(ins0_addr), dstReg, std::move(item));
@@ -1987,7 +1918,7 @@ std::unique_ptr<LoadValueInstr> FunctionAnalyzer::processLoadValueInstr(AsmItera
 	}
 
 	if (dstReg.IsSet()) {
-		auto item = VarItem{ VarStorage::Immediate, new VarInteger{imm, VarValue::NativeInt} };
+		auto item = VarItem{ VarStorage::Immediate, VarConstants::Integer(imm, VarValue::NativeInt) };
 		return std::make_unique<LoadValueInstr>(insn.Wrap(ins0_addr), dstReg, std::move(item));
 	}
 
@@ -2212,7 +2143,7 @@ std::unique_ptr<GdtCallInstr> FunctionAnalyzer::processGdtCallInstr(AsmIterator&
 		INSN_ASSERT(insn.ops(0).reg == CSREG_DART_LR);
 		++insn;
 
-		return std::make_unique<GdtCallInstr>(insn.Wrap(insn0_addr), offset);
+		return std::make_unique<GdtCallInstr>(insn.Wrap(insn0_addr), offset, app.GetGdtTargets(offset));
 	}
 
 	return nullptr;
@@ -3100,11 +3031,356 @@ std::unique_ptr<ILInstr> FunctionAnalyzer::processLoadStore(AsmIterator& insn)
 	return nullptr;
 }
 
-void FunctionAnalyzer::asm2il()
+DartField* FunctionAnalyzer::findInstanceField(A64::Register objReg, int64_t offset)
+{
+	// the object class is known only when the register is "this" or a known instance
+	auto val = fnInfo->State() ? fnInfo->State()->GetValue(objReg) : nullptr;
+	if (val == nullptr)
+		return nullptr;
+	DartClass* cls = nullptr;
+	if (val->RawTypeId() == VarValue::Parameter) {
+		if (val->AsParam()->idx == 0 && !dartFn->IsStatic() && !dartFn->IsClosure())
+			cls = &dartFn->Class();
+	}
+	else if (val->RawTypeId() == dart::kInstanceCid && val->HasValue()) {
+		cls = reinterpret_cast<VarInstance*>(val)->cls;
+	}
+
+	// memory offset in instruction is from tagged pointer
+	const auto fieldOffset = offset + dart::kHeapObjectTag;
+	for (; cls != nullptr; cls = cls->Parent()) {
+		auto field = cls->FindField(fieldOffset);
+		if (field)
+			return field;
+	}
+	return nullptr;
+}
+
+void FunctionAnalyzer::recordFieldAccess(ILInstr& il)
+{
+	DartField* field = nullptr;
+	bool isStore = false;
+	switch (il.Kind()) {
+	case ILInstr::LoadField: {
+		auto& ilLoad = reinterpret_cast<LoadFieldInstr&>(il);
+		field = findInstanceField(ilLoad.objReg, ilLoad.offset);
+		break;
+	}
+	case ILInstr::StoreField: {
+		auto& ilStore = reinterpret_cast<StoreFieldInstr&>(il);
+		field = findInstanceField(ilStore.objReg, ilStore.offset);
+		isStore = true;
+		break;
+	}
+	case ILInstr::LoadStaticField:
+		field = app.FindStaticField(reinterpret_cast<LoadStaticFieldInstr&>(il).FieldOffset());
+		break;
+	case ILInstr::StoreStaticField:
+		field = app.FindStaticField(reinterpret_cast<StoreStaticFieldInstr&>(il).FieldOffset());
+		isStore = true;
+		break;
+	case ILInstr::InitLateStaticField:
+		field = &reinterpret_cast<InitLateStaticFieldInstr&>(il).Field();
+		break;
+	default:
+		return;
+	}
+	if (field)
+		fnInfo->fieldAccesses.push_back(FieldAccess{ il.Start(), field, isStore });
+}
+
+static inline bool isTrackedReg(A64::Register reg)
+{
+	return reg.IsSet() && reg < A64::Register::kNumberOfRegisters;
+}
+
+// target of branch instruction. 0 if the instruction is not a branch
+static uint64_t getBranchTarget(cs_insn* ins, bool& isConditional)
+{
+	switch (ins->id) {
+	case ARM64_INS_B: {
+		const auto& detail = GetCsInsnDetail(ins);
+		isConditional = detail.cc != ARM64_CC_INVALID && detail.cc != ARM64_CC_AL;
+		return detail.operands[0].type == ARM64_OP_IMM ? detail.operands[0].imm : 0;
+	}
+	case ARM64_INS_CBZ:
+	case ARM64_INS_CBNZ:
+		isConditional = true;
+		return GetCsInsnDetail(ins).operands[1].imm;
+	case ARM64_INS_TBZ:
+	case ARM64_INS_TBNZ:
+		isConditional = true;
+		return GetCsInsnDetail(ins).operands[2].imm;
+	}
+	return 0;
+}
+
+// instruction that writes no register (except writeback of memory operand)
+static bool isNoDestInsn(unsigned int id)
+{
+	switch (id) {
+	case ARM64_INS_NOP:
+	case ARM64_INS_B:
+	case ARM64_INS_CBZ:
+	case ARM64_INS_CBNZ:
+	case ARM64_INS_TBZ:
+	case ARM64_INS_TBNZ:
+	case ARM64_INS_BR:
+	case ARM64_INS_RET:
+	case ARM64_INS_CMP:
+	case ARM64_INS_CMN:
+	case ARM64_INS_TST:
+	case ARM64_INS_CCMP:
+	case ARM64_INS_FCMP:
+	case ARM64_INS_DMB:
+	case ARM64_INS_BRK:
+	case ARM64_INS_STR:
+	case ARM64_INS_STUR:
+	case ARM64_INS_STP:
+	case ARM64_INS_STRB:
+	case ARM64_INS_STRH:
+	case ARM64_INS_STURB:
+	case ARM64_INS_STURH:
+	case ARM64_INS_STLR:
+		return true;
+	}
+	return false;
+}
+
+static inline uint64_t regBit(arm64_reg reg)
+{
+	const A64::Register r{ reg };
+	return isTrackedReg(r) ? 1ull << (int)r : 0;
+}
+
+// detail of the instruction without filling its on-demand detail if the native decoder supports it
+static const cs_arm64& peekInsnDetail(cs_insn* ins, cs_arm64& tmp)
+{
+	if (((uintptr_t)ins->detail & CS_DETAIL_ON_DEMAND_TAG) == 0)
+		return ins->detail->arm64;
+	uint32_t code;
+	memcpy(&code, ins->bytes, 4);
+	if (A64::DecodeInsn(code, ins->address, tmp) == ins->id)
+		return tmp;
+	return GetCsInsnDetail(ins);
+}
+
+static InsnEffect getInsnEffect(cs_insn* ins)
+{
+	InsnEffect eff;
+	if (ins->id == ARM64_INS_NOP)
+		return eff;
+	cs_arm64 tmp;
+	const auto& detail = peekInsnDetail(ins, tmp);
+	if (ins->id == ARM64_INS_BL || ins->id == ARM64_INS_BLR) {
+		// Dart has no callee saved register. the values are only in local variables after a call
+		eff.kind = InsnEffect::Call;
+		eff.writes = ~0ull;
+		if (detail.op_count > 0 && detail.operands[0].type == ARM64_OP_REG)
+			eff.reads = regBit(detail.operands[0].reg);
+		return eff;
+	}
+	if (detail.op_count == 0)
+		return eff;
+
+	int numDest = 0;
+	if (!isNoDestInsn(ins->id) && detail.operands[0].type == ARM64_OP_REG)
+		numDest = (ins->id == ARM64_INS_LDP && detail.op_count > 1) ? 2 : 1;
+	for (uint8_t i = 0; i < detail.op_count; i++) {
+		const auto& op = detail.operands[i];
+		if (op.type == ARM64_OP_REG) {
+			if (i < numDest)
+				eff.writes |= regBit(op.reg);
+			else
+				eff.reads |= regBit(op.reg);
+		}
+		else if (op.type == ARM64_OP_MEM) {
+			eff.reads |= regBit(op.mem.base) | regBit(op.mem.index);
+			if (detail.writeback) {
+				eff.writes |= regBit(op.mem.base);
+				eff.writebackReg = op.mem.base;
+			}
+		}
+	}
+
+	auto fpDisp = [&detail](const cs_arm64_op& op) {
+		if (op.type != ARM64_OP_MEM || op.mem.base != CSREG_DART_FP || op.mem.index != ARM64_REG_INVALID || detail.writeback)
+			return 0;
+		return op.mem.disp;
+	};
+	switch (ins->id) {
+	case ARM64_INS_STR:
+	case ARM64_INS_STUR:
+		eff.kind = InsnEffect::Store;
+		eff.reg0 = detail.operands[0].reg;
+		eff.fpDisp = fpDisp(detail.operands[1]);
+		break;
+	case ARM64_INS_STP:
+		eff.kind = InsnEffect::StorePair;
+		eff.reg0 = detail.operands[0].reg;
+		eff.reg1 = detail.operands[1].reg;
+		eff.fpDisp = fpDisp(detail.operands[2]);
+		break;
+	case ARM64_INS_LDR:
+	case ARM64_INS_LDUR:
+		eff.kind = InsnEffect::Load;
+		eff.reg0 = detail.operands[0].reg;
+		eff.fpDisp = fpDisp(detail.operands[1]);
+		break;
+	case ARM64_INS_LDP:
+		eff.kind = InsnEffect::LoadPair;
+		eff.reg0 = detail.operands[0].reg;
+		eff.reg1 = detail.operands[1].reg;
+		eff.fpDisp = fpDisp(detail.operands[2]);
+		break;
+	case ARM64_INS_MOV:
+		eff.kind = InsnEffect::Move;
+		eff.reg0 = detail.operands[0].reg;
+		eff.reg1 = detail.operands[1].type == ARM64_OP_REG ? detail.operands[1].reg : ARM64_REG_INVALID;
+		break;
+	default:
+		// assume the first register operand is the destination
+		if (!isNoDestInsn(ins->id) && detail.operands[0].type == ARM64_OP_REG) {
+			eff.kind = InsnEffect::Clobber;
+			eff.reg0 = detail.operands[0].reg;
+		}
+		break;
+	}
+	return eff;
+}
+
+static cs_insn* insnAt(AsmInstructions& asm_insns, uint64_t addr)
+{
+	return asm_insns.FirstPtr() + (addr - asm_insns.FirstPtr()->address) / 4;
+}
+
+// split ILs into basic blocks. a branch into the middle of IL is handled as a part of the IL, and
+//   the branch targets are successors of the whole IL even if the branch instruction is in the middle of the IL
+// effect of every instruction in asm_insns (index is same as asm_insns)
+static std::vector<InsnEffect> getInsnEffects(AsmInstructions& asm_insns)
+{
+	std::vector<InsnEffect> effects;
+	effects.reserve(asm_insns.Count());
+	for (auto ins = asm_insns.FirstPtr(); ins <= asm_insns.LastPtr(); ins++)
+		effects.push_back(getInsnEffect(ins));
+	return effects;
+}
+
+static void createBasicBlocks(AnalyzedFnData& fnData, AsmInstructions& asm_insns, const std::vector<InsnEffect>& effects, size_t entryIL)
+{
+	auto& ils = fnData.il_insns;
+	auto& blocks = fnData.blocks;
+	blocks.clear();
+	const auto numIL = ils.size();
+	if (numIL == 0)
+		return;
+	const uint64_t fnAddr = fnData.dartFn.Address();
+
+	// ILs are sorted by start address
+	auto findIL = [&ils](uint64_t addr) {
+		auto itr = std::lower_bound(ils.begin(), ils.end(), addr,
+			[](const std::unique_ptr<ILInstr>& il, uint64_t addr) { return il->Start() < addr; });
+		return (itr != ils.end() && (*itr)->Start() == addr) ? (size_t)(itr - ils.begin()) : SIZE_MAX;
+	};
+
+	std::vector<bool> isLeader(numIL);
+	std::vector<bool> fallThrough(numIL, true);
+	std::vector<std::pair<size_t, size_t>> jumps; // from IL, to IL
+	isLeader[0] = true;
+	if (entryIL < numIL)
+		isLeader[entryIL] = true;
+	for (size_t i = 0; i < numIL; i++) {
+		const auto range = ils[i]->Range();
+		bool hasExit = false;
+		for (auto addr = range.start; addr < range.end; addr += 4) {
+			auto ins = insnAt(asm_insns, addr);
+			const bool isLast = addr + 4 >= range.end;
+			if (ins->id == ARM64_INS_RET || ins->id == ARM64_INS_BR) {
+				hasExit = true;
+				if (isLast)
+					fallThrough[i] = false;
+				continue;
+			}
+			bool isConditional = false;
+			const auto target = getBranchTarget(ins, isConditional);
+			if (target == 0 || range.Has(target))
+				continue;
+			hasExit = true;
+			if (!isConditional && isLast)
+				fallThrough[i] = false;
+			// branch to outside function is tail call
+			const auto targetIdx = fnData.dartFn.ContainsAddress(target) ? findIL(target) : SIZE_MAX;
+			if (targetIdx != SIZE_MAX) {
+				jumps.emplace_back(i, targetIdx);
+				isLeader[targetIdx] = true;
+			}
+		}
+		if (hasExit && i + 1 < numIL)
+			isLeader[i + 1] = true;
+	}
+
+	std::vector<uint32_t> blockOf(numIL);
+	for (size_t i = 0; i < numIL; i++) {
+		const auto start = (uint32_t)(ils[i]->Start() - fnAddr);
+		const auto end = (uint32_t)(ils[i]->End() - fnAddr);
+		if (isLeader[i]) {
+			if (!blocks.empty())
+				blocks.back().endIL = (uint32_t)i;
+			blocks.push_back(BasicBlock{ start, end, (uint32_t)i, (uint32_t)numIL });
+		}
+		// prologue ILs might overlap
+		blocks.back().end = std::max(blocks.back().end, end);
+		blockOf[i] = (uint32_t)blocks.size() - 1;
+	}
+	for (const auto& [from, to] : jumps)
+		blocks[blockOf[from]].succs.push_back(blockOf[to]);
+	for (uint32_t b = 0; b < blocks.size(); b++) {
+		auto& block = blocks[b];
+		block.fallThrough = fallThrough[block.endIL - 1];
+		if (block.fallThrough && b + 1 < blocks.size())
+			block.succs.push_back(b + 1);
+		std::sort(block.succs.begin(), block.succs.end());
+		block.succs.erase(std::unique(block.succs.begin(), block.succs.end()), block.succs.end());
+		for (auto succ : block.succs)
+			blocks[succ].preds.push_back(b);
+	}
+
+	// summaries. every instruction is visited once even if ILs overlap
+	uint64_t walked = fnAddr;
+	for (auto& block : blocks) {
+		uint64_t defined = 0;
+		const auto end = fnAddr + block.end;
+		for (auto addr = std::max(fnAddr + block.start, walked); addr < end; addr += 4) {
+			auto ins = insnAt(asm_insns, addr);
+			const auto& eff = effects[ins - asm_insns.FirstPtr()];
+			block.regsUsed |= eff.reads & ~defined;
+			defined |= eff.writes;
+
+			const auto offset = (uint32_t)(addr - fnAddr);
+			const auto& asmText = fnData.asmTexts.AtAddr(addr);
+			if (asmText.dataType == AsmText::Call)
+				block.calls.push_back(offset);
+			else if (asmText.dataType == AsmText::PoolOffset)
+				block.poolRefs.push_back(offset);
+			else if (ins->id == ARM64_INS_BLR)
+				block.numIndirectCalls++;
+		}
+		block.regsDefined = defined;
+		walked = std::max(walked, end);
+	}
+}
+
+void CodeAnalyzer::buildBlocks(AnalyzedFnData& fnData, AsmInstructions& asm_insns, size_t entryIL)
+{
+	createBasicBlocks(fnData, asm_insns, getInsnEffects(asm_insns), entryIL);
+}
+
+ValueTrackingStats FunctionAnalyzer::asm2il()
 {
 	AsmIterator insn(asm_insns.FirstPtr(), asm_insns.LastPtr());
 
 	handlePrologue(insn, fnInfo->asmTexts.FirstStackLimitAddress());
+	const auto bodyStartIdx = fnInfo->il_insns.size();
 
 	do {
 		bool ok = false;
@@ -3129,12 +3405,188 @@ void FunctionAnalyzer::asm2il()
 			++insn;
 		}
 	} while (!insn.IsEnd());
+
+	insnEffects = getInsnEffects(asm_insns);
+	createBasicBlocks(*fnInfo, asm_insns, insnEffects, bodyStartIdx);
+	const auto stats = trackValues(bodyStartIdx);
+	fnInfo->DestroyState();
+	fnInfo->DestroyVars();
+	return stats;
+}
+
+void FunctionAnalyzer::applyInsn(AnalyzingState& state, const InsnEffect& eff)
+{
+	auto valueOf = [&state](arm64_reg reg) {
+		const A64::Register r{ reg };
+		return isTrackedReg(r) && GetCsRegSize(reg) == 8 ? state.GetValue(r) : nullptr;
+	};
+	auto setReg = [&state](arm64_reg reg, VarValue* val) {
+		const A64::Register r{ reg };
+		if (isTrackedReg(r))
+			state.SetRegister(r, GetCsRegSize(reg) == 8 ? val : nullptr);
+	};
+	// local variable offset of the memory operand. 0 if it is not a local variable
+	const auto offset = eff.fpDisp != 0 && state.IsLocal(eff.fpDisp) ? eff.fpDisp : 0;
+
+	switch (eff.kind) {
+	case InsnEffect::None:
+		break;
+	case InsnEffect::Call:
+		state.ClearAllRegisters();
+		return;
+	case InsnEffect::Store:
+		if (offset)
+			state.SetLocal(offset, valueOf(eff.reg0));
+		break;
+	case InsnEffect::StorePair:
+		if (offset) {
+			state.SetLocal(offset, valueOf(eff.reg0));
+			if (state.IsLocal(offset + 8))
+				state.SetLocal(offset + 8, valueOf(eff.reg1));
+		}
+		break;
+	case InsnEffect::Load:
+		setReg(eff.reg0, offset ? state.GetLocal(offset) : nullptr);
+		break;
+	case InsnEffect::LoadPair:
+		setReg(eff.reg0, offset ? state.GetLocal(offset) : nullptr);
+		setReg(eff.reg1, offset && state.IsLocal(offset + 8) ? state.GetLocal(offset + 8) : nullptr);
+		break;
+	case InsnEffect::Move:
+		setReg(eff.reg0, valueOf(eff.reg1));
+		break;
+	case InsnEffect::Clobber:
+		setReg(eff.reg0, nullptr);
+		break;
+	}
+
+	if (eff.writebackReg != ARM64_REG_INVALID)
+		setReg(eff.writebackReg, nullptr);
+}
+
+void FunctionAnalyzer::applyIL(AnalyzingState& state, ILInstr& il)
+{
+	const auto range = il.Range();
+	for (auto addr = range.start; addr < range.end; addr += 4)
+		applyInsn(state, insnEffects[insnAt(asm_insns, addr) - asm_insns.FirstPtr()]);
+
+	// the values that are known from the IL
+	switch (il.Kind()) {
+	case ILInstr::LoadValue: {
+		auto& ilLoad = reinterpret_cast<LoadValueInstr&>(il);
+		if (isTrackedReg(ilLoad.dstReg))
+			state.SetRegister(ilLoad.dstReg, ilLoad.val.Value());
+		break;
+	}
+	case ILInstr::AllocateObject: {
+		auto& ilAlloc = reinterpret_cast<AllocateObjectInstr&>(il);
+		auto& obj = allocatedObjects[&il];
+		if (!obj)
+			obj = std::make_unique<VarInstance>(&ilAlloc.dartCls);
+		if (isTrackedReg(ilAlloc.dstReg))
+			state.SetRegister(ilAlloc.dstReg, obj.get());
+		break;
+	}
+	}
 }
 
-void CodeAnalyzer::asm2il(DartFunction* dartFn, AsmInstructions& asm_insns)
+ValueTrackingStats FunctionAnalyzer::trackValues(size_t bodyStartIdx)
+{
+	ValueTrackingStats stats;
+	auto& ils = fnInfo->il_insns;
+	const auto& blocks = fnInfo->blocks;
+	if (bodyStartIdx >= ils.size())
+		return stats;
+	const auto startTime = std::chrono::steady_clock::now();
+
+	if (fnInfo->State() == nullptr)
+		fnInfo->InitState();
+	auto& state = *fnInfo->State();
+
+	// the first IL of body is always a start of block
+	uint32_t entryBlock = 0;
+	while (blocks[entryBlock].firstIL != bodyStartIdx)
+		entryBlock++;
+
+	// no entry state until a predecessor is processed
+	std::vector<std::optional<AnalyzingState>> entries(blocks.size());
+	std::vector<bool> queued(blocks.size());
+
+	// worklist in address order. a block state can only lose values when merging, so every block is
+	//   processed a few times at most (again only when a back edge changes its entry state)
+	std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> worklist;
+	entries[entryBlock] = state;
+	queued[entryBlock] = true;
+	worklist.push(entryBlock);
+	while (!worklist.empty()) {
+		const auto b = worklist.top();
+		worklist.pop();
+		const auto& block = blocks[b];
+		queued[b] = false;
+		stats.numVisits++;
+
+		state = *entries[b];
+		for (auto i = block.firstIL; i < block.endIL; i++)
+			applyIL(state, *ils[i]);
+
+		for (auto succ : block.succs) {
+			// prologue is analyzed separately
+			if (succ < entryBlock)
+				continue;
+			if (!entries[succ])
+				entries[succ] = state;
+			else if (!entries[succ]->Merge(state))
+				continue;
+			if (!queued[succ]) {
+				queued[succ] = true;
+				worklist.push(succ);
+			}
+		}
+	}
+
+	// record the results with the final states. blocks that are not reached from the function entry
+	//   (e.g. slow path of stack overflow check) start with unknown values
+	for (auto b = entryBlock; b < blocks.size(); b++) {
+		state = entries[b] ? *entries[b] : AnalyzingState{ fnInfo->stackSize };
+		for (auto i = blocks[b].firstIL; i < blocks[b].endIL; i++) {
+			recordFieldAccess(*ils[i]);
+			applyIL(state, *ils[i]);
+		}
+	}
+
+	stats.numBlocks = (uint32_t)(blocks.size() - entryBlock);
+	stats.elapsedUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+	return stats;
+}
+
+ValueTrackingStats CodeAnalyzer::asm2il(DartFunction* dartFn, AsmInstructions& asm_insns)
 {
 	FunctionAnalyzer analyzer{ dartFn->GetAnalyzedData(), dartFn, asm_insns, app };
-	analyzer.asm2il();
+	return analyzer.asm2il();
+}
+
+uint64_t CodeAnalyzer::codeHash(DartFunction& dartFn)
+{
+	const auto code = (const uint32_t*)dartFn.MemAddress();
+	const uint64_t start = dartFn.Address();
+	const uint64_t end = dartFn.AddressEnd();
+
+	// FNV-1a of instructions. the immediate of PC relative instruction is replaced with
+	//   offset from function start (target inside function) or absolute address (target outside function)
+	uint64_t hash = 0xcbf29ce484222325;
+	auto mix = [&hash](uint64_t val) { hash = (hash ^ val) * 0x100000001b3; };
+	for (int64_t i = 0; i < dartFn.Size() / 4; i++) {
+		const uint32_t word = code[i];
+		uint32_t immMask;
+		uint64_t target;
+		if (!A64::DecodePcRelative(word, start + i * 4, immMask, target)) {
+			mix(word);
+			continue;
+		}
+		mix(word & ~immMask);
+		mix((target >= start && target < end) ? target - start : target | (1ull << 63));
+	}
+	return hash;
 }
 	
 AsmTexts CodeAnalyzer::convertAsm(AsmInstructions& asm_insns)
@@ -3177,7 +3629,8 @@ AsmTexts CodeAnalyzer::convertAsm(AsmInstructions& asm_insns)
 						// Normally thread access is part of instructions. we don't need this case for translating to IL.
 						// but the thread offset information is nice to have in assembly
 						// thread access always be the last operand
-						auto& op = insn->detail->arm64.operands[insn->detail->arm64.op_count - 1];
+						auto& detail = GetCsInsnDetail(insn);
+						auto& op = detail.operands[detail.op_count - 1];
 						if (op.type == ARM64_OP_MEM && op.mem.base == CSREG_DART_THR) {
 							text_asm.threadOffset = op.mem.disp;
 							text_asm.dataType = AsmText::ThreadOffset;
@@ -3202,7 +3655,7 @@ AsmTexts CodeAnalyzer::convertAsm(AsmInstructions& asm_insns)
 						*ptr++ = 'p';
 						// save maximum stack offset for accessing parameter
 						if (insn->id == ARM64_INS_LDR) {
-							auto& op = insn->detail->arm64.operands[1];
+							auto& op = GetCsInsnDetail(insn).operands[1];
 							if (op.mem.base == CSREG_DART_FP && op.mem.disp > max_param_stack_offset) {
 								max_param_stack_offset = op.mem.disp;
 							}
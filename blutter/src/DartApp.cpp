@@ -4,10 +4,12 @@
 #include "DartLoader.h"
 PRAGMA_WARNING(push, 0)
 #include <vm/stub_code.h>
+#include <vm/dispatch_table.h>
 #include <vm/heap/safepoint.h>
 PRAGMA_WARNING(pop)
 #include "fmt/format.h"
 #include <iostream> // for debugging purpose
+#include <unordered_set>
 
 DartApp::DartApp(const char* path) : ppool(NULL), nativeLib(0xdeadead), throwStubAddr(0)
 {
@@ -170,12 +172,45 @@ void DartApp::LoadInfo()
 
 	finalizeFunctionsInfo();
 
+	// all functions, fields and classes are known. decode every pool entry once
+	pool = std::make_unique<DartPool>(*this);
+
+	loadDispatchTable(ig);
+
 	//auto fieldTable = isolate->field_table(); //contains only sentinel, null, false, 0
 
 	// there are instruction tables in vm isolate but their code are not called from Dart code (can be skipped)
 	//dart::Dart::vm_isolate_group();
 }
 
+AddrRange DartApp::CodeRange() const
+{
+	// all Dart functions are in isolate instructions. find the code region from them
+	uint64_t start = UINT64_MAX;
+	uint64_t end = 0;
+	for (auto& [_, dartFn] : functions) {
+		if (dartFn->PayloadSize() == 0)
+			continue;
+		start = std::min(start, dartFn->PayloadAddress());
+		end = std::max(end, dartFn->PayloadAddress() + dartFn->PayloadSize());
+	}
+	if (start >= end)
+		return AddrRange();
+	return AddrRange(start, end);
+}
+
+void DartApp::DisasmAllCode()
+{
+	const auto range = CodeRange();
+	if (range.start == range.end)
+		return;
+
+	Disassembler disasmer{ Disassembler::OnDemandDetail };
+	// there are object headers between functions. keep them as data, so an instruction index can be computed from address
+	disasmer.SetSkipData(true);
+	codeInsns = std::make_unique<AsmInstructions>(disasmer.Disasm((const uint8_t*)base() + range.start, range.end - range.start, range.start));
+}
+
 void DartApp::loadFromClassTable(dart::IsolateGroup* ig)
 {
 	auto table = ig->class_table();
@@ -271,6 +306,7 @@ void DartApp::loadFromClassTable(dart::IsolateGroup* ig)
 		// Note: below subvector type might be wrong for complicated generic type
 		if (dartCls->num_type_parameters > 0) {
 			dartCls->typeVectorName = dartType->Arguments().SubvectorName(0, dartCls->num_type_parameters);
+			dartCls->fullName = dartCls->name + dartCls->typeVectorName;
 		}
 		if (dartCls->superCls->num_type_parameters > 0) {
 			dartCls->parentTypeVectorName = dartType->Arguments().SubvectorName(0, dartCls->superCls->num_type_parameters);
@@ -290,6 +326,8 @@ void DartApp::loadFromClassTable(dart::IsolateGroup* ig)
 			dartCls->interfaces.push_back(classes[type.type_class_id()]);
 		}
 	}
+
+	hierarchy = std::make_unique<ClassHierarchy>(classes);
 }
 
 void DartApp::loadStubs(dart::ObjectStore* store)
@@ -507,6 +545,79 @@ void DartApp::findFunctionInHeap()
 	}
 }
 
+void DartApp::loadDispatchTable(dart::IsolateGroup* ig)
+{
+	auto table = ig->dispatch_table();
+	if (table == nullptr)
+		return;
+
+	// entries are entry point of Code. unused entries point to DispatchTableNullError stub
+	dispatchTableOrigin = dart::DispatchTable::OriginElement();
+	const auto array = table->ArrayOrigin() - dispatchTableOrigin;
+	dispatchTable.resize(table->length());
+	for (intptr_t i = 0; i < table->length(); i++) {
+		auto fn = GetFunction(array[i] - base());
+		if (fn && !fn->IsStub())
+			dispatchTable[i] = fn->AsFunction();
+	}
+
+	// offset + origin + cid must be in the table for some class id
+	if (!classes.empty()) {
+		gdtOffsetBias = dispatchTableOrigin + (intptr_t)classes.size() - 1;
+		gdtTargets.resize(dispatchTable.size() + classes.size() - 1);
+	}
+}
+
+std::span<DartFunction* const> DartApp::GetGdtTargets(int64_t offset)
+{
+	const auto rowIdx = offset + gdtOffsetBias;
+	if (rowIdx < 0 || rowIdx >= (intptr_t)gdtTargets.size())
+		return {};
+	std::lock_guard lock(gdtMutex);
+	auto& row = gdtTargets[rowIdx];
+	if (row.ready)
+		return row.targets;
+
+	// rows of selectors are packed, so the slot of a class that does not implement the selector can hold
+	//   an entry of other selector. an entry is a candidate only if it is inherited by the class
+	std::vector<std::pair<DartFunction*, std::string>> candidates;
+	std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> votes; // name to (declared in own class, all)
+	for (intptr_t cid = 0; cid < (intptr_t)classes.size(); cid++) {
+		auto cls = classes[cid];
+		const auto idx = dispatchTableOrigin + cid + offset;
+		if (cls == nullptr || idx < 0 || idx >= (intptr_t)dispatchTable.size())
+			continue;
+		auto fn = dispatchTable[idx];
+		// the implementation must be in the class or its parents
+		if (fn == nullptr || !hierarchy->IsSubclassOf(*cls, fn->Class()))
+			continue;
+		auto name = fn->Name();
+		auto& vote = votes[name];
+		// an entry that is declared in the class itself is very likely the selector of this row
+		if (&fn->Class() == cls)
+			vote.first++;
+		vote.second++;
+		candidates.emplace_back(fn, std::move(name));
+	}
+
+	// all targets of a selector have same member name. entries of other selectors are few in the row
+	const std::string* selectorName = nullptr;
+	std::pair<uint32_t, uint32_t> bestVote{ 0, 0 };
+	for (const auto& [name, vote] : votes) {
+		if (selectorName == nullptr || vote > bestVote) {
+			selectorName = &name;
+			bestVote = vote;
+		}
+	}
+	std::unordered_set<DartFunction*> seen;
+	for (const auto& [fn, name] : candidates) {
+		if (name == *selectorName && seen.insert(fn).second)
+			row.targets.push_back(fn);
+	}
+	row.ready = true;
+	return row.targets;
+}
+
 void DartApp::finalizeFunctionsInfo()
 {
 	auto& parentFn = dart::Function::Handle();
@@ -3,6 +3,9 @@
 #include "DartClass.h"
 #include "DartFunction.h"
 #include "DartStub.h"
+#include "DartPool.h"
+#include "ClassHierarchy.h"
+#include <mutex>
 #include <unordered_map>
 
 class DartApp
@@ -16,6 +19,11 @@ public:
 	void ExitScope();
 
 	void LoadInfo();
+	// address range of all Dart functions
+	AddrRange CodeRange() const;
+	// disassemble whole application code once. analysis and dumping use views of it instead of disassembling each function
+	// Note: it needs much more memory because a full cs_insn and a cs_detail slot of every instruction are kept until the end
+	void DisasmAllCode();
 
 	intptr_t base() const { return (intptr_t)lib_base; }
 	uint32_t offset(intptr_t addr) const { return (uint32_t)(addr - base()); }
@@ -24,9 +32,22 @@ public:
 	DartClass* GetClass(intptr_t cid);
 	DartFnBase* GetFunction(uint64_t addr);
 	DartField* GetStaticField(intptr_t offset) { return staticFields.at(offset); }
+	// nullptr if not found
+	DartField* FindStaticField(intptr_t offset) {
+		auto itr = staticFields.find(offset);
+		return itr != staticFields.end() ? itr->second : nullptr;
+	}
 
 	dart::ObjectPool& GetObjectPool() { return *ppool; }
+	// decoded Object Pool. use it instead of dart::ObjectPool after LoadInfo()
+	const DartPool& GetPool() const { return *pool; }
 	DartTypeDb* TypeDb() { return typeDb.get(); }
+	const ClassHierarchy& Hierarchy() const { return *hierarchy; }
+	// possible targets of dispatch table call "GDT[cid + offset]". only implementations that
+	//   the cid inherits and that have the member name of the row selector are included
+	//   (other slots in the row belong to other selectors). it can be called from any thread.
+	//   the result is valid as long as DartApp
+	std::span<DartFunction* const> GetGdtTargets(int64_t offset);
 
 	intptr_t DartIntCid() const { return dartIntCid; }
 	intptr_t DartFutureCid() const { return dartFutureCid; }
@@ -41,6 +62,7 @@ private:
 	void findFunctionInHeap();
 	void finalizeFunctionsInfo();
 	void loadFromObjectPool();
+	void loadDispatchTable(dart::IsolateGroup* ig);
 	void walkObject(dart::Object& obj); // to check field types from existed object
 
 	const void* lib_base;
@@ -64,6 +86,22 @@ private:
 	std::unordered_map<uint64_t, DartStub*> stubs;
 	std::unordered_map<uint64_t, DartField*> staticFields;
 	std::unique_ptr<DartTypeDb> typeDb;
+	std::unique_ptr<ClassHierarchy> hierarchy;
+	std::unique_ptr<AsmInstructions> codeInsns;
+	std::unique_ptr<DartPool> pool;
+	// decoded dispatch table (index is same as dart dispatch table array). null for unused entry
+	std::vector<DartFunction*> dispatchTable;
+	intptr_t dispatchTableOrigin{ 0 };
+	// targets of every possible selector offset (index is offset + gdtOffsetBias). the table is allocated with dispatch table
+	//   and never resized. a row is computed when it is used first because code uses only few of all possible offsets
+	struct GdtRow {
+		bool ready{ false };
+		std::vector<DartFunction*> targets;
+	};
+	std::vector<GdtRow> gdtTargets;
+	intptr_t gdtOffsetBias{ 0 };
+	// rows are filled lazily. locked while a row is filled, so GetGdtTargets() is safe for parallel callers
+	std::mutex gdtMutex;
 
 	// the dart Bulit-in type class id
 	intptr_t dartIntCid;
@@ -79,9 +117,14 @@ private:
 
 	intptr_t throwStubAddr;
 
+	friend class AnalysisCache;
+	friend class AnalysisDbWriter;
+	friend class CallGraph;
 	friend class CodeAnalyzer;
 	friend class DartAnalyzer;
 	friend class DartDumper;
+	friend class FieldXrefs;
 	friend class FridaWriter;
+	friend class PoolXrefs;
 };
 
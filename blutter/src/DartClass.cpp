@@ -3,6 +3,7 @@
 #include "DartLibrary.h"
 #include "DartFunction.h"
 #include "HtArrayIterator.h"
+#include "OutputSink.h"
 #include <numeric>
 
 DartClass::DartClass(const DartLibrary& lib_, const dart::Class& cls) :
@@ -19,6 +20,7 @@ DartClass::DartClass(const DartLibrary& lib_, const dart::Class& cls) :
 		// Note: Dart use "Object" as instance name because it is parent of all class
 		name = cls.ScrubbedNameCString();
 	}
+	fullName = name;
 
 	// host_instance_size() is allocated size from heap (need alignment)
 	// we need only exact size to know the offset of subclass members
@@ -206,18 +208,18 @@ std::string DartClass::FullNameWithPackage() const
 	return "[" + lib.url + "] " + name + typeVectorName;
 }
 
-void DartClass::PrintHead(std::ostream& of)
+void DartClass::PrintHead(OutputSink& of)
 {
 	if (superCls == NULL)
-		of << std::format("\n// class id: {}, size: {:#x}\n", id, size);
+		of.Print("\n// class id: {}, size: {:#x}\n", id, size);
 	else
-		of << std::format("\n// class id: {}, size: {:#x}, field offset: {:#x}\n", id, size, superCls->size);
+		of.Print("\n// class id: {}, size: {:#x}, field offset: {:#x}\n", id, size, superCls->size);
 	if (dart::ClassTable::IsTopLevelCid(id)) {
 		of << "class :: {\n";
 		return;
 	}
 	if (superCls == NULL) {
-		of << std::format("class {};\n", name.c_str());
+		of.Print("class {};\n", name.c_str());
 		return;
 	}
 
@@ -265,7 +267,7 @@ void DartClass::PrintHead(std::ostream& of)
 	of << " {\n";
 }
 
-void DartClass::PrintFoot(std::ostream& of)
+void DartClass::PrintFoot(OutputSink& of)
 {
 	of << "}\n";
 }
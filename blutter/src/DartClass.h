@@ -4,6 +4,7 @@
 
 class DartLibrary;
 class DartFunction;
+class OutputSink;
 
 class DartClass
 {
@@ -38,7 +39,8 @@ public:
 	DartType* DeclarationType() { return declarationType; }
 
 	const std::string& Name() const { return name; }
-	std::string FullName() const { return name + typeVectorName; }
+	// name with type parameters. it is shown for every call site returning this class, so it is created once
+	const std::string& FullName() const { return fullName; }
 	std::string FullNameWithPackage() const;
 
 	uint32_t NumTypeArguments() const { return num_type_arguments; }
@@ -54,8 +56,8 @@ public:
 	std::vector<DartField*>& Fields() { return fields; }
 	std::vector<DartFunction*>& Functions() { return functions; };
 
-	void PrintHead(std::ostream& of);
-	void PrintFoot(std::ostream& of);
+	void PrintHead(OutputSink& of);
+	void PrintFoot(OutputSink& of);
 
 private:
 	const DartLibrary& lib;
@@ -67,6 +69,7 @@ private:
 	DartType* declarationType;
 	std::string name;
 	std::string typeVectorName; // <type parameters>
+	std::string fullName; // name + typeVectorName
 	std::string parentTypeVectorName; // <type parameters> of parent class for this class
 	ClassType type;
 	//uint32_t parent_id;
@@ -88,5 +91,6 @@ private:
 	std::vector<DartFunction*> functions;
 
 	friend class DartApp;
+	friend class ClassHierarchy;
 };
 
@@ -7,9 +7,18 @@
 #include <iostream>
 #include <sstream>
 #include <numeric>
+#include <array>
+#include <unordered_set>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <chrono>
 #include "Disassembler.h"
 #include "DartThreadInfo.h"
 #include "CodeAnalyzer.h"
+#include "OutputSink.h"
+#include "Util.h"
 
 // TODO: move arm64 specific code to *_arm64 file
 
@@ -72,8 +81,9 @@ static std::string getFunctionName4Ida(const DartFunction& dartFn, const std::st
 
 void DartDumper::Dump4Ida(std::filesystem::path outDir)
 {
-	std::filesystem::create_directory(outDir);
-	std::ofstream of((outDir / "addNames.py").string());
+	if (!OutputSink::InArchive(outDir))
+		std::filesystem::create_directory(outDir);
+	OutputSink of(outDir / "addNames.py");
 	of << "import ida_funcs\n";
 	of << "import idaapi\n\n";
 
@@ -84,11 +94,11 @@ void DartDumper::Dump4Ida(std::filesystem::path outDir)
 			for (auto dartFn : cls->Functions()) {
 				const auto ep = dartFn->Address();
 				auto name = getFunctionName4Ida(*dartFn, cls_prefix);
-				of << std::format("ida_funcs.add_func({:#x}, {:#x})\n", ep, ep + dartFn->Size());
-				of << std::format("idaapi.set_name({:#x}, \"{}_{}::{}_{:x}\")\n", ep, lib_prefix, cls_prefix, name.c_str(), ep);
+				of.Print("ida_funcs.add_func({:#x}, {:#x})\n", ep, ep + dartFn->Size());
+				of.Print("idaapi.set_name({:#x}, \"{}_{}::{}_{:x}\")\n", ep, lib_prefix, cls_prefix, name.c_str(), ep);
 				if (dartFn->HasMorphicCode()) {
-					of << std::format("idaapi.set_name({:#x}, \"{}_{}::{}_{:x}_miss\")\n", dartFn->PayloadAddress(), lib_prefix, cls_prefix, name.c_str(), ep);
-					of << std::format("idaapi.set_name({:#x}, \"{}_{}::{}_{:x}_check\")\n", dartFn->MonomorphicAddress(), lib_prefix, cls_prefix, name.c_str(), ep);
+					of.Print("idaapi.set_name({:#x}, \"{}_{}::{}_{:x}_miss\")\n", dartFn->PayloadAddress(), lib_prefix, cls_prefix, name.c_str(), ep);
+					of.Print("idaapi.set_name({:#x}, \"{}_{}::{}_{:x}_check\")\n", dartFn->MonomorphicAddress(), lib_prefix, cls_prefix, name.c_str(), ep);
 				}
 			}
 		}
@@ -102,10 +112,10 @@ void DartDumper::Dump4Ida(std::filesystem::path outDir)
 		std::replace(name.begin(), name.end(), '>', '@');
 		std::replace(name.begin(), name.end(), ',', '&');
 		std::replace(name.begin(), name.end(), ' ', '_');
-		of << std::format("idaapi.set_name({:#x}, \"{}_{:x}\")\n", ep, name.c_str(), ep);
+		of.Print("idaapi.set_name({:#x}, \"{}_{:x}\")\n", ep, name.c_str(), ep);
 		if (stub->Size() == 0)
 			continue;
-		of << std::format("ida_funcs.add_func({:#x}, {:#x})\n", ep, ep + stub->Size());
+		of.Print("ida_funcs.add_func({:#x}, {:#x})\n", ep, ep + stub->Size());
 	}
 
 
@@ -126,7 +136,7 @@ def create_Dart_structs():
 	struc = ida_struct.get_struc(sid2)
 )CBLOCK";
 	for (const auto& [offset, comment] : comments) {
-		of << "\tida_struct.set_member_cmt(ida_struct.get_member(struc, " << offset << "), '''" << comment << "''', True)\n";
+		of.Print("\tida_struct.set_member_cmt(ida_struct.get_member(struc, {}), '''{}''', True)\n", offset, comment);
 	}
 	of << "\treturn sid1, sid2\n";
 	of << "thrs, pps = create_Dart_structs()\n";
@@ -135,11 +145,12 @@ def create_Dart_structs():
 	applyStruct4Ida(of);
 
 	of << "print('Script finished!')\n";
+	of.Close();
 }
 
 std::vector<std::pair<intptr_t, std::string>> DartDumper::DumpStructHeaderFile(std::string outFile)
 {
-	std::ofstream of(outFile);
+	OutputSink of(outFile);
 
 	const auto max_offset = GetThreadMaxOffset();
 	auto padNo = 0;
@@ -147,11 +158,11 @@ std::vector<std::pair<intptr_t, std::string>> DartDumper::DumpStructHeaderFile(s
 	for (intptr_t i = 0; i <= max_offset; i += 8) {
 		auto& name = GetThreadOffsetName((int)i);
 		if (name.empty()) {
-			of << "\t__int64 pad" << std::hex << padNo << ";\n";
+			of.Print("\t__int64 pad{:x};\n", padNo);
 			padNo++;
 		}
 		else {
-			of << "\t__int64 " << name << ";\n";
+			of.Print("\t__int64 {};\n", name);
 		}
 	}
 	of << "} DartThread;\n";
@@ -161,53 +172,43 @@ std::vector<std::pair<intptr_t, std::string>> DartDumper::DumpStructHeaderFile(s
 	of << "\t__int64 pad1;\n";
 
 	std::vector<std::pair<intptr_t, std::string>> comments;
-	const auto& pool = app.GetObjectPool();
+	renderPoolDescriptions();
+	const auto& pool = app.GetPool();
 	intptr_t num = pool.Length();
 
-	auto& obj = dart::Object::Handle();
 	for (intptr_t i = num - 1; i >= 0; i--) {
 		// the Dart Code access ObjectPool with offset that is not subtract by kHeapObjectTag (1)
 		//   so we have to add 1 to make the offset same as offset in the code
 		intptr_t offset = dart::ObjectPool::OffsetFromIndex(i) + 1;
 		std::string name;
 
-		auto objType = pool.TypeAt(i);
-		if (objType == dart::ObjectPool::EntryType::kTaggedObject) {
-			obj = pool.ObjectAt(i);
-			if (obj.IsUnlinkedCall()) {
-				const auto imm = pool.RawValueAt(i + 1);
-				auto dartFn = app.GetFunction(imm - app.base());
-				name = std::format("UnlinkedCall_{:#x}_{:#x}", offset, dartFn->Address(), offset);
-			}
-			else {
-				// TODO: more meaningful variable name
-				name = std::format("Obj_{:#x}", offset);
-				auto comment = ObjectToString(obj);
-				comments.push_back(std::make_pair(offset, comment));
-			}
+		const auto& entry = pool.EntryAt(i);
+		if (entry.kind == DartPoolEntry::UnlinkedCall) {
+			name = std::format("UnlinkedCall_{:#x}_{:#x}", offset, entry.fn->Address(), offset);
 		}
-		else if (objType == dart::ObjectPool::EntryType::kImmediate) {
-			name = std::format("IMM_{:#x}_{:#x}", pool.RawValueAt(i), offset);
+		else if (entry.kind == DartPoolEntry::Immediate) {
+			name = std::format("IMM_{:#x}_{:#x}", entry.rawVal, offset);
 		}
-		else if (objType == dart::ObjectPool::EntryType::kNativeFunction) {
-			// the name of NativeFunction can be retrieved from dart::NativeSymbolResolver::LookupSymbolName
-			//   but normally flutter code never access it
-			// if we use the name, we should cache it because many Pool Objects reference same NativeFunction
-			name = std::format("NativeFn_{:#x}_{:#x}", pool.RawValueAt(i), offset);
+		else if (entry.kind == DartPoolEntry::NativeFunction) {
+			// normally flutter code never access NativeFunction. the name is kept in the description
+			name = std::format("NativeFn_{:#x}_{:#x}", entry.rawVal, offset);
 		}
 		else {
-			name = std::format("RAW_{:#x}_{:#x}", pool.RawValueAt(i), offset);
+			// TODO: more meaningful variable name
+			name = std::format("Obj_{:#x}", offset);
+			comments.push_back(std::make_pair(offset, entry.descFull));
 		}
 
-		of << "\t__int64 " << name << ";\n";
+		of.Print("\t__int64 {};\n", name);
 	}
 
 	of << "} DartObjectPool;\n";
+	of.Close();
 
 	return comments;
 }
 
-void DartDumper::applyStruct4Ida(std::ostream& of)
+void DartDumper::applyStruct4Ida(OutputSink& of)
 {
 	Disassembler disasmer;
 
@@ -223,7 +224,8 @@ void DartDumper::applyStruct4Ida(std::ostream& of)
 				if (dartFn->PayloadSize() == 0)
 					continue;
 
-				auto insns = disasmer.Disasm((uint8_t*)dartFn->PayloadAddress() + app.base(), dartFn->PayloadSize(), dartFn->Address());
+				auto insns = app.codeInsns ? app.codeInsns->View(dartFn->PayloadAddress(), dartFn->PayloadSize()) :
+					disasmer.Disasm((uint8_t*)dartFn->PayloadAddress() + app.base(), dartFn->PayloadSize(), dartFn->Address());
 
 				for (uint32_t i = 0; i < insns.Count(); i++) {
 					auto insn = insns.At(i);
@@ -236,14 +238,14 @@ void DartDumper::applyStruct4Ida(std::ostream& of)
 						else if (insn.ops[j].type == ARM64_OP_MEM)
 							reg = insn.ops[j].mem.base;
 						if (reg == CSREG_DART_THR) {
-							of << "ida_ua.decode_insn(insn, " << insn.address() << ")\n";
-							of << "idc.op_stroff(insn, " << (int)j << ", thrs, 0)\n";
+							of.Print("ida_ua.decode_insn(insn, {})\n", insn.address());
+							of.Print("idc.op_stroff(insn, {}, thrs, 0)\n", (int)j);
 							break;
 						}
 						else if (reg == CSREG_DART_PP) {
 							// TODO: if it is not MEM operand, reg cannot be struct offset
-							of << "ida_ua.decode_insn(insn, " << insn.address() << ")\n";
-							of << "idc.op_stroff(insn, " << (int)j << ", pps, 0)\n";
+							of.Print("ida_ua.decode_insn(insn, {})\n", insn.address());
+							of.Print("idc.op_stroff(insn, {}, pps, 0)\n", (int)j);
 							break;
 						}
 					}
@@ -256,117 +258,301 @@ void DartDumper::applyStruct4Ida(std::ostream& of)
 const std::string& DartDumper::getQuoteString(dart::Object& obj)
 {
 	const auto ptr = (intptr_t)obj.ptr();
-	auto& txt = quoteStringCache[ptr];
-	// because string is always quotes, empty string means inserting a new one
-	if (txt.empty()) {
-		txt = Util::UnescapeWithQuote(obj.ToCString());
+	{
+		std::shared_lock lock(quoteStringMutex);
+		auto itr = quoteStringCache.find(ptr);
+		if (itr != quoteStringCache.end())
+			return itr->second;
 	}
-	return txt;
+	auto txt = Util::UnescapeWithQuote(obj.ToCString());
+	// reference to an element of unordered_map is never invalidated by inserting
+	std::unique_lock lock(quoteStringMutex);
+	return quoteStringCache.try_emplace(ptr, std::move(txt)).first->second;
 }
 
-void DartDumper::DumpCode(const char* out_dir)
+void DartDumper::DumpCode(const char* out_dir, unsigned int numThreads)
 {
-	std::filesystem::create_directory(out_dir);
-
-	Disassembler disasmer;
-
+	if (!OutputSink::InArchive(out_dir))
+		std::filesystem::create_directory(out_dir);
+	renderPoolDescriptions();
+	// types are shown in almost every function. pool rendering above might create new types, so cache names after it
+	app.typeDb->CacheNames();
+
+	// paths are created before rendering because libraries might share directories
+	std::vector<std::pair<DartLibrary*, std::string>> jobs;
 	for (auto dartLib : app.libs) {
 		if (dartLib->isInternal)
 			continue;
+		jobs.emplace_back(dartLib, dartLib->CreatePath(out_dir));
+	}
+	std::vector<AsmIndex::FileRanges> ranges(jobs.size());
+	for (size_t i = 0; i < jobs.size(); i++)
+		ranges[i].path = jobs[i].second;
+
+	const auto startTime = std::chrono::steady_clock::now();
+	const auto startBytes = OutputSink::TotalBytes();
+	if (numThreads <= 1) {
+		for (size_t i = 0; i < jobs.size(); i++) {
+			// only one thread renders. writing the file in background lets rendering continue
+			OutputSink of(jobs[i].second, false, true);
+			dumpLibraryCode(*jobs[i].first, of, ranges[i]);
+			of.Close();
+		}
+	}
+	else {
+		dumpCodeParallel(jobs, ranges, numThreads);
+	}
 
-		auto out_file = dartLib->CreatePath(out_dir);
-		std::ofstream of(out_file);
-		dartLib->PrintCommentInfo(of);
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+	const auto mbytes = (OutputSink::TotalBytes() - startBytes) / (1024.0 * 1024.0);
+	std::cout << std::format("Wrote {:.1f} MB of asm files in {} ms ({:.1f} MB/s)\n", mbytes, elapsed, elapsed ? mbytes * 1000 / elapsed : 0.0);
 
-		for (auto dartCls : dartLib->classes) {
-			dartCls->PrintHead(of);
+	AsmIndex::Create(ranges, std::filesystem::path(out_dir).lexically_normal().concat(".idx"));
+}
 
-			if (!dartCls->Fields().empty())
-				of << "\n";
-			for (auto dartField : dartCls->Fields()) {
-				dartField->Print(of);
+void DartDumper::dumpCodeParallel(std::vector<std::pair<DartLibrary*, std::string>>& jobs, std::vector<AsmIndex::FileRanges>& ranges, unsigned int numThreads)
+{
+	// every library is written to its own file, so the output is same as serial dumping.
+	// largest library first for better balance between threads
+	auto libCodeSize = [](DartLibrary* lib) {
+		size_t size = 0;
+		for (auto cls : lib->classes) {
+			for (auto dartFn : cls->Functions())
+				size += dartFn->Size();
+		}
+		return size;
+	};
+	std::vector<std::pair<size_t, size_t>> order; // code size, job index
+	for (size_t i = 0; i < jobs.size(); i++)
+		order.emplace_back(libCodeSize(jobs[i].first), i);
+	std::sort(order.begin(), order.end(), std::greater<>());
+
+	std::atomic<size_t> nextJob{ 0 };
+	std::exception_ptr error;
+	std::mutex errorMutex;
+	auto worker = [&]() {
+		// Dart objects are read by printing function declarations and values. the thread must be a Dart thread
+		dart::Thread::EnterIsolateGroupAsHelper(app.isolate->group(), dart::Thread::kUnknownTask, true);
+		{
+			auto thread = dart::Thread::Current();
+			dart::StackZone zone(thread);
+			try {
+				for (auto i = nextJob++; i < order.size(); i = nextJob++) {
+					dart::HandleScope handleScope(thread);
+					auto& [dartLib, out_file] = jobs[order[i].second];
+					OutputSink of(out_file);
+					dumpLibraryCode(*dartLib, of, ranges[order[i].second]);
+					of.Close();
+				}
 			}
+			catch (...) {
+				std::lock_guard lock(errorMutex);
+				if (!error)
+					error = std::current_exception();
+				nextJob = order.size();
+			}
+		}
+		dart::Thread::ExitIsolateGroupAsHelper(true);
+	};
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < std::min<size_t>(numThreads, order.size()); i++)
+		threads.emplace_back(worker);
+	for (auto& t : threads)
+		t.join();
+	if (error)
+		std::rethrow_exception(error);
+}
 
-			if (!dartCls->Functions().empty())
-				of << "\n";
-			for (auto dartFn : dartCls->Functions()) {
-				dartFn->PrintHead(of);
+void DartDumper::dumpLibraryCode(DartLibrary& dartLib, OutputSink& of, AsmIndex::FileRanges& ranges)
+{
+	dartLib.PrintCommentInfo(of);
+
+	for (auto dartCls : dartLib.classes) {
+		const auto clsStart = of.Position();
+		const auto clsIdx = (uint32_t)ranges.classes.size();
+		dartCls->PrintHead(of);
+
+		if (!dartCls->Fields().empty())
+			of << "\n";
+		for (auto dartField : dartCls->Fields()) {
+			dartField->Print(of);
+		}
+
+		if (!dartCls->Functions().empty())
+			of << "\n";
+		for (auto dartFn : dartCls->Functions()) {
+			const auto fnStart = of.Position();
+			dartFn->PrintHead(of);
 
 #ifndef NO_CODE_ANALYSIS
-				// use as app is loaded at zero
-				if (dartFn->Size() > 0) {
-					auto& asmTexts = dartFn->GetAnalyzedData()->asmTexts.Data();
-					auto& il_insns = dartFn->GetAnalyzedData()->il_insns;
-					auto il_itr = il_insns.begin();
-					AddrRange range;
-					ASSERT(!asmTexts.empty());
-					for (auto& asmText : asmTexts) {
-						std::string extra;
-						switch (asmText.dataType) {
-						case AsmText::ThreadOffset:
-							extra = "THR::" + GetThreadOffsetName(asmText.threadOffset);
-							break;
-						case AsmText::PoolOffset:
-							extra = getPoolObjectDescription(asmText.poolOffset);
-							break;
-						case AsmText::Boolean:
-							extra = asmText.boolVal ? "true" : "false";
-							break;
-						case AsmText::Call: {
-							auto* fn = app.GetFunction(asmText.callAddress);
-							if (fn) {
-								extra = fn->FullName();
-								auto retCid = fn->ReturnType();
-								if (retCid != dart::kIllegalCid) {
-									auto retCls = app.classes.at(retCid);
-									extra += std::format(" -> {} (size={:#x})", retCls->FullName(), retCls->Size());
-								}
+			// use as app is loaded at zero
+			if (dartFn->Size() > 0) {
+				auto fnData = dartFn->GetAnalyzedData();
+				auto& asmTexts = fnData->asmTexts.Data();
+				auto& il_insns = fnData->ILs();
+				// ILs might be from other function with same code
+				const int64_t ilDelta = fnData->sameCodeDelta;
+				auto il_itr = il_insns.begin();
+				AddrRange range;
+				ASSERT(!asmTexts.empty());
+				for (auto& asmText : asmTexts) {
+					of << "    // ";
+
+					if (range.Has(asmText.addr)) {
+						of << "    ";
+					}
+					else {
+						// no IL if analysis of the function is skipped
+						while (il_itr != il_insns.end() && (*il_itr)->Start() + ilDelta < asmText.addr) {
+							if ((*il_itr)->Kind() != ILInstr::Unknown) {
+								of.Print("{:#x}: ", (*il_itr)->Start() + ilDelta);
+								of.Append(**il_itr);
+								of << "\n    // ";
 							}
-							break;
+							++il_itr;
 						}
+						if (il_itr != il_insns.end() && (*il_itr)->Start() + ilDelta == asmText.addr) {
+							if ((*il_itr)->Kind() != ILInstr::Unknown) {
+								of.Print("{:#x}: ", asmText.addr);
+								of.Append(**il_itr);
+								of << "\n    //     ";
+								range = AddrRange((*il_itr)->Start() + ilDelta, (*il_itr)->End() + ilDelta);
+							}
+							++il_itr;
 						}
+					}
 
-						of << "    // ";
-
-						if (range.Has(asmText.addr)) {
-							of << "    ";
-						}
-						else {
-							while ((*il_itr)->Start() < asmText.addr) {
-								if ((*il_itr)->Kind() != ILInstr::Unknown) {
-									of << std::format("{:#x}: {}\n", (*il_itr)->Start(), (*il_itr)->ToString());
-									of << "    // ";
-								}
-								++il_itr;
-							}
-							if ((*il_itr)->Start() == asmText.addr) {
-								if ((*il_itr)->Kind() != ILInstr::Unknown) {
-									of << std::format("{:#x}: {}\n", asmText.addr, (*il_itr)->ToString());
-									of << "    //     ";
-									range = (*il_itr)->Range();
-								}
-								++il_itr;
+					of.Print("{:#x}: {}", asmText.addr, &asmText.text[0]);
+					switch (asmText.dataType) {
+					case AsmText::ThreadOffset:
+						of.Print("  ; THR::{}", GetThreadOffsetName(asmText.threadOffset));
+						break;
+					case AsmText::PoolOffset:
+						// simple form of getPoolObjectDescription()
+						of.Print("  ; [pp+{:#x}] {}", asmText.poolOffset, app.GetPool().At(asmText.poolOffset).desc);
+						break;
+					case AsmText::Boolean:
+						of << (asmText.boolVal ? "  ; true" : "  ; false");
+						break;
+					case AsmText::Call: {
+						auto* fn = app.GetFunction(asmText.callAddress);
+						if (fn) {
+							of.Print("  ; {}", fn->FullName());
+							auto retCid = fn->ReturnType();
+							if (retCid != dart::kIllegalCid) {
+								auto retCls = app.classes.at(retCid);
+								of.Print(" -> {} (size={:#x})", retCls->FullName(), retCls->Size());
 							}
 						}
-
-						if (extra.empty())
-							of << std::format("{:#x}: {}\n", asmText.addr, &asmText.text[0]);
-						else
-							of << std::format("{:#x}: {}  ; {}\n", asmText.addr, &asmText.text[0], extra);
+						break;
 					}
+					}
+					of << '\n';
 				}
+			}
 #endif // NO_CODE_ANALYSIS
 
-				dartFn->PrintFoot(of);
-			}
+			dartFn->PrintFoot(of);
+			ranges.functions.push_back({ dartFn, clsIdx, fnStart, (uint32_t)(of.Position() - fnStart) });
+		}
+
+		dartCls->PrintFoot(of);
+		ranges.classes.push_back({ dartCls, clsStart, of.Position() - clsStart });
+	}
+}
+
+// "0x" and hex digits without leading zero (same as "{:#x}"). digits are taken 2 at a time from a table
+static constexpr auto HEX_PAIRS = [] {
+	constexpr char digits[] = "0123456789abcdef";
+	std::array<char, 512> pairs{};
+	for (int i = 0; i < 256; i++) {
+		pairs[i * 2] = digits[i >> 4];
+		pairs[i * 2 + 1] = digits[i & 0xf];
+	}
+	return pairs;
+}();
 
-			dartCls->PrintFoot(of);
+static void appendHex(fmt::memory_buffer& out, uint64_t val)
+{
+	char tmp[16];
+	char* const end = tmp + sizeof(tmp);
+	char* p = end;
+	do {
+		p -= 2;
+		memcpy(p, &HEX_PAIRS[(val & 0xff) * 2], 2);
+		val >>= 8;
+	} while (val != 0);
+	if (*p == '0' && p + 1 != end)
+		p++;
+	Util::Append(out, "0x");
+	out.append(p, end);
+}
+
+// render elements as "[e1, e2, ..." in one pass. caller closes the bracket
+template <typename T>
+static void appendTypedData(fmt::memory_buffer& out, const T* data, intptr_t num)
+{
+	out.push_back('[');
+	for (intptr_t i = 0; i < num; i++) {
+		if (i != 0)
+			Util::Append(out, ", ");
+		if constexpr (std::is_floating_point_v<T>) {
+			fmt::format_to(std::back_inserter(out), "{}", data[i]);
+		}
+		else if constexpr (std::is_signed_v<T>) {
+			if (data[i] < 0) {
+				out.push_back('-');
+				appendHex(out, 0 - (uint64_t)(int64_t)data[i]);
+			}
+			else {
+				appendHex(out, (uint64_t)data[i]);
+			}
 		}
+		else {
+			appendHex(out, data[i]);
+		}
+	}
+}
+
+void DartDumper::ExtractTypedData(std::filesystem::path dir, size_t minBytes)
+{
+	std::filesystem::create_directories(dir);
+	typedDataDir = std::move(dir);
+	typedDataMinBytes = minBytes;
+}
+
+std::string DartDumper::extractTypedData(dart::TypedDataPtr arrPtr, const void* data, size_t size)
+{
+	// file name is heap offset of the object, so it is same for every run on same libapp
+	const auto name = std::format("{:x}.bin", (intptr_t)arrPtr - app.heap_base());
+	const auto txt = std::format("=> {}/{}", typedDataDir.filename().string(), name);
+	{
+		// same object is rendered many times (pool entry, nested object)
+		std::lock_guard lock(typedDataMutex);
+		if (!extractedTypedData.insert((intptr_t)arrPtr).second)
+			return txt;
 	}
+
+	// write directly from the heap memory. no copy and no formatting
+	const auto path = typedDataDir / name;
+#ifdef _WIN32
+	auto fp = _wfopen(path.c_str(), L"wb");
+#else
+	auto fp = fopen(path.c_str(), "wb");
+#endif
+	if (fp == nullptr)
+		throw std::runtime_error(std::format("cannot open {}", path.string()));
+	const bool ok = fwrite(data, 1, size, fp) == size;
+	if (fclose(fp) != 0 || !ok)
+		throw std::runtime_error(std::format("cannot write {}", path.string()));
+	return txt;
 }
 
 // collect instance ptr to dump the full contents in DumpObjects()
-static std::set<intptr_t> knownObjectPtrs;
+static std::unordered_set<intptr_t> knownObjectPtrs;
+// same objects in found order. DumpObjects() appends the instances that are found while dumping
+static std::vector<intptr_t> knownObjectList;
+static std::mutex knownObjectPtrsMutex;
 
 std::string DartDumper::ObjectToString(dart::Object& obj, bool simpleForm, bool nestedObj, int depth)
 {
@@ -386,60 +572,61 @@ std::string DartDumper::ObjectToString(dart::Object& obj, bool simpleForm, bool
 		auto& arr = dart::TypedData::Cast(obj);
 		const auto arr_len = arr.Length();
 		auto ptr = arr.DataAddr(0);
-		std::string txt;
+		fmt::memory_buffer out;
+		Util::Append(out, app.GetClass(cid)->Name());
+		fmt::format_to(std::back_inserter(out), "({}) ", arr_len);
+		// large data is useless as text. the raw bytes are written to a file
+		const auto numBytes = arr.LengthInBytes();
+		if (!typedDataDir.empty() && numBytes >= typedDataMinBytes) {
+			Util::Append(out, extractTypedData(arr.ptr(), ptr, numBytes));
+			return fmt::to_string(out);
+		}
 		if (arr_len > 0) {
+			const auto num = typedDataLimit != 0 ? std::min(arr_len, (intptr_t)typedDataLimit) : arr_len;
 			switch (arr.ElementType()) {
-#define ACCUMLATE(type) { \
-	auto data = (type*)ptr; \
-	txt = std::accumulate(data + 1, data + arr_len, std::format("[{:#x}", data[0]), [](std::string x, type y) { return x + ", " + std::format("{:#x}", y); } ); \
-}
 			case dart::kInt8ArrayElement:
-				ACCUMLATE(int8_t);
+				appendTypedData(out, (int8_t*)ptr, num);
 				break;
 			case dart::kUint8ArrayElement:
 			case dart::kUint8ClampedArrayElement:
-				ACCUMLATE(uint8_t);
+				appendTypedData(out, (uint8_t*)ptr, num);
 				break;
 			case dart::kInt16ArrayElement:
-				ACCUMLATE(int16_t);
+				appendTypedData(out, (int16_t*)ptr, num);
 				break;
 			case dart::kUint16ArrayElement:
-				ACCUMLATE(uint16_t);
+				appendTypedData(out, (uint16_t*)ptr, num);
 				break;
 			case dart::kInt32ArrayElement:
-				ACCUMLATE(int32_t);
+				appendTypedData(out, (int32_t*)ptr, num);
 				break;
 			case dart::kUint32ArrayElement:
-				ACCUMLATE(uint32_t);
+				appendTypedData(out, (uint32_t*)ptr, num);
 				break;
 			case dart::kInt64ArrayElement:
-				ACCUMLATE(int64_t);
+				appendTypedData(out, (int64_t*)ptr, num);
 				break;
 			case dart::kUint64ArrayElement:
-				ACCUMLATE(uint64_t);
+				appendTypedData(out, (uint64_t*)ptr, num);
 				break;
-#undef ACCUMLATE
-#define ACCUMLATE(type) { \
-	auto data = (type*)ptr; \
-	txt = std::accumulate(data + 1, data + arr_len, std::format("[{}", data[0]), [](std::string x, type y) { return x + ", " + std::format("{}", y); } ); \
-}
 			case dart::kFloat32ArrayElement:
-				ACCUMLATE(float);
+				appendTypedData(out, (float*)ptr, num);
 				break;
 			case dart::kFloat64ArrayElement:
-				ACCUMLATE(double);
+				appendTypedData(out, (double*)ptr, num);
 				break;
-#undef ACCUMLATE
 			case dart::kFloat32x4ArrayElement:
 			case dart::kInt32x4ArrayElement:
 			case dart::kFloat64x2ArrayElement:
 				FATAL("TODO: simd array");
 			}
 
-			txt += ']';
+			if (num < arr_len)
+				Util::Append(out, ", ...");
+			out.push_back(']');
 		}
 		//arr.ElementSizeInBytes();
-		return std::format("{}({}) {}", app.GetClass(cid)->Name(), arr_len, txt);
+		return fmt::to_string(out);
 	}
 
 	switch (cid) {
@@ -641,7 +828,11 @@ std::string DartDumper::ObjectToString(dart::Object& obj, bool simpleForm, bool
 	}
 
 	// TODO: print library and package prefix
-	knownObjectPtrs.insert((intptr_t)obj.ptr());
+	{
+		std::lock_guard lock(knownObjectPtrsMutex);
+		if (knownObjectPtrs.insert((intptr_t)obj.ptr()).second)
+			knownObjectList.push_back((intptr_t)obj.ptr());
+	}
 	return dumpInstance(obj, simpleForm, nestedObj, depth);
 }
 
@@ -754,80 +945,104 @@ std::string DartDumper::dumpInstanceFields(dart::Object& obj, DartClass& dartCls
 	return ss.str();
 }
 
-std::string DartDumper::getPoolObjectDescription(intptr_t offset, bool simpleForm)
+void DartDumper::renderPoolDescriptions()
 {
-	const auto& pool = app.GetObjectPool();
-	intptr_t idx = dart::ObjectPool::IndexFromOffset(offset);
-	auto objType = pool.TypeAt(idx);
-	// see how the EntryType is handled from vm/object_service.cc - ObjectPool::PrintJSONImpl()
-	if (objType == dart::ObjectPool::EntryType::kTaggedObject) {
-		auto& obj = dart::Object::Handle(pool.ObjectAt(idx));
-		if (obj.IsUnlinkedCall()) {
-			ASSERT(pool.TypeAt(idx + 1) == dart::ObjectPool::EntryType::kImmediate);
-			const auto imm = pool.RawValueAt(idx + 1);
-			auto dartFn = app.GetFunction(imm - app.base());
-			return std::format("[pp+{:#x}] UnlinkedCall: {:#x} - {}", offset, dartFn->Address(), dartFn->FullName().c_str());
-		}
-		return std::format("[pp+{:#x}] {}", offset, ObjectToString(obj, simpleForm));
-	}
-	else if (objType == dart::ObjectPool::EntryType::kImmediate) {
-		dart::uword imm = pool.RawValueAt(idx);
-		if (imm <= 0x1000000000000000 || imm >= 0xffffffffffff0000) {
-			return std::format("[pp+{:#x}] IMM: {:#x}", offset, imm);
-		}
-		else {
-			return std::format("[pp+{:#x}] IMM: double({}) from {:#x}", offset, *((double*)&imm), imm);
-		}
-	}
-	else if (objType == dart::ObjectPool::EntryType::kNativeFunction) {
-		auto pc = pool.RawValueAt(idx);
-		uintptr_t start = 0;
-		char* name = dart::NativeSymbolResolver::LookupSymbolName(pc, &start);
-		if (name != NULL) {
-			auto txt = std::format("[pp+{:#x}] NativeFn: {} at {:#x}", offset, name, pc);
-			dart::NativeSymbolResolver::FreeSymbolName(name);
-			return txt;
+	auto& pool = *app.pool;
+	if (pool.HasDescriptions())
+		return;
+
+	// many pool entries reference same NativeFunction. lookup the name only once
+	std::unordered_map<uint64_t, std::string> nativeNames;
+	auto& obj = dart::Object::Handle();
+	for (auto& entry : pool.entries) {
+		switch (entry.kind) {
+		case DartPoolEntry::UnlinkedCall:
+			entry.desc = std::format("UnlinkedCall: {:#x} - {}", entry.fn->Address(), entry.fn->FullName().c_str());
+			entry.descFull = entry.desc;
+			break;
+		case DartPoolEntry::Immediate:
+			// see how the EntryType is handled from vm/object_service.cc - ObjectPool::PrintJSONImpl()
+			if (entry.rawVal <= 0x1000000000000000 || entry.rawVal >= 0xffffffffffff0000) {
+				entry.desc = std::format("IMM: {:#x}", entry.rawVal);
+			}
+			else {
+				entry.desc = std::format("IMM: double({}) from {:#x}", entry.dblVal, entry.rawVal);
+			}
+			entry.descFull = entry.desc;
+			break;
+		case DartPoolEntry::NativeFunction: {
+			auto it = nativeNames.find(entry.rawVal);
+			if (it == nativeNames.end()) {
+				uintptr_t start = 0;
+				char* name = dart::NativeSymbolResolver::LookupSymbolName(entry.rawVal, &start);
+				it = nativeNames.emplace(entry.rawVal, name != NULL ? name : "[no name]").first;
+				if (name != NULL)
+					dart::NativeSymbolResolver::FreeSymbolName(name);
+			}
+			entry.desc = std::format("NativeFn: {} at {:#x}", it->second, entry.rawVal);
+			entry.descFull = entry.desc;
+			break;
 		}
-		else {
-			return std::format("[pp+{:#x}] NativeFn: [no name] at {:#x}", offset, pc);
+		default:
+			obj = entry.ptr;
+			entry.desc = ObjectToString(obj, true);
+			entry.descFull = ObjectToString(obj, false);
+			break;
 		}
 	}
-	else {
-		throw std::runtime_error(std::format("unknown pool object type: {}", (int)objType).c_str());
-	}
+
+	pool.hasDescriptions = true;
+}
+
+std::string DartDumper::getPoolObjectDescription(intptr_t offset, bool simpleForm)
+{
+	const auto& entry = app.GetPool().At(offset);
+	return std::format("[pp+{:#x}] {}", offset, simpleForm ? entry.desc : entry.descFull);
 }
 
 void DartDumper::DumpObjectPool(const char* filename)
 {
-	std::ofstream of(filename);
-	const auto& pool = app.GetObjectPool();
+	renderPoolDescriptions();
+	OutputSink of(filename);
+	const auto& pool = app.GetPool();
 	intptr_t num = pool.Length();
 
-	const auto& rawObj = pool.ptr()->untag();
+	const auto& rawObj = app.GetObjectPool().ptr()->untag();
 	const auto raw_addr = dart::UntaggedObject::ToAddr(rawObj);
-	of << std::format("pool heap offset: {:#x}\n", raw_addr - app.heap_base());
+	of.Print("pool heap offset: {:#x}\n", raw_addr - app.heap_base());
 
 	for (intptr_t i = 0; i < num; i++) {
 		// offset here is from ObjectPool pointer subtracted by kHeapObjectTag
 		// add 1 to make the offset value same as offset in compiled code
 		intptr_t offset = dart::ObjectPool::OffsetFromIndex(i);
-		auto txt = getPoolObjectDescription(offset + 1, false);
-		of << txt << "\n";
-		if (txt.compare(txt.find(']'), 15, "] UnlinkedCall:") == 0)
+		of << getPoolObjectDescription(offset + 1, false) << '\n';
+		// next entry is the target of UnlinkedCall
+		if (pool.EntryAt(i).kind == DartPoolEntry::UnlinkedCall)
 			i++;
 	}
 }
 
 void DartDumper::DumpObjects(const char* filename)
 {
-	std::ofstream of(filename);
-
+	const auto startTime = std::chrono::steady_clock::now();
+	const auto startBytes = OutputSink::TotalBytes();
+	OutputSink of(filename);
+
+	// each object is written once at top level. a nested instance is written as reference (Obj!Type@id) and
+	//   it is appended to the list when it is found first time. id is low 32 bits of the pointer (heap offset).
+	// objects from pool are written in address order as before
+	std::sort(knownObjectList.begin(), knownObjectList.end());
 	auto& obj = dart::Object::Handle();
-	for (auto objPtr : knownObjectPtrs) {
-		obj = dart::ObjectPtr(objPtr);
+	size_t i = 0;
+	for (; i < knownObjectList.size(); i++) {
+		obj = dart::ObjectPtr(knownObjectList[i]);
 		const bool simpleForm = false;
-		const bool nestedObj = true;
+		const bool nestedObj = false;
 		of << dumpInstance(obj, simpleForm, nestedObj, 0);
 		of << "\n\n";
 	}
+	of.Close();
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+	std::cout << std::format("Wrote {} objects ({:.1f} KB) in {} ms\n", i, (OutputSink::TotalBytes() - startBytes) / 1024.0, elapsed);
 }
@@ -1,6 +1,12 @@
 #pragma once
 #include "DartApp.h"
+#include "AsmIndex.h"
 #include <filesystem>
+#include <shared_mutex>
+#include <mutex>
+#include <unordered_set>
+
+class OutputSink;
 
 class DartDumper
 {
@@ -11,24 +17,44 @@ public:
 
 	std::vector<std::pair<intptr_t, std::string>> DumpStructHeaderFile(std::string outFile);
 
-	void DumpCode(const char* out_dir);
+	// libraries are rendered by numThreads threads. output is same for any number of threads.
+	//   location of every function is written to index file "<out_dir>.idx"
+	void DumpCode(const char* out_dir, unsigned int numThreads = 1);
 
 	void DumpObjectPool(const char* filename);
 	void DumpObjects(const char* filename);
 
 	std::string ObjectToString(dart::Object& obj, bool simpleForm = false, bool nestedObj = false, int depth = 0);
 
+	// show at most count elements of typed data in text output. 0 for all elements
+	void SetTypedDataLimit(size_t count) { typedDataLimit = count; }
+	// write typed data that is at least minBytes to a raw .bin file in dir instead of showing the elements
+	void ExtractTypedData(std::filesystem::path dir, size_t minBytes);
+
 private:
+	// render descriptions of all pool entries once. they are shared by asm and pp.txt
+	void renderPoolDescriptions();
 	std::string getPoolObjectDescription(intptr_t offset, bool simpleForm = true);
 
 	std::string dumpInstance(dart::Object& obj, bool simpleForm = false, bool nestedObj = false, int depth = 0);
 	std::string dumpInstanceFields(dart::Object& obj, DartClass& dartCls, intptr_t ptr, intptr_t offset, bool simpleForm = false, bool nestedObj = false, int depth = 0);
 
-	void applyStruct4Ida(std::ostream& of);
+	void applyStruct4Ida(OutputSink& of);
+	void dumpLibraryCode(DartLibrary& dartLib, OutputSink& of, AsmIndex::FileRanges& ranges);
+	void dumpCodeParallel(std::vector<std::pair<DartLibrary*, std::string>>& jobs, std::vector<AsmIndex::FileRanges>& ranges, unsigned int numThreads);
 
 	const std::string& getQuoteString(dart::Object& obj);
+	// returns the text that refers to the written file
+	std::string extractTypedData(dart::TypedDataPtr arrPtr, const void* data, size_t size);
 
 	DartApp& app;
 	// map for object ptr to unescape string with quote
 	std::unordered_map<intptr_t, std::string> quoteStringCache;
+	std::shared_mutex quoteStringMutex;
+
+	size_t typedDataLimit{ 0 };
+	std::filesystem::path typedDataDir;
+	size_t typedDataMinBytes{ 0 };
+	std::unordered_set<intptr_t> extractedTypedData;
+	std::mutex typedDataMutex;
 };
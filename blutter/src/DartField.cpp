@@ -2,6 +2,7 @@
 #include "DartField.h"
 #include "DartClass.h"
 #include "DartLibrary.h"
+#include "OutputSink.h"
 
 DartField::DartField(const DartClass& cls_, dart::FieldPtr ptr_) : cls(cls_), type(nullptr), ptr(ptr_)
 {
@@ -29,14 +30,14 @@ DartField::DartField(const DartClass& cls, uint32_t offset, DartAbstractType* ty
 {
 }
 
-void DartField::Print(std::ostream& of) const
+void DartField::Print(OutputSink& of) const
 {
 	of << "  ";
 	if (ptr == nullptr) {
 		// use concrete type
 		ASSERT(type);
-		of << type->ToString();
-		of << std::format(" field_{:x};\n", offset);
+		of.Append(*type);
+		of.Print(" field_{:x};\n", offset);
 	}
 	else {
 		if (is_static)
@@ -48,7 +49,7 @@ void DartField::Print(std::ostream& of) const
 		if (is_const)
 			of << "const ";
 		of << typeName << " " << name;
-		of << std::format("; // offset: {:#x}\n", offset);
+		of.Print("; // offset: {:#x}\n", offset);
 	}
 }
 
@@ -3,6 +3,7 @@
 #include "DartTypes.h"
 
 class DartClass;
+class OutputSink;
 
 class DartField
 {
@@ -14,7 +15,7 @@ public:
 	DartField(DartField&&) = delete;
 	DartField& operator=(const DartField&) = delete;
 
-	void Print(std::ostream& of) const;
+	void Print(OutputSink& of) const;
 
 	dart::FieldPtr Ptr() const { return ptr; }
 	const std::string& Name() const { return name; }
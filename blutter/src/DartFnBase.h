@@ -25,7 +25,8 @@ public:
 	virtual uint64_t AddressEnd() const { return ep_addr + Size(); }
 	bool ContainsAddress(uint64_t addr) { return addr >= Address() && addr < AddressEnd(); }
 
-	virtual std::string FullName() const { return name; }
+	// name for showing in output. it is called for every call site, so subclasses create it once
+	virtual const std::string& FullName() const { return name; }
 	virtual std::string Name() const { return name; }
 	// TODO: use dart type to support function type and type parameters ()
 	virtual uint32_t ReturnType() const { return dart::kIllegalCid; }
@@ -5,6 +5,7 @@
 #include "DartApp.h"
 #include "VarValue.h"
 #include "CodeAnalyzer.h"
+#include "OutputSink.h"
 #include <numeric>
 #include <array>
 
@@ -19,6 +20,7 @@ DartFunction::DartFunction(DartClass& cls, const dart::FunctionPtr ptr) : DartFn
 
 	// might need internal name for complete getter and setter name
 	name = func.UserVisibleNameCString();
+	fullName = makeFullName();
 
 	is_native = func.is_native();
 	//is_closure = name == "<anonymous closure>";
@@ -123,9 +125,10 @@ DartFunction::DartFunction(DartClass& cls, const dart::Code& code)
 	size = code.Size();
 	ep_addr = code.EntryPoint() - lib_base;
 	name = "__unknown_function__";
+	fullName = makeFullName();
 }
 
-std::string DartFunction::FullName() const
+std::string DartFunction::makeFullName() const
 {
 	auto& lib = cls.Library();
 	return "[" + lib.url + "] " + cls.Name() + "::" + name;
@@ -193,7 +196,7 @@ std::string DartFunction::ToCallStatement(const std::vector<std::shared_ptr<VarI
 	return std::format("{}({})", callFn.c_str(), callArgs.c_str());
 }
 
-void DartFunction::PrintHead(std::ostream& of) const
+void DartFunction::PrintHead(OutputSink& of) const
 {
 	//of << std::format("    {} /* addr: {:#x}, size: {:#x} */\n", func.ToCString(), ep, code_size);
 	auto zone = dart::Thread::Current()->zone();
@@ -259,10 +262,10 @@ void DartFunction::PrintHead(std::ostream& of) const
 	}
 	of << " {\n";
 
-	of << std::format("    // ** addr: {:#x}, size: {:#x}\n", ep_addr, size);
+	of.Print("    // ** addr: {:#x}, size: {:#x}\n", ep_addr, size);
 }
 
-void DartFunction::PrintFoot(std::ostream& of) const
+void DartFunction::PrintFoot(OutputSink& of) const
 {
 	of << "  }\n";
 }
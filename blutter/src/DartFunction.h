@@ -5,6 +5,7 @@
 class DartClass;
 class DartApp;
 struct VarItem;
+class OutputSink;
 
 struct FnParam {
 	DartAbstractType* type{ nullptr };
@@ -62,7 +63,7 @@ public:
 	bool HasMorphicCode() const { return morphic_addr != ep_addr; }
 
 	virtual int64_t Size() const { return size > 0 ? size - (ep_addr - payload_addr) : 0; }
-	virtual std::string FullName() const;
+	virtual const std::string& FullName() const { return fullName; }
 
 	DartFunction* GetOutermostFunction() const;
 
@@ -86,10 +87,12 @@ public:
 	AnalyzedFnData* GetAnalyzedData() { return analyzedData.get(); }
 
 	std::string ToCallStatement(const std::vector<std::shared_ptr<VarItem>>& args) const;
-	void PrintHead(std::ostream& of) const;
-	void PrintFoot(std::ostream& of) const;
+	void PrintHead(OutputSink& of) const;
+	void PrintFoot(OutputSink& of) const;
 
 private:
+	std::string makeFullName() const;
+
 	DartClass& cls;
 	DartFunction* parent; // this value is nullptr for function. parent function/closure for a closure
 	dart::FunctionPtr ptr;
@@ -107,6 +110,7 @@ private:
 	//uint32_t code_size; // code size
 
 	DartFunctionSignature signature;
+	std::string fullName; // created with name because class and library are known at creation
 	std::unique_ptr<AnalyzedFnData> analyzedData;
 
 	friend class DartApp;
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "DartLibrary.h"
 #include "DartClass.h"
+#include "OutputSink.h"
 #include <filesystem>
 
 DartLibrary::DartLibrary(const dart::Library& lib) : ptr(lib.ptr()), topClass(NULL)
@@ -89,7 +90,8 @@ DartClass* DartLibrary::AddClass(const dart::Class& cls)
 
 std::string DartLibrary::CreatePath(const char* base_dir)
 {
-	// create subdirectories for the library file
+	// create subdirectories for the library file. no directory for a file in output archive
+	const bool inArchive = OutputSink::InArchive(base_dir);
 	std::string path = base_dir;
 	path.push_back('/');
 	size_t start_pos = 0;
@@ -101,7 +103,8 @@ std::string DartLibrary::CreatePath(const char* base_dir)
 	}
 	else if (url.starts_with("dart:")) {
 		path.append("dart");
-		std::filesystem::create_directories(path);
+		if (!inArchive)
+			std::filesystem::create_directories(path);
 		return path.append("/").append(&url[5]).append(".dart");
 	}
 	else {
@@ -112,12 +115,15 @@ std::string DartLibrary::CreatePath(const char* base_dir)
 	const char* lib_path = &url[start_pos]; // skip directory name
 	const char* end = strrchr(lib_path, '/');
 	path.append(lib_path, end);
-	std::filesystem::create_directories(path);
+	if (!inArchive)
+		std::filesystem::create_directories(path);
 	path.append(end);
 	return path;
 }
 
-void DartLibrary::PrintCommentInfo(std::ostream& of)
+void DartLibrary::PrintCommentInfo(OutputSink& of)
 {
-	of << std::format("// lib: {}, url: {}\n", name.c_str(), url.c_str());
+	of.Print("// lib: {}, url: {}\n", name.c_str(), url.c_str());
+	if (!knownPackage.empty())
+		of.Print("// known package: {}\n", knownPackage);
 }
@@ -2,6 +2,7 @@
 #include <string>
 
 class DartClass;
+class OutputSink;
 
 class DartLibrary
 {
@@ -24,7 +25,7 @@ public:
 	DartClass* AddClass(const dart::Class& cls);
 
 	std::string CreatePath(const char* base_dir);
-	void PrintCommentInfo(std::ostream& of);
+	void PrintCommentInfo(OutputSink& of);
 
 	uint32_t id; // it is array index. store it in object to get the index quicker
 	bool isInternal;
@@ -33,6 +34,8 @@ public:
 	std::string url;
 	std::vector<DartClass*> classes;
 	DartClass* topClass;
+	// label of matched known package signature (empty if not matched)
+	std::string knownPackage;
 	// fields and functions are in topClass (named "::")
 	//std::vector<DartField*> fields;
 	//std::vector<DartFunction*> functions;
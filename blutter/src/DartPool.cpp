@@ -0,0 +1,229 @@
+#include "pch.h"
+#include "DartPool.h"
+#include "DartApp.h"
+#include "VarValue.h"
+#include <iostream>
+
+DartPool::DartPool(DartApp& app)
+{
+	const auto& pool = app.GetObjectPool();
+	const intptr_t num = pool.Length();
+	entries.resize(num);
+
+	auto& obj = dart::Object::Handle();
+	for (intptr_t i = 0; i < num; i++) {
+		auto& entry = entries[i];
+		// see how the EntryType is handled from vm/object_service.cc - ObjectPool::PrintJSONImpl()
+		const auto objType = pool.TypeAt(i);
+		if (objType == dart::ObjectPool::EntryType::kTaggedObject) {
+			entry.ptr = pool.ObjectAt(i);
+			// Smi is special case. Have to handle first
+			if (!entry.ptr.IsHeapObject()) {
+				entry.kind = DartPoolEntry::Smi;
+				entry.cid = dart::kSmiCid;
+				entry.intVal = dart::RawSmiValue(dart::Smi::RawCast(entry.ptr));
+				continue;
+			}
+			obj = entry.ptr;
+			entry.cid = (int32_t)obj.GetClassId();
+			decodeObject(app, entry, obj, i);
+		}
+		else if (objType == dart::ObjectPool::EntryType::kImmediate) {
+			entry.kind = DartPoolEntry::Immediate;
+			entry.rawVal = pool.RawValueAt(i);
+		}
+		else if (objType == dart::ObjectPool::EntryType::kNativeFunction) {
+			entry.kind = DartPoolEntry::NativeFunction;
+			entry.rawVal = pool.RawValueAt(i);
+		}
+		else {
+			throw std::runtime_error(std::format("unknown pool object type: {}", (int)objType).c_str());
+		}
+	}
+
+	// many functions load same pool object. the analyzer references these values instead of creating new ones
+	for (auto& entry : entries) {
+		entry.value = newValue(entry);
+		if (entry.value)
+			entry.value->shared = true;
+	}
+}
+
+DartPool::~DartPool()
+{
+	for (auto& entry : entries)
+		delete entry.value;
+}
+
+void DartPool::decodeObject(DartApp& app, DartPoolEntry& entry, dart::Object& obj, intptr_t idx)
+{
+	if (obj.IsNull()) {
+		entry.kind = DartPoolEntry::Null;
+		return;
+	}
+
+	if (obj.IsString()) {
+		entry.kind = DartPoolEntry::String;
+		entry.text = dart::String::Cast(obj).ToCString();
+		return;
+	}
+
+	// use TypedData or TypedDataBase ?
+	if (obj.IsTypedData()) {
+		entry.kind = DartPoolEntry::Expression;
+		entry.text = obj.ToCString();
+		return;
+	}
+
+	switch (entry.cid) {
+	case dart::kMintCid:
+		entry.kind = DartPoolEntry::Mint;
+		entry.intVal = dart::Mint::Cast(obj).AsInt64Value();
+		return;
+	case dart::kDoubleCid:
+		entry.kind = DartPoolEntry::Double;
+		entry.dblVal = dart::Double::Cast(obj).value();
+		return;
+	case dart::kBoolCid:
+		entry.kind = DartPoolEntry::Bool;
+		entry.boolVal = dart::Bool::Cast(obj).value();
+		return;
+	case dart::kCodeCid: {
+		const auto& code = dart::Code::Cast(obj);
+		entry.kind = DartPoolEntry::Code;
+		entry.fn = app.GetFunction(code.EntryPoint() - app.base());
+		ASSERT(entry.fn);
+		return;
+	}
+	case dart::kFieldCid: {
+		const auto& field = dart::Field::Cast(obj);
+		auto dartCls = app.GetClass(field.Owner().untag()->id());
+		entry.kind = DartPoolEntry::Field;
+		entry.field = dartCls->FindField(field.TargetOffset());
+		ASSERT(entry.field);
+		return;
+	}
+	case dart::kImmutableArrayCid:
+		entry.kind = DartPoolEntry::Array;
+		return;
+	// should function and closure be their var types?
+	case dart::kFunctionCid:
+	case dart::kClosureCid:
+	case dart::kConstMapCid:
+	case dart::kConstSetCid:
+#ifdef HAS_RECORD_TYPE
+	// temporary expression for Record object (need full object for analysis)
+	case dart::kRecordCid:
+#endif
+		entry.kind = DartPoolEntry::Expression;
+		entry.text = obj.ToCString();
+		return;
+	case dart::kTypeParametersCid:
+		// Type parameters object is not expected in Object Pool. leave it as Unknown
+		return;
+	case dart::kTypeCid:
+		entry.kind = DartPoolEntry::Type;
+		entry.type = app.TypeDb()->FindOrAdd(dart::Type::Cast(obj).ptr());
+		return;
+#ifdef HAS_RECORD_TYPE
+	case dart::kRecordTypeCid:
+		entry.kind = DartPoolEntry::RecordType;
+		entry.type = app.TypeDb()->FindOrAdd(dart::RecordType::Cast(obj).ptr());
+		return;
+#endif
+	case dart::kTypeParameterCid:
+		entry.kind = DartPoolEntry::TypeParameter;
+		entry.type = app.TypeDb()->FindOrAdd(dart::TypeParameter::Cast(obj).ptr());
+		return;
+	case dart::kFunctionTypeCid:
+		entry.kind = DartPoolEntry::FunctionType;
+		entry.type = app.TypeDb()->FindOrAdd(dart::FunctionType::Cast(obj).ptr());
+		return;
+	case dart::kTypeArgumentsCid:
+		entry.kind = DartPoolEntry::TypeArguments;
+		entry.typeArgs = app.TypeDb()->FindOrAdd(dart::TypeArguments::Cast(obj).ptr());
+		return;
+	case dart::kSentinelCid:
+		entry.kind = DartPoolEntry::Sentinel;
+		return;
+	case dart::kUnlinkedCallCid: {
+		// the target stub address is in next entry
+		const auto& pool = app.GetObjectPool();
+		ASSERT(pool.TypeAt(idx + 1) == dart::ObjectPool::EntryType::kImmediate);
+		const auto imm = pool.RawValueAt(idx + 1);
+		entry.kind = DartPoolEntry::UnlinkedCall;
+		entry.fn = app.GetFunction(imm - app.base());
+		ASSERT(entry.fn);
+		return;
+	}
+	case dart::kSubtypeTestCacheCid:
+		entry.kind = DartPoolEntry::SubtypeTestCache;
+		return;
+	case dart::kLibraryPrefixCid:
+		// TODO: handle LibraryPrefix object
+	case dart::kInstanceCid:
+		entry.kind = DartPoolEntry::Instance;
+		entry.cls = app.GetClass(dart::kInstanceCid);
+		return;
+	}
+
+	if (obj.IsInstance()) {
+		auto dartCls = app.GetClass(entry.cid);
+		if (dartCls->Id() < dart::kNumPredefinedCids) {
+			std::cerr << std::format("Unhandle predefined class {} ({})\n", dartCls->Name(), dartCls->Id());
+		}
+		entry.kind = DartPoolEntry::Instance;
+		entry.cls = dartCls;
+	}
+}
+
+VarValue* DartPool::newValue(const DartPoolEntry& entry)
+{
+	switch (entry.kind) {
+	case DartPoolEntry::Smi:
+		return new VarInteger(entry.intVal, dart::kSmiCid);
+	case DartPoolEntry::Mint:
+		return new VarInteger(entry.intVal, dart::kMintCid);
+	case DartPoolEntry::Double:
+		return new VarDouble(entry.dblVal);
+	case DartPoolEntry::Bool:
+		return new VarBoolean(entry.boolVal);
+	case DartPoolEntry::Null:
+		return new VarNull();
+	case DartPoolEntry::String:
+		return new VarString(entry.text);
+	case DartPoolEntry::Expression:
+		return new VarExpression(entry.text, entry.cid);
+	case DartPoolEntry::Code:
+		return new VarFunctionCode(*entry.fn);
+	case DartPoolEntry::Field:
+		return new VarField(*entry.field);
+	case DartPoolEntry::Array:
+		return new VarArray(dart::Array::RawCast(entry.ptr));
+	case DartPoolEntry::Type:
+		return new VarType(*entry.type->AsType());
+#ifdef HAS_RECORD_TYPE
+	case DartPoolEntry::RecordType:
+		return new VarRecordType(*entry.type->AsRecordType());
+#endif
+	case DartPoolEntry::TypeParameter:
+		return new VarTypeParameter(*entry.type->AsTypeParameter());
+	case DartPoolEntry::FunctionType:
+		return new VarFunctionType(*entry.type->AsFunctionType());
+	case DartPoolEntry::TypeArguments:
+		return new VarTypeArgument(*entry.typeArgs);
+	case DartPoolEntry::Sentinel:
+		return new VarSentinel();
+	case DartPoolEntry::UnlinkedCall:
+		return new VarUnlinkedCall(*entry.fn->AsStub());
+	case DartPoolEntry::SubtypeTestCache:
+		return new VarSubtypeTestCache();
+	case DartPoolEntry::Instance:
+		return new VarInstance(entry.cls);
+	case DartPoolEntry::Immediate:
+		// an immediate might be loaded into a decimal register. the analyzer decides it
+		return new VarInteger(entry.rawVal, VarValue::NativeInt);
+	default:
+		return nullptr;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "DartTypes.h"
+#include <vector>
+
+class DartApp;
+class DartFnBase;
+class DartField;
+struct VarValue;
+
+// decoded entry of Dart ObjectPool
+struct DartPoolEntry {
+	enum Kind : uint8_t {
+		Unknown = 0, // unhandled object (cannot be used in analysis)
+		Smi,
+		Mint,
+		Double,
+		Bool,
+		Null,
+		String,
+		Expression, // object that is kept as text from Dart VM (TypedData, Function, Closure, ConstMap, ...)
+		Code,
+		Field,
+		Array,
+		Type,
+		RecordType,
+		TypeParameter,
+		FunctionType,
+		TypeArguments,
+		Sentinel,
+		UnlinkedCall,
+		SubtypeTestCache,
+		Instance,
+		Immediate,
+		NativeFunction,
+	};
+
+	Kind kind{ Unknown };
+	int32_t cid{ dart::kIllegalCid };
+	union {
+		int64_t intVal;
+		double dblVal;
+		bool boolVal;
+		uint64_t rawVal{ 0 };
+	};
+	union {
+		DartFnBase* fn; // Code and UnlinkedCall (stub)
+		DartField* field;
+		DartClass* cls; // Instance
+		DartAbstractType* type;
+		const DartTypeArguments* typeArgs;
+		void* link{ nullptr };
+	};
+	dart::ObjectPtr ptr{ dart::Object::null() };
+	// string value or Dart VM text of Expression
+	std::string text;
+	// shared value for code analysis (owned by DartPool). null if an entry cannot be used as a value
+	VarValue* value{ nullptr };
+	// rendered description (without "[pp+offset]" prefix). they are filled by DartDumper
+	std::string desc;
+	std::string descFull;
+};
+
+// immutable mirror of Dart ObjectPool. all entries are decoded once after loading, so lookup is just an array read
+//   and it is safe to be read from multiple threads
+class DartPool
+{
+public:
+	explicit DartPool(DartApp& app);
+	DartPool() = delete;
+	DartPool(const DartPool&) = delete;
+	DartPool& operator=(const DartPool&) = delete;
+	~DartPool();
+
+	// offset is the one used in the code (not subtracted by kHeapObjectTag)
+	const DartPoolEntry& At(intptr_t offset) const { return entries.at(dart::ObjectPool::IndexFromOffset(offset)); }
+	const DartPoolEntry& EntryAt(intptr_t idx) const { return entries.at(idx); }
+	intptr_t Length() const { return (intptr_t)entries.size(); }
+	bool HasDescriptions() const { return hasDescriptions; }
+
+private:
+	void decodeObject(DartApp& app, DartPoolEntry& entry, dart::Object& obj, intptr_t idx);
+	static VarValue* newValue(const DartPoolEntry& entry);
+
+	std::vector<DartPoolEntry> entries;
+	bool hasDescriptions{ false };
+
+	friend class DartDumper;
+};
@@ -25,14 +25,14 @@ public:
 	};
 
 	DartStub(const dart::CodePtr ptr, Kind kind, uint64_t addr, int64_t size, std::string name) :
-		DartFnBase(addr, size, std::move(name)), ptr(ptr), kind(kind) {}
+		DartFnBase(addr, size, std::move(name)), ptr(ptr), kind(kind), fullName(this->name + "Stub") {}
 	DartStub() = delete;
 	DartStub(const DartStub&) = default;
 	DartStub(DartStub&&) = delete;
 	DartStub& operator=(const DartStub&) = delete;
 	virtual ~DartStub() {}
 
-	virtual std::string FullName() const { return name + "Stub"; }
+	virtual const std::string& FullName() const { return fullName; }
 	virtual bool IsStub() const { return true; }
 
 	// some stub might contain multiple of duplicated stubs
@@ -46,6 +46,9 @@ public:
 
 	const dart::CodePtr ptr;
 	const Kind kind;
+
+protected:
+	std::string fullName;
 };
 
 // only for non-predefined class
@@ -54,14 +57,13 @@ public:
 class DartAllocateStub : public DartStub {
 public:
 	DartAllocateStub(const dart::CodePtr ptr, uint64_t addr, int64_t size, uint32_t cid, std::string name) :
-		DartStub(ptr, AllocateUserObjectStub, addr, size, std::move(name)), cid(cid) {}
+		DartStub(ptr, AllocateUserObjectStub, addr, size, std::move(name)), cid(cid) { fullName = "Allocate" + this->name + "Stub"; }
 	DartAllocateStub() = delete;
 	DartAllocateStub(const DartAllocateStub&) = delete;
 	DartAllocateStub(DartAllocateStub&&) = delete;
 	DartAllocateStub& operator=(const DartAllocateStub&) = delete;
 
 	//virtual std::string Name() const { return "Allocate" + name + "Stub"; }
-	virtual std::string FullName() const { return "Allocate" + name + "Stub"; }
 	virtual uint32_t ReturnType() const { return cid; }
 
 private:
@@ -72,14 +74,13 @@ private:
 class DartTypeStub : public DartStub {
 public:
 	DartTypeStub(const dart::CodePtr ptr, const uint64_t addr, int64_t size, const DartAbstractType& abType, std::string name) :
-		DartStub(ptr, TypeCheckStub, addr, size, std::move(name)), abType(abType) {}
+		DartStub(ptr, TypeCheckStub, addr, size, std::move(name)), abType(abType) { fullName = "IsType_" + this->name + "_Stub"; }
 	DartTypeStub() = delete;
 	DartTypeStub(const DartTypeStub&) = delete;
 	DartTypeStub(DartTypeStub&&) = delete;
 	DartTypeStub& operator=(const DartTypeStub&) = delete;
 
 	//virtual std::string Name() const { return "IsType_" + name + "_Stub"; }
-	virtual std::string FullName() const { return "IsType_" + name + "_Stub"; }
 
 	// With the Record type in Dart 3.0, Test stub can be Type or RecordType
 	// So, we have to use AbstractType
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "DartThreadInfo.h"
+#include <mutex>
 
 static std::unordered_map<intptr_t, std::string> threadOffsetNames;
 static std::unordered_map<intptr_t, LeafFunctionInfo> leafFunctionMap;
@@ -75,17 +76,24 @@ static void initThreadOffsetNames()
 #undef DEFINE_LEFT_FN_INFO
 }
 
+// the names are only read after initialization, so they can be used from many threads
+static void ensureThreadOffsetNames()
+{
+	static std::once_flag initFlag;
+	std::call_once(initFlag, initThreadOffsetNames);
+}
+
 const std::string& GetThreadOffsetName(intptr_t offset)
 {
-	if (threadOffsetNames.empty())
-		initThreadOffsetNames();
-	return threadOffsetNames[offset];
+	static const std::string unknownName;
+	ensureThreadOffsetNames();
+	auto it = threadOffsetNames.find(offset);
+	return it == threadOffsetNames.end() ? unknownName : it->second;
 }
 
 intptr_t GetThreadMaxOffset()
 {
-	if (threadOffsetNames.empty())
-		initThreadOffsetNames();
+	ensureThreadOffsetNames();
 	using pair_type = decltype(threadOffsetNames)::value_type;
 	auto it = std::max_element(threadOffsetNames.begin(), threadOffsetNames.end(), [](const pair_type& o1, const pair_type& o2)
 		{
@@ -96,15 +104,13 @@ intptr_t GetThreadMaxOffset()
 
 const std::unordered_map<intptr_t, std::string>& GetThreadOffsetsMap()
 {
-	if (threadOffsetNames.empty())
-		initThreadOffsetNames();
+	ensureThreadOffsetNames();
 	return threadOffsetNames;
 }
 
 const LeafFunctionInfo* GetThreadLeafFunction(intptr_t offset)
 {
-	if (threadOffsetNames.empty())
-		initThreadOffsetNames();
+	ensureThreadOffsetNames();
 	auto it = leafFunctionMap.find(offset);
 	return it == leafFunctionMap.end() ? nullptr : &it->second;
 }
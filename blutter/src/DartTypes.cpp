@@ -1,160 +1,178 @@
 #include "pch.h"
 #include "DartTypes.h"
 #include "DartClass.h"
-#include <numeric>
-#include <sstream>
+#include "Util.h"
 
 const DartTypeArguments DartTypeArguments::Null;
 
 std::string DartTypeArguments::SubvectorName(int from_index, int len) const
+{
+	fmt::memory_buffer out;
+	AppendSubvectorName(out, from_index, len);
+	return fmt::to_string(out);
+}
+
+void DartTypeArguments::AppendSubvectorName(fmt::memory_buffer& out, int from_index, int len) const
 {
 	ASSERT(len > 0);
-	std::string txt;
-	txt.reserve(len * 32);
-	txt += "<";
+	out.push_back('<');
 	for (auto i = 0; i < len; i++) {
 		if (i > 0) {
-			txt += ", ";
+			Util::Append(out, ", ");
 		}
 		const size_t pos = from_index + i;
 		if (pos < args.size()) {
-			txt += args[pos]->ToString();
+			args[pos]->AppendTo(out);
 		}
 		else {
-			txt += "dynamic";
+			Util::Append(out, "dynamic");
 		}
 	}
-	txt += ">";
-	return txt;
+	out.push_back('>');
 }
 
-std::string DartType::ToString() const
+void DartAbstractType::CacheName()
 {
-	return ToString(true);
+	cachedName.clear();
+	fmt::memory_buffer out;
+	appendName(out);
+	cachedName = fmt::to_string(out);
+}
+
+void DartTypeArguments::CacheName()
+{
+	cachedName.clear();
+	if (!args.empty())
+		cachedName = SubvectorName(0, (int)args.size());
 }
 
 std::string DartType::ToString(bool showTypeArgs) const
 {
-	std::string txt = cls.Name();
+	fmt::memory_buffer out;
+	AppendTo(out, showTypeArgs);
+	return fmt::to_string(out);
+}
+
+void DartType::AppendTo(fmt::memory_buffer& out, bool showTypeArgs) const
+{
 	if (showTypeArgs) {
-		txt += args->ToString();
+		AppendTo(out);
+		return;
+	}
+	Util::Append(out, cls.Name());
+	if (IsNullable() && cls.Id() != dart::kDynamicCid) {
+		out.push_back('?');
 	}
+}
+
+void DartType::appendName(fmt::memory_buffer& out) const
+{
+	Util::Append(out, cls.Name());
+	args->AppendTo(out);
 	if (IsNullable() && cls.Id() != dart::kDynamicCid) {
-		txt += "?";
+		out.push_back('?');
 	}
-	return txt;
 }
 
 #ifdef HAS_RECORD_TYPE
-std::string DartRecordType::ToString() const
+void DartRecordType::appendName(fmt::memory_buffer& out) const
 {
-	std::string txt = "(";
+	out.push_back('(');
 	const intptr_t num_positional_fields = fieldTypes.size() - fieldNames.size();
 	for (auto i = 0; i < fieldTypes.size(); i++) {
 		if (i != 0) {
-			txt += ", ";
+			Util::Append(out, ", ");
 		}
 		if (i == num_positional_fields) {
-			txt += '{';
+			out.push_back('{');
 		}
-		txt += fieldTypes[i]->ToString();
+		fieldTypes[i]->AppendTo(out);
 		if (i >= num_positional_fields) {
-			txt += ' ';
-			txt += fieldNames[i - num_positional_fields];
+			out.push_back(' ');
+			Util::Append(out, fieldNames[i - num_positional_fields]);
 		}
 	}
 	if (num_positional_fields < fieldTypes.size()) {
-		txt += '}';
+		out.push_back('}');
 	}
-	txt += ')';
+	out.push_back(')');
 	if (IsNullable())
-		txt += '?';
-	return txt;
+		out.push_back('?');
 }
 #endif
 
 #ifdef HAS_TYPE_REF
-std::string DartTypeRef::ToString() const
+void DartTypeRef::appendName(fmt::memory_buffer& out) const
 {
-	return type.ToString(false);
+	type.AppendTo(out, false);
 }
 #endif
 
-std::string DartTypeParameter::ToString() const
+void DartTypeParameter::appendName(fmt::memory_buffer& out) const
 {
 	// CanonicalName might not start from 0
-	std::string txt;
 	if (base != 0)
-		txt += (isClassTypeParam ? "C" : "F") + std::to_string(base);
-	txt += (isClassTypeParam ? "X" : "Y") + std::to_string(index - base);
+		fmt::format_to(std::back_inserter(out), "{}{}", isClassTypeParam ? 'C' : 'F', base);
+	fmt::format_to(std::back_inserter(out), "{}{}", isClassTypeParam ? 'X' : 'Y', index - base);
 	if (IsNullable()) {
-		txt += "?";
+		out.push_back('?');
 	}
 	if (bound->IsType()) {
 		auto& cls = bound->AsType()->Class();
 		if (cls.Id() != dart::kInstanceCid) {
+			Util::Append(out, " bound ");
 #ifdef HAS_TYPE_REF
-			txt += " bound " + bound->ToString();
+			bound->AppendTo(out);
 #else
-			txt += " bound " + bound->AsType()->ToString(false);
+			bound->AsType()->AppendTo(out, false);
 #endif
 		}
 	}
-	return txt;
 }
 
-std::string DartFunctionType::ToString() const
+void DartFunctionType::appendName(fmt::memory_buffer& out) const
 {
-	std::string txt;
 	if (IsNullable()) {
-		txt += "(";
+		out.push_back('(');
 	}
 
 	if (!typeParams.empty()) {
-		txt += "<";
-		txt += std::accumulate(typeParams.begin() + 1, typeParams.end(), typeParams.front()->ToString(),
-			[](std::string x, const DartTypeParameter* y) {
-				return x + ", " + y->ToString();
-			}
-		);
-		txt += ">";
-	}
-
-	txt += "("; // open for function arguments
-	if (!params.empty()) {
-		auto first = params[0].type->ToString();
-		if (hasImplicitParam)
-			first += " this";
-		txt += std::accumulate(params.begin() + 1, params.end(), first,
-			[](std::string x, const Parameter& y) {
-				return x + ", " + y.type->ToString();
-			}
-		);
+		out.push_back('<');
+		for (size_t i = 0; i < typeParams.size(); i++) {
+			if (i != 0)
+				Util::Append(out, ", ");
+			typeParams[i]->AppendTo(out);
+		}
+		out.push_back('>');
+	}
+
+	out.push_back('('); // open for function arguments
+	for (size_t i = 0; i < params.size(); i++) {
+		if (i != 0)
+			Util::Append(out, ", ");
+		params[i].type->AppendTo(out);
+		if (i == 0 && hasImplicitParam)
+			Util::Append(out, " this");
 	}
 	if (!optionalParams.empty()) {
 		if (!params.empty()) {
-			txt += ", ";
-		}
-		if (hasNamedParam) {
-			txt += std::accumulate(optionalParams.begin() + 1, optionalParams.end(), optionalParams[0].type->ToString() + " " + optionalParams[0].name,
-				[](std::string x, const Parameter& y) {
-					return x + ", " + y.type->ToString() + " " + y.name;
-				}
-			);
+			Util::Append(out, ", ");
 		}
-		else {
-			txt += std::accumulate(optionalParams.begin() + 1, optionalParams.end(), optionalParams[0].type->ToString(),
-				[](std::string x, const Parameter& y) {
-					return x + ", " + y.type->ToString();
-				}
-			);
+		for (size_t i = 0; i < optionalParams.size(); i++) {
+			if (i != 0)
+				Util::Append(out, ", ");
+			optionalParams[i].type->AppendTo(out);
+			if (hasNamedParam) {
+				out.push_back(' ');
+				Util::Append(out, optionalParams[i].name);
+			}
 		}
 	}
-	txt += ") => " + resultType->ToString(); // close for function arguments and return type
+	Util::Append(out, ") => "); // close for function arguments and return type
+	resultType->AppendTo(out);
 	if (IsNullable()) {
-		txt += ")?";
+		Util::Append(out, ")?");
 	}
-	return txt;
 }
 
 DartType* DartTypeDb::FindOrAdd(dart::TypePtr typePtr)
@@ -395,3 +413,17 @@ DartType* DartTypeDb::Get(uint32_t cid)
 	ASSERT(dartCls->NumTypeParameters() == 0);
 	return dartCls->DeclarationType();
 }
+
+void DartTypeDb::CacheNames()
+{
+	for (auto& [ptr, typeArgs] : typeArgsMap) {
+		typeArgs->CacheName();
+	}
+	for (auto& [ptr, type] : typesMap) {
+		type->CacheName();
+	}
+	for (auto& types : typesByCid) {
+		for (auto type : types)
+			type->CacheName();
+	}
+}
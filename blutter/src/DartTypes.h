@@ -1,4 +1,5 @@
 #pragma once
+#include "Util.h"
 
 // forward declaration
 class DartClass;
@@ -34,7 +35,22 @@ public:
 
 	bool IsNullable() const { return nullable; }
 
-	virtual std::string ToString() const = 0;
+	std::string ToString() const {
+		if (!cachedName.empty())
+			return cachedName;
+		fmt::memory_buffer out;
+		appendName(out);
+		return fmt::to_string(out);
+	}
+	// render type name at the end of buffer without temporary string
+	void AppendTo(fmt::memory_buffer& out) const {
+		if (cachedName.empty())
+			appendName(out);
+		else
+			Util::Append(out, cachedName);
+	}
+	// render the name once. later rendering is just a copy. the type must be complete (see DartTypeDb::CacheNames())
+	void CacheName();
 
 	bool IsType() const { return kind == Kind::Type; }
 	bool IsTypeParameter() const { return kind == Kind::TypeParam; }
@@ -65,8 +81,11 @@ public:
 	}
 
 protected:
+	virtual void appendName(fmt::memory_buffer& out) const = 0;
+
 	Kind kind;
 	bool nullable;
+	std::string cachedName;
 };
 
 class DartTypeArguments {
@@ -75,13 +94,26 @@ public:
 	explicit DartTypeArguments() {}
 
 	std::string SubvectorName(int from_index, int len) const;
-	std::string ToString() const { return args.empty() ? std::string() : SubvectorName(0, (int)args.size()); }
+	void AppendSubvectorName(fmt::memory_buffer& out, int from_index, int len) const;
+	std::string ToString() const {
+		if (!cachedName.empty())
+			return cachedName;
+		return args.empty() ? std::string() : SubvectorName(0, (int)args.size());
+	}
+	void AppendTo(fmt::memory_buffer& out) const {
+		if (!cachedName.empty())
+			Util::Append(out, cachedName);
+		else if (!args.empty())
+			AppendSubvectorName(out, 0, (int)args.size());
+	}
+	void CacheName();
 	size_t Length() const { return args.size(); }
 
 	static const DartTypeArguments Null;
 
 protected:
 	std::vector<DartAbstractType*> args;
+	std::string cachedName;
 
 	friend class DartTypeDb;
 };
@@ -93,10 +125,13 @@ public:
 	const DartTypeArguments& Arguments() const { return *args; }
 	const DartClass& Class() const { return cls; }
 
-	virtual std::string ToString() const;
+	using DartAbstractType::ToString;
+	using DartAbstractType::AppendTo;
 	std::string ToString(bool showTypeArgs) const;
+	void AppendTo(fmt::memory_buffer& out, bool showTypeArgs) const;
 
 protected:
+	virtual void appendName(fmt::memory_buffer& out) const;
 	explicit DartType(bool nullable, DartClass& cls, const DartTypeArguments* args) : DartAbstractType(Kind::Type, nullable), cls(cls), args(args) {}
 	// incomplete initialization. we need it to prevent infinite loop when creating a new type
 	//explicit DartType(bool nullable, DartClass& cls) : DartAbstractType(Kind::Type, nullable), cls(cls), args(nullptr) {}
@@ -114,9 +149,10 @@ class DartRecordType : public DartAbstractType
 public:
 	DartRecordType() = delete;
 
-	virtual std::string ToString() const;
 
 protected:
+	virtual void appendName(fmt::memory_buffer& out) const;
+
 	// incomplete initialization. we need it to prevent infinite loop when creating a new type
 	explicit DartRecordType(bool nullable, std::vector<std::string> fieldNames) : DartAbstractType(Kind::RecordType, nullable), fieldNames(std::move(fieldNames)) {}
 
@@ -133,9 +169,10 @@ class DartTypeRef : public DartAbstractType
 public:
 	DartTypeRef() = delete;
 
-	virtual std::string ToString() const;
 
 protected:
+	virtual void appendName(fmt::memory_buffer& out) const;
+
 	// incomplete initialization. we need it to prevent infinite loop when creating a new type
 	explicit DartTypeRef(DartType& type) : DartAbstractType(Kind::TypeRef, false), type(type) {}
 
@@ -149,9 +186,10 @@ class DartTypeParameter : public DartAbstractType {
 public:
 	DartTypeParameter() = delete;
 
-	virtual std::string ToString() const;
 
 protected:
+	virtual void appendName(fmt::memory_buffer& out) const;
+
 	// incomplete initialization. we need it to prevent infinite loop when creating a new type
 	explicit DartTypeParameter(bool nullable, uint16_t base, uint16_t index, bool isClassTypeParam)
 		: DartAbstractType(Kind::TypeParam, nullable), base(base), index(index), isClassTypeParam(isClassTypeParam), bound(nullptr) {}
@@ -169,8 +207,6 @@ class DartFunctionType : public DartAbstractType {
 public:
 	DartFunctionType() = delete;
 
-	virtual std::string ToString() const;
-
 	// Note: positional parameter names are removed in AOT
 	struct Parameter {
 		Parameter(std::string name, DartAbstractType* type) : name(std::move(name)), type(type) {}
@@ -186,6 +222,8 @@ public:
 	};
 
 protected:
+	virtual void appendName(fmt::memory_buffer& out) const;
+
 	// incomplete initialization. we need it to prevent infinite loop when creating a new type
 	explicit DartFunctionType(bool nullable, bool hasImplicitParam, bool hasNamedParam, std::vector<DartTypeParameter*> typeParams)
 		: DartAbstractType(Kind::FunctionType, nullable), hasImplicitParam(hasImplicitParam), hasNamedParam(hasNamedParam), resultType(nullptr), typeParams(std::move(typeParams)) {}
@@ -224,6 +262,10 @@ public:
 	DartType* FindOrAdd(DartClass& dartCls, const dart::Instance& inst);
 	DartType* FindOrAdd(uint32_t cid, const DartTypeArguments* typeArgs);
 
+	// render names of all known types once. types are shown many times in output (parameters, fields, casts).
+	// types created after this call are rendered every time they are shown
+	void CacheNames();
+
 protected:
 	DartTypeDb(std::vector<DartClass*>& classes) : classes(classes) { typesByCid.resize(classes.size()); }
 
@@ -3,10 +3,44 @@
 
 AsmInstructions Disassembler::Disasm(const uint8_t* code, size_t code_size, uint64_t address, size_t max_count)
 {
-	cs_insn* insns = NULL;
-	size_t insn_cnt = 0;
+	if (detailMode != OnDemandDetail) {
+		cs_insn* insns = NULL;
+		size_t insn_cnt = 0;
+
+		insn_cnt = cs_disasm(cshandle, code, code_size, address, max_count, &insns);
+
+		numInsns += insn_cnt;
+		// capstone grows the instruction array and allocates one detail for each instruction
+		numAllocs += detailMode == FullDetail ? insn_cnt + 1 : 1;
+		return AsmInstructions(insns, insn_cnt);
+	}
 
-	insn_cnt = cs_disasm(cshandle, code, code_size, address, max_count, &insns);
+	// instruction size is fixed to 4 bytes. allocate all instructions at once instead of growing array in cs_disasm()
+	size_t max_insn = code_size / 4;
+	if (max_count != 0 && max_count < max_insn)
+		max_insn = max_count;
+	auto insns = (cs_insn*)malloc(max_insn * sizeof(cs_insn));
+	// no detail is written here. memory pages of details that are never accessed are not committed
+	auto details = (cs_detail*)malloc(max_insn * sizeof(cs_detail));
+	numAllocs += 2;
+
+	size_t insn_cnt = 0;
+	while (insn_cnt < max_insn) {
+		auto insn = &insns[insn_cnt];
+		insn->detail = nullptr;
+		if (!cs_disasm_iter(cshandle, &code, &code_size, &address, insn))
+			break;
+		if (insn->id == 0) {
+			// skipped data has no detail to decode
+			memset(&details[insn_cnt], 0, sizeof(cs_detail));
+			insn->detail = &details[insn_cnt];
+		}
+		else {
+			insn->detail = (cs_detail*)((uintptr_t)&details[insn_cnt] | CS_DETAIL_ON_DEMAND_TAG);
+		}
+		insn_cnt++;
+	}
 
-	return AsmInstructions(insns, insn_cnt);
+	numInsns += insn_cnt;
+	return AsmInstructions(insns, insn_cnt, details);
 }
\ No newline at end of file
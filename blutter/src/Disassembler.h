@@ -1,5 +1,6 @@
 #pragma once
 #include <capstone/capstone.h>
+#include <stdexcept>
 #include <utility>
 #ifdef TARGET_ARCH_ARM64
 #include "Disassembler_arm64.h"
@@ -11,14 +12,43 @@
 class AsmInstructions {
 	cs_insn* insns;
 	size_t count;
+	// storage for on-demand instruction details. nullptr if insns are allocated by capstone
+	cs_detail* details;
+	// a view does not own the instructions (part of whole code instructions)
+	bool isView;
 
-	AsmInstructions(cs_insn* insns, size_t count) : insns(insns), count(count) {}
+	AsmInstructions(cs_insn* insns, size_t count, cs_detail* details = nullptr, bool isView = false)
+		: insns(insns), count(count), details(details), isView(isView) {}
 public:
 	AsmInstructions() = delete;
 	AsmInstructions(const AsmInstructions&) = delete;
-	AsmInstructions(AsmInstructions&& rhs) noexcept : insns(std::exchange(rhs.insns, nullptr)), count(std::exchange(rhs.count, 0)) {}
+	AsmInstructions(AsmInstructions&& rhs) noexcept
+		: insns(std::exchange(rhs.insns, nullptr)), count(std::exchange(rhs.count, 0)), details(std::exchange(rhs.details, nullptr)), isView(rhs.isView) {}
 	AsmInstructions& operator=(const AsmInstructions&) = delete;
-	~AsmInstructions() { if (insns) cs_free(insns, count); }
+	~AsmInstructions() {
+		if (isView)
+			return;
+		if (details) {
+			free(insns);
+			free(details);
+		}
+		else if (insns)
+			cs_free(insns, count);
+	}
+
+	// instructions in [addr, addr+size) without copying. the instructions must be disassembled with skipping data
+	//   so every instruction is 4 bytes. stop at data like disassembling only the range.
+	//   throw if addr is not in the instructions (ASSERT is compiled out in release build)
+	AsmInstructions View(uint64_t addr, uint64_t size) {
+		if (count == 0 || addr < insns->address || (addr - insns->address) / 4 >= count)
+			throw std::runtime_error(std::format("address {:#x} is not in disassembled code", addr));
+		const auto idx = (addr - insns->address) / 4;
+		const auto max_cnt = std::min<size_t>(size / 4, count - idx);
+		size_t cnt = 0;
+		while (cnt < max_cnt && insns[idx + cnt].id != 0)
+			cnt++;
+		return AsmInstructions(insns + idx, cnt, nullptr, true);
+	}
 
 	cs_insn* Insns() { return insns; }
 	size_t Count() const { return count; }
@@ -82,16 +112,35 @@ public:
 class Disassembler
 {
 public:
-	Disassembler(bool hasDetail = true);
+	enum DetailMode {
+		NoDetail,
+		FullDetail,
+		// decode only mnemonic and operand text first. the detail of an instruction is decoded when it is accessed
+		OnDemandDetail,
+	};
+
+	Disassembler(DetailMode mode = FullDetail);
 	~Disassembler() { cs_close(&cshandle); }
 	Disassembler(const Disassembler&) = delete;
 	Disassembler(Disassembler&&) = delete;
 	Disassembler& operator=(const Disassembler&) = delete;
 
 	AsmInstructions Disasm(const uint8_t* code, size_t code_size, uint64_t address, size_t max_count = 0);
+	// decode data as a ".byte" instruction (id is 0) instead of stopping disassembling
+	void SetSkipData(bool skip) { cs_option(cshandle, CS_OPT_SKIPDATA, skip ? CS_OPT_ON : CS_OPT_OFF); }
 	const char* GetRegName(arm64_reg reg) { return cs_reg_name(cshandle, reg); }
 
+	// statistics of this disassembler (details decoded on demand are counted globally)
+	size_t NumInsns() const { return numInsns; }
+	size_t NumAllocs() const { return numAllocs; }
+	static size_t NumDetailDecoded();
+	// number of details decoded by native decoder instead of capstone
+	static size_t NumNativeDecoded();
+
 private:
 	csh cshandle;
+	DetailMode detailMode;
+	size_t numInsns{ 0 };
+	size_t numAllocs{ 0 };
 };
 
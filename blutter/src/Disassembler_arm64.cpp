@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "Disassembler.h"
+#include "A64Decoder.h"
+#include <atomic>
 
 namespace A64 {
 const char* Register::RegisterNames[] = {
@@ -23,11 +25,72 @@ const char* GetCsRegisterName(arm64_reg reg)
 	return cs_reg_name(g_cshandle, reg);
 }
 
-Disassembler::Disassembler(bool hasDetail)
+// capstone handle with detail for decoding instruction detail on demand. one handle per thread, closed at thread exit
+struct DetailCsHandle {
+	csh handle{ 0 };
+	~DetailCsHandle() {
+		if (handle != 0)
+			cs_close(&handle);
+	}
+};
+static thread_local DetailCsHandle detail_cshandle;
+static std::atomic<size_t> numDetailDecoded;
+static std::atomic<size_t> numNativeDecoded;
+
+void DecodeCsInsnDetail(cs_insn* insn)
+{
+	// the tag is removed only after the detail is decoded, so a failed decoding can be retried
+	auto detail = (cs_detail*)((uintptr_t)insn->detail & ~CS_DETAIL_ON_DEMAND_TAG);
+
+	// most of inspected instructions are simple. decode them without capstone
+	uint32_t insnCode;
+	memcpy(&insnCode, insn->bytes, 4);
+	if (A64::DecodeInsn(insnCode, insn->address, detail->arm64) == insn->id) {
+		memset(detail, 0, offsetof(cs_detail, arm64));
+		insn->detail = detail;
+		numDetailDecoded++;
+		numNativeDecoded++;
+		return;
+	}
+
+	auto& handle = detail_cshandle.handle;
+	if (handle == 0) {
+		if (cs_open(CS_ARCH_ARM64, CS_MODE_LITTLE_ENDIAN, &handle) != CS_ERR_OK)
+			throw std::runtime_error("Cannot open capstone engine");
+		cs_option(handle, CS_OPT_DETAIL, CS_OPT_ON);
+	}
+
+	// decode the same instruction again with detail. copy the bytes because capstone writes them back to insn.
+	//   capstone writes the detail through insn->detail
+	uint8_t bytes[sizeof(insn->bytes)];
+	memcpy(bytes, insn->bytes, insn->size);
+	const uint8_t* code = bytes;
+	size_t code_size = insn->size;
+	uint64_t address = insn->address;
+	const auto taggedDetail = insn->detail;
+	insn->detail = detail;
+	if (!cs_disasm_iter(handle, &code, &code_size, &address, insn)) {
+		insn->detail = taggedDetail;
+		throw std::runtime_error(std::format("Cannot decode instruction detail at {:#x}", insn->address));
+	}
+	numDetailDecoded++;
+}
+
+size_t Disassembler::NumDetailDecoded()
+{
+	return numDetailDecoded;
+}
+
+size_t Disassembler::NumNativeDecoded()
+{
+	return numNativeDecoded;
+}
+
+Disassembler::Disassembler(DetailMode mode) : detailMode(mode)
 {
 	if (cs_open(CS_ARCH_ARM64, CS_MODE_LITTLE_ENDIAN, &cshandle) != CS_ERR_OK)
 		throw std::runtime_error("Cannot open capstone engine");
 
-	if (hasDetail)
+	if (mode == FullDetail)
 		cs_option(cshandle, CS_OPT_DETAIL, CS_OPT_ON);
 }
@@ -94,6 +94,17 @@ constexpr arm64_reg CSREG_DART_TMP2 = ToCapstoneReg(dart::TMP2);
 
 const char* GetCsRegisterName(arm64_reg reg);
 
+// an instruction disassembled with on-demand detail has this tag in its detail pointer until the detail is decoded.
+// decoding writes to the instruction without locking. instructions that are read by many threads
+//   (e.g. --disasm-all array) must have their details decoded before the array is shared
+constexpr uintptr_t CS_DETAIL_ON_DEMAND_TAG = 1;
+void DecodeCsInsnDetail(cs_insn* insn);
+inline cs_arm64& GetCsInsnDetail(cs_insn* insn) {
+	if ((uintptr_t)insn->detail & CS_DETAIL_ON_DEMAND_TAG) [[unlikely]]
+		DecodeCsInsnDetail(insn);
+	return insn->detail->arm64;
+}
+
 inline constexpr uint32_t GetCsRegSize(arm64_reg reg){
 	if (reg >= ARM64_REG_Q0 && reg <= ARM64_REG_Q31)
 		return 16;
@@ -333,33 +344,34 @@ private:
 	cs_insn* insn;
 public:
 	class Operands {
-		cs_arm64_op* operands;
-		Operands(cs_arm64_op* operands) : operands(operands) {}
+		// the detail might not be decoded yet. resolve it when an operand is accessed
+		cs_insn* insn;
+		Operands(cs_insn* insn) : insn(insn) {}
 	public:
-		const cs_arm64_op& operator[](size_t idx) const { return operands[idx]; }
+		const cs_arm64_op& operator[](size_t idx) const { return GetCsInsnDetail(insn).operands[idx]; }
 		friend class AsmInstruction;
 	} ops;
 
-	AsmInstruction(cs_insn* insn) : insn((insn->id == ARM64_INS_NOP) ? ++insn : insn), ops(insn->detail->arm64.operands) {}
+	AsmInstruction(cs_insn* insn) : insn((insn->id == ARM64_INS_NOP) ? ++insn : insn), ops(insn) {}
 	AsmInstruction& operator=(const AsmInstruction&) = default;
 	// prefix increment
 	AsmInstruction& operator++() {
 		++insn;
 		if (insn->id == ARM64_INS_NOP)
 			++insn;
-		ops = insn->detail->arm64.operands;
+		ops = insn;
 		return *this;
 	}
 	AsmInstruction& operator--() {
 		--insn;
-		ops = insn->detail->arm64.operands;
+		ops = insn;
 		return *this;
 	}
 	AsmInstruction& operator+=(int cnt) {
 		insn += cnt;
 		if (insn->id == ARM64_INS_NOP)
 			++insn;
-		ops = insn->detail->arm64.operands;
+		ops = insn;
 		return *this;
 	}
 	AsmInstruction Next() { return AsmInstruction(insn + 1); }
@@ -415,9 +427,9 @@ public:
 	uint16_t size() const { return insn->size; }
 	uint64_t NextAddress() const { return insn->address + insn->size; }
 	unsigned int id() const { return insn->id; }
-	arm64_cc cc() const { return insn->detail->arm64.cc; }
-	bool writeback() const { return insn->detail->arm64.writeback; }
-	uint8_t op_count() const { return insn->detail->arm64.op_count; }
+	arm64_cc cc() const { return GetCsInsnDetail(insn).cc; }
+	bool writeback() const { return GetCsInsnDetail(insn).writeback; }
+	uint8_t op_count() const { return GetCsInsnDetail(insn).op_count; }
 
 	const char* mnemonic() const { return insn->mnemonic; }
 	const char* op_str() const { return insn->op_str; }
@@ -528,8 +540,8 @@ public:
 	uint16_t size() const { return insn->size; }
 	uint64_t NextAddress() const { return insn->address + insn->size; }
 	unsigned int id() const { return insn->id; }
-	arm64_cc cc() const { return insn->detail->arm64.cc; }
-	bool writeback() const { return insn->detail->arm64.writeback; }
-	cs_arm64_op& ops(int i) const { return insn->detail->arm64.operands[i]; }
-	uint8_t op_count() const { return insn->detail->arm64.op_count; }
+	arm64_cc cc() const { return GetCsInsnDetail(insn).cc; }
+	bool writeback() const { return GetCsInsnDetail(insn).writeback; }
+	cs_arm64_op& ops(int i) const { return GetCsInsnDetail(insn).operands[i]; }
+	uint8_t op_count() const { return GetCsInsnDetail(insn).op_count; }
 };
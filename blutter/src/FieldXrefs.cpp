@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "FieldXrefs.h"
+#include "DartApp.h"
+#include "CodeAnalyzer.h"
+#include <numeric>
+
+static constexpr char FIELDXREFS_MAGIC[8] = { 'B', 'L', 'T', 'R', 'F', 'X', 'R', 'F' };
+static constexpr uint32_t FIELDXREFS_VERSION = 2;
+
+struct FieldXrefsHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t numFields;
+	uint64_t numAccesses;
+	uint64_t namesSize;
+	uint64_t aliasesSize;
+};
+
+FieldXrefs::FieldXrefs(const std::filesystem::path& path) : file(path)
+{
+	const auto hdr = file.At<FieldXrefsHeader>(0);
+	if (memcmp(hdr->magic, FIELDXREFS_MAGIC, sizeof(FIELDXREFS_MAGIC)) != 0 || hdr->version != FIELDXREFS_VERSION)
+		throw std::runtime_error(std::format("{} is not a field xrefs file of this blutter version", path.string()));
+
+	numFields = hdr->numFields;
+	size_t offset = sizeof(FieldXrefsHeader);
+	accessOffsets = file.At<uint32_t>(offset, numFields + 1);
+	offset = MappedFile::AlignUp(offset + sizeof(uint32_t) * (numFields + 1));
+	accesses = file.At<Access>(offset, hdr->numAccesses);
+	offset += sizeof(Access) * hdr->numAccesses;
+	nameOffsets = file.At<uint32_t>(offset, numFields + 1);
+	offset += sizeof(uint32_t) * (numFields + 1);
+	aliasOffsets = file.At<uint32_t>(offset, numFields + 1);
+	offset += sizeof(uint32_t) * (numFields + 1);
+	byAlias = file.At<uint32_t>(offset, numFields);
+	offset = MappedFile::AlignUp(offset + sizeof(uint32_t) * numFields);
+	names = file.At<char>(offset, hdr->namesSize);
+	offset = MappedFile::AlignUp(offset + hdr->namesSize);
+	aliases = file.At<char>(offset, hdr->aliasesSize);
+}
+
+std::string_view FieldXrefs::Name(uint32_t idx) const
+{
+	return std::string_view(names + nameOffsets[idx], nameOffsets[idx + 1] - nameOffsets[idx]);
+}
+
+std::string_view FieldXrefs::Alias(uint32_t idx) const
+{
+	return std::string_view(aliases + aliasOffsets[idx], aliasOffsets[idx + 1] - aliasOffsets[idx]);
+}
+
+std::span<const FieldXrefs::Access> FieldXrefs::Accesses(uint32_t idx) const
+{
+	return std::span<const Access>(accesses + accessOffsets[idx], accessOffsets[idx + 1] - accessOffsets[idx]);
+}
+
+std::vector<uint32_t> FieldXrefs::FindFields(std::string_view name) const
+{
+	std::vector<uint32_t> found;
+	// binary search on sorted full names
+	uint32_t lo = 0, hi = numFields;
+	while (lo < hi) {
+		const auto mid = lo + (hi - lo) / 2;
+		if (Name(mid) < name)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (; lo < numFields && Name(lo) == name; lo++)
+		found.push_back(lo);
+	if (!found.empty())
+		return found;
+
+	// alias matches fields of same name classes in different libraries
+	auto itr = std::partition_point(byAlias, byAlias + numFields, [&](uint32_t i) { return Alias(i) < name; });
+	for (; itr != byAlias + numFields && Alias(*itr) == name; ++itr)
+		found.push_back(*itr);
+	return found;
+}
+
+#ifndef NO_CODE_ANALYSIS
+void FieldXrefs::Create(DartApp& app, const std::filesystem::path& path)
+{
+	// (full name, alias, field)
+	std::vector<std::tuple<std::string, std::string, DartField*>> fields;
+	for (auto lib : app.libs) {
+		for (auto cls : lib->classes) {
+			for (auto field : cls->Fields())
+				fields.emplace_back(field->FullName(), std::format("{}.{}", cls->Name(), field->Name()), field);
+		}
+	}
+	std::sort(fields.begin(), fields.end());
+	std::unordered_map<DartField*, uint32_t> fieldIdx;
+	for (uint32_t i = 0; i < fields.size(); i++)
+		fieldIdx[std::get<2>(fields[i])] = i;
+
+	// (field index, access)
+	std::vector<std::pair<uint32_t, Access>> rawAccesses;
+	for (auto lib : app.libs) {
+		if (lib->isInternal)
+			continue;
+		for (auto cls : lib->classes) {
+			for (auto dartFn : cls->Functions()) {
+				auto fnData = dartFn->GetAnalyzedData();
+				if (dartFn->Size() == 0 || fnData == nullptr)
+					continue;
+				for (const auto& access : fnData->fieldAccesses) {
+					auto itr = fieldIdx.find(access.field);
+					if (itr != fieldIdx.end())
+						rawAccesses.emplace_back(itr->second, Access{ access.addr, dartFn->Address(), access.isStore, access.field->IsStatic() });
+				}
+			}
+		}
+	}
+	std::sort(rawAccesses.begin(), rawAccesses.end(), [](const auto& a, const auto& b) {
+		return a.first != b.first ? a.first < b.first : a.second.addr < b.second.addr;
+	});
+
+	const auto num = (uint32_t)fields.size();
+	std::vector<uint32_t> accessOffsets(num + 1, 0);
+	std::vector<Access> accesses;
+	accesses.reserve(rawAccesses.size());
+	for (const auto& [idx, access] : rawAccesses) {
+		accessOffsets[idx + 1]++;
+		accesses.push_back(access);
+	}
+	std::vector<uint32_t> nameOffsets(num + 1, 0);
+	std::vector<uint32_t> aliasOffsets(num + 1, 0);
+	std::string names;
+	std::string aliases;
+	for (uint32_t i = 0; i < num; i++) {
+		accessOffsets[i + 1] += accessOffsets[i];
+		names += std::get<0>(fields[i]);
+		nameOffsets[i + 1] = (uint32_t)names.size();
+		aliases += std::get<1>(fields[i]);
+		aliasOffsets[i + 1] = (uint32_t)aliases.size();
+	}
+	auto alias = [&](uint32_t i) { return std::string_view(aliases).substr(aliasOffsets[i], aliasOffsets[i + 1] - aliasOffsets[i]); };
+	std::vector<uint32_t> byAlias(num);
+	std::iota(byAlias.begin(), byAlias.end(), 0);
+	std::stable_sort(byAlias.begin(), byAlias.end(), [&](uint32_t a, uint32_t b) { return alias(a) < alias(b); });
+
+	IndexFileWriter of(path);
+	FieldXrefsHeader hdr{};
+	memcpy(hdr.magic, FIELDXREFS_MAGIC, sizeof(FIELDXREFS_MAGIC));
+	hdr.version = FIELDXREFS_VERSION;
+	hdr.numFields = num;
+	hdr.numAccesses = accesses.size();
+	hdr.namesSize = names.size();
+	hdr.aliasesSize = aliases.size();
+	of.WriteVal(hdr);
+	of.WriteArray(accessOffsets);
+	of.Pad();
+	of.WriteArray(accesses);
+	of.WriteArray(nameOffsets);
+	of.WriteArray(aliasOffsets);
+	of.WriteArray(byAlias);
+	of.Pad();
+	of.Write(names.data(), names.size());
+	of.Pad();
+	of.Write(aliases.data(), aliases.size());
+	of.Commit();
+
+	std::cout << std::format("Field xrefs: {} accesses to {} fields\n", accesses.size(), num);
+}
+#endif // NO_CODE_ANALYSIS
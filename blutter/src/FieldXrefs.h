@@ -0,0 +1,57 @@
+#pragma once
+#include "MappedFile.h"
+#include <span>
+#include <string_view>
+#include <vector>
+
+class DartApp;
+
+// read and write sites of fields. one entry for each field. entries are sorted by full name ("[library url] Class::field")
+//   and "Class.field" is an alias that can match fields of many libraries. lookup by both names is binary search.
+// the index is saved as a file that can be queried later without loading the app.
+// file layout (every section is 8 bytes aligned):
+//   Header
+//   uint32_t accessOffsets[numFields + 1], Access accesses[numAccesses] (sorted by field then address)
+//   uint32_t nameOffsets[numFields + 1], uint32_t aliasOffsets[numFields + 1], uint32_t byAlias[numFields] (sorted by alias)
+//   char names[]
+//   char aliases[]
+class FieldXrefs
+{
+public:
+	struct Access {
+		uint64_t addr; // start address of IL
+		uint64_t fnAddr; // function that contains the access
+		uint32_t isStore;
+		uint32_t isStatic;
+	};
+
+	explicit FieldXrefs(const std::filesystem::path& path);
+	FieldXrefs() = delete;
+	FieldXrefs(const FieldXrefs&) = delete;
+	FieldXrefs& operator=(const FieldXrefs&) = delete;
+
+#ifndef NO_CODE_ANALYSIS
+	// create index file from field accesses of analyzed functions
+	static void Create(DartApp& app, const std::filesystem::path& path);
+#endif
+
+	uint32_t NumFields() const { return numFields; }
+	// full name
+	std::string_view Name(uint32_t idx) const;
+	// "Class.field"
+	std::string_view Alias(uint32_t idx) const;
+	std::span<const Access> Accesses(uint32_t idx) const;
+	// the field with the full name or all fields with the alias "Class.field" (from different libraries)
+	std::vector<uint32_t> FindFields(std::string_view name) const;
+
+private:
+	MappedFile file;
+	uint32_t numFields;
+	const uint32_t* accessOffsets;
+	const Access* accesses;
+	const uint32_t* nameOffsets;
+	const uint32_t* aliasOffsets;
+	const uint32_t* byAlias;
+	const char* names;
+	const char* aliases;
+};
@@ -1,8 +1,9 @@
 #include "pch.h"
 #include "FridaWriter.h"
-#include <fstream>
 #include <filesystem>
+#include <fstream>
 #include "Util.h"
+#include "OutputSink.h"
 
 #ifndef FRIDA_TEMPLATE_DIR
 #define FRIDA_TEMPLATE_DIR "scripts"
@@ -10,12 +11,17 @@
 
 void FridaWriter::Create(const char* filename)
 {
-	std::filesystem::copy_file(FRIDA_TEMPLATE_DIR "/frida.template.js", filename, std::filesystem::copy_options::overwrite_existing);
+	// template is copied through the sink, so the script can be written to output archive too
+	std::ifstream tmpl(FRIDA_TEMPLATE_DIR "/frida.template.js", std::ios::binary);
+	if (!tmpl)
+		throw std::runtime_error("cannot open " FRIDA_TEMPLATE_DIR "/frida.template.js");
+	const std::string tmplText{ std::istreambuf_iterator<char>(tmpl), std::istreambuf_iterator<char>() };
 
-	std::ofstream of(filename, std::ios_base::app);
+	OutputSink of(filename);
+	of << tmplText;
 
 	of << "const ClassIdTagPos = " << dart::UntaggedObject::kClassIdTagPos << ";\n";
-	of << std::format("const ClassIdTagMask = {:#x};\n", (1 << dart::UntaggedObject::kClassIdTagSize) - 1);
+	of.Print("const ClassIdTagMask = {:#x};\n", (1 << dart::UntaggedObject::kClassIdTagSize) - 1);
 
 	of << "const NumPredefinedCids = " << dart::kNumPredefinedCids << ";\n";
 	of << "const CidObject = " << dart::kInstanceCid << ";\n";
@@ -149,4 +155,5 @@ void FridaWriter::Create(const char* filename)
 		}
 	}
 	of << "];\n";
+	of.Close();
 }
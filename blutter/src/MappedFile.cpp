@@ -0,0 +1,98 @@
+#include "pch.h"
+#include "MappedFile.h"
+#include <stdexcept>
+#if defined(_WIN32) || defined(WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif // #if defined(_WIN32) || defined(WIN32)
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+	HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		throw std::runtime_error(std::format("cannot open {}", path.string()));
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(hFile, &fileSize);
+	size = (size_t)fileSize.QuadPart;
+	if (size > 0) {
+		hMapFile = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMapFile != NULL)
+			data = (const uint8_t*)MapViewOfFile(hMapFile, FILE_MAP_READ, 0, 0, 0);
+	}
+	CloseHandle(hFile);
+	if (size > 0 && data == nullptr)
+		throw std::runtime_error(std::format("cannot map {}", path.string()));
+}
+
+MappedFile::~MappedFile()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (hMapFile)
+		CloseHandle(hMapFile);
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error(std::format("cannot open {}", path.string()));
+
+	struct stat st;
+	fstat(fd, &st);
+	size = (size_t)st.st_size;
+	if (size > 0) {
+		void* mem = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+		if (mem != MAP_FAILED)
+			data = (const uint8_t*)mem;
+	}
+	close(fd);
+	if (size > 0 && data == nullptr)
+		throw std::runtime_error(std::format("cannot map {}", path.string()));
+}
+
+MappedFile::~MappedFile()
+{
+	if (data)
+		munmap((void*)data, size);
+}
+#endif
+
+IndexFileWriter::IndexFileWriter(const std::filesystem::path& path) : path(path), tmpPath(path)
+{
+	tmpPath += ".tmp";
+	of.open(tmpPath, std::ios::binary);
+	if (!of)
+		throw std::runtime_error(std::format("cannot create {}", tmpPath.string()));
+}
+
+IndexFileWriter::~IndexFileWriter()
+{
+	if (!committed) {
+		of.close();
+		std::error_code ec;
+		std::filesystem::remove(tmpPath, ec);
+	}
+}
+
+void IndexFileWriter::Pad()
+{
+	static const char zeros[8]{};
+	Write(zeros, MappedFile::AlignUp(pos) - pos);
+}
+
+void IndexFileWriter::Commit()
+{
+	of.close();
+	if (!of)
+		throw std::runtime_error(std::format("cannot write {}", tmpPath.string()));
+	std::filesystem::rename(tmpPath, path);
+	committed = true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+// read-only mapping of whole file. it is for reading blutter index files without parsing them
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::filesystem::path& path);
+	MappedFile() = delete;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	// sections of blutter index files start at 8 bytes aligned offset, so they can be read in place
+	static size_t AlignUp(size_t offset) { return (offset + 7) & ~(size_t)7; }
+
+	const uint8_t* Data() const { return data; }
+	size_t Size() const { return size; }
+
+	// pointer to object at offset. throw if it is out of file
+	template <typename T>
+	const T* At(size_t offset, size_t count = 1) const {
+		if (offset > size || count > (size - offset) / sizeof(T))
+			throw std::runtime_error("truncated file");
+		return reinterpret_cast<const T*>(data + offset);
+	}
+
+private:
+	const uint8_t* data{ nullptr };
+	size_t size{ 0 };
+#ifdef _WIN32
+	void* hMapFile{ nullptr };
+#endif
+};
+
+// writer of blutter index files. data is written to "<path>.tmp" and renamed to path by Commit(),
+//   so a failed run never leaves a partially written file for MappedFile readers
+class IndexFileWriter
+{
+public:
+	explicit IndexFileWriter(const std::filesystem::path& path);
+	IndexFileWriter() = delete;
+	IndexFileWriter(const IndexFileWriter&) = delete;
+	IndexFileWriter& operator=(const IndexFileWriter&) = delete;
+	// the temporary file is removed if it is not committed
+	~IndexFileWriter();
+
+	void Write(const void* data, size_t size) {
+		of.write((const char*)data, size);
+		pos += size;
+	}
+	template <typename T>
+	void WriteVal(const T& val) { Write(&val, sizeof(T)); }
+	template <typename T>
+	void WriteArray(const std::vector<T>& vals) { Write(vals.data(), vals.size() * sizeof(T)); }
+	// zero padding to start next section at aligned offset
+	void Pad();
+	// throw if any write failed
+	void Commit();
+
+private:
+	std::filesystem::path path;
+	std::filesystem::path tmpPath;
+	std::ofstream of;
+	size_t pos{ 0 };
+	bool committed{ false };
+};
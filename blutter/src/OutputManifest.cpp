@@ -0,0 +1,140 @@
+#include "pch.h"
+#include "OutputManifest.h"
+#include <fstream>
+#include <map>
+#include <sstream>
+
+static constexpr char MANIFEST_HEADER[] = "blutter-output-manifest 2";
+
+OutputManifest::OutputManifest(std::filesystem::path dir) : dir(dir.lexically_normal()), path(dir / ".blutter_manifest")
+{
+	load();
+}
+
+void OutputManifest::load()
+{
+	std::ifstream is(path);
+	if (!is)
+		return;
+
+	std::string line;
+	if (!std::getline(is, line) || line != MANIFEST_HEADER) {
+		std::cerr << std::format("Ignore unknown output manifest {}\n", path.string());
+		return;
+	}
+	while (std::getline(is, line)) {
+		std::istringstream ls(line);
+		Entry entry;
+		std::string name;
+		if (!(ls >> std::hex >> entry.hash >> std::dec >> entry.size) || !std::getline(ls >> std::ws, name))
+			break;
+		prevEntries[name] = entry;
+	}
+}
+
+std::string OutputManifest::EntryName(const std::filesystem::path& path) const
+{
+	const auto rel = path.lexically_normal().lexically_relative(dir);
+	if (rel.empty() || *rel.begin() == "..")
+		return std::string();
+	return rel.generic_string();
+}
+
+bool OutputManifest::PreviousSize(const std::string& name, uint64_t& size) const
+{
+	// prevEntries is not changed after loading
+	auto itr = prevEntries.find(name);
+	if (itr == prevEntries.end())
+		return false;
+	size = itr->second.size;
+	return true;
+}
+
+void OutputManifest::Record(const std::string& name, uint64_t hash, uint64_t size, bool written)
+{
+	std::lock_guard lock(mutex);
+	entries[name] = Entry{ hash, size };
+	if (written) {
+		numWritten++;
+	}
+	else {
+		numSkipped++;
+		skippedBytes += size;
+	}
+}
+
+void OutputManifest::Save()
+{
+	// outputs of previous run that are not produced anymore. the name is from the manifest file, so it is checked
+	//   to be in the output directory before removing
+	for (const auto& [name, entry] : prevEntries) {
+		if (entries.contains(name))
+			continue;
+		const auto file = dir / std::filesystem::path(name);
+		std::error_code ec;
+		if (EntryName(file) == name && std::filesystem::remove(file, ec))
+			numRemoved++;
+	}
+
+	auto tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream os(tmpPath);
+		os << MANIFEST_HEADER << '\n';
+		// sorted for stable manifest content
+		std::map<std::string_view, Entry> sorted;
+		for (const auto& [name, entry] : entries)
+			sorted.emplace(name, entry);
+		for (const auto& [name, entry] : sorted)
+			os << std::format("{:x} {} {}\n", entry.hash, entry.size, name);
+		if (!os)
+			throw std::runtime_error(std::format("failed to write output manifest {}", tmpPath.string()));
+	}
+	std::filesystem::rename(tmpPath, path);
+
+	std::cout << std::format("Incremental output: {} files written, {} unchanged files skipped ({:.1f} MB), {} stale files removed\n",
+		numWritten, numSkipped, skippedBytes / (1024.0 * 1024.0), numRemoved);
+}
+
+// FNV-1a style mixing of 8 bytes at a time. it is only for detecting changed content
+void OutputManifest::Hasher::mix(uint64_t val)
+{
+	hash = (hash ^ val) * 0x100000001b3;
+	hash ^= hash >> 29;
+}
+
+void OutputManifest::Hasher::Update(const char* data, size_t size)
+{
+	this->size += size;
+	if (tailSize > 0) {
+		const auto n = std::min(size, sizeof(tail) - tailSize);
+		memcpy(tail + tailSize, data, n);
+		tailSize += n;
+		data += n;
+		size -= n;
+		if (tailSize < sizeof(tail))
+			return;
+		uint64_t val;
+		memcpy(&val, tail, 8);
+		mix(val);
+		tailSize = 0;
+	}
+	while (size >= 8) {
+		uint64_t val;
+		memcpy(&val, data, 8);
+		mix(val);
+		data += 8;
+		size -= 8;
+	}
+	memcpy(tail, data, size);
+	tailSize = size;
+}
+
+uint64_t OutputManifest::Hasher::Final()
+{
+	uint64_t val = 0;
+	memcpy(&val, tail, tailSize);
+	mix(val);
+	mix(size);
+	return hash;
+}
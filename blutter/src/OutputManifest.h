@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// content hashes of output files from previous run. a file is written only if its content is changed,
+//   so unchanged files keep their modification time for indexers and file sync.
+// files of previous run that are not produced in this run are removed on Save().
+// text format. first line is header. then one line for each file
+//   <hash> <size> <path relative to output directory>
+class OutputManifest
+{
+public:
+	explicit OutputManifest(std::filesystem::path dir);
+	OutputManifest() = delete;
+	OutputManifest(const OutputManifest&) = delete;
+	OutputManifest& operator=(const OutputManifest&) = delete;
+
+	// empty if the file is not in the output directory
+	std::string EntryName(const std::filesystem::path& path) const;
+	// size of the file in previous run. false if the file is not in previous run
+	bool PreviousSize(const std::string& name, uint64_t& size) const;
+	// record content of the file in this run. written is false if the old file already has the content
+	void Record(const std::string& name, uint64_t hash, uint64_t size, bool written);
+	// save the files of this run. files of previous run that are not produced in this run are removed
+	void Save();
+
+	// hash of file content for detecting changed content. the content is given in pieces while it is written
+	class Hasher
+	{
+	public:
+		void Update(const char* data, size_t size);
+		uint64_t Final();
+
+	private:
+		void mix(uint64_t val);
+
+		uint64_t hash{ 0xcbf29ce484222325 };
+		uint64_t size{ 0 };
+		// bytes of incomplete 8 bytes word
+		char tail[8]{};
+		size_t tailSize{ 0 };
+	};
+
+private:
+	struct Entry {
+		uint64_t hash;
+		uint64_t size;
+	};
+
+	void load();
+
+	std::filesystem::path dir;
+	std::filesystem::path path;
+	std::unordered_map<std::string, Entry> prevEntries;
+	std::unordered_map<std::string, Entry> entries;
+	std::mutex mutex;
+	size_t numWritten{ 0 };
+	size_t numSkipped{ 0 };
+	size_t numRemoved{ 0 };
+	uint64_t skippedBytes{ 0 };
+};
@@ -0,0 +1,315 @@
+#include "pch.h"
+#include "OutputSink.h"
+#include "ArchiveWriter.h"
+#include <stdexcept>
+
+static FILE* openFile(const std::filesystem::path& path, const char* mode)
+{
+#ifdef _WIN32
+	const std::string m{ mode };
+	return _wfopen(path.c_str(), std::wstring(m.begin(), m.end()).c_str());
+#else
+	return fopen(path.c_str(), mode);
+#endif
+}
+
+OutputSink::OutputSink(const std::filesystem::path& path, bool append, bool backgroundWrite, size_t bufferSize)
+	: path(path), bufferSize(bufferSize), flushSize(bufferSize), backgroundWrite(backgroundWrite)
+{
+	entryName = archiveEntryName(path);
+	if (!entryName.empty()) {
+		// archive entry is written by the rendering thread. no append because every file is created once
+		archive = outputArchive;
+		this->backgroundWrite = false;
+		buf.reserve(bufferSize);
+		return;
+	}
+	writePath = path;
+	if (outputManifest && !append)
+		manifestName = outputManifest->EntryName(path);
+	if (!manifestName.empty()) {
+		writePath += ".tmp";
+		// compare with the old file only if it is not edited after previous run. size check is cheap
+		uint64_t prevSize;
+		std::error_code ec;
+		if (outputManifest->PreviousSize(manifestName, prevSize) && std::filesystem::file_size(path, ec) == prevSize && !ec)
+			oldFp = openFile(path, "rb");
+		if (oldFp) {
+			// the temporary file is created at the first difference
+			buf.reserve(bufferSize);
+			return;
+		}
+	}
+
+	// binary mode. text is written as is (LF line endings like archive entries), so Position() is the file offset
+	fp = openFile(writePath, append ? "ab" : "wb");
+	if (fp == nullptr)
+		throw std::runtime_error(std::format("cannot open {}", writePath.string()));
+	// the buffer is always big. let fwrite() go to the file directly
+	setvbuf(fp, nullptr, _IONBF, 0);
+	buf.reserve(bufferSize);
+}
+
+OutputSink::~OutputSink()
+{
+	try {
+		Close();
+	}
+	catch (...) {
+	}
+}
+
+void OutputSink::UseArchive(ArchiveWriter* archive, std::filesystem::path baseDir)
+{
+	outputArchive = archive;
+	archiveBaseDir = archive ? baseDir.lexically_normal() : std::filesystem::path();
+}
+
+std::string OutputSink::archiveEntryName(const std::filesystem::path& path)
+{
+	if (outputArchive == nullptr)
+		return std::string();
+	const auto rel = path.lexically_normal().lexically_relative(archiveBaseDir);
+	if (rel.empty() || *rel.begin() == "..")
+		return std::string();
+	return rel.generic_string();
+}
+
+bool OutputSink::ArchiveLocation(const std::filesystem::path& path, std::filesystem::path& archivePath, uint64_t& dataOffset)
+{
+	const auto name = archiveEntryName(path);
+	if (name.empty())
+		return false;
+	archivePath = outputArchive->Path();
+	dataOffset = outputArchive->EntryDataOffset(name);
+	return true;
+}
+
+void OutputSink::Close()
+{
+	if (archive) {
+		closeEntry();
+		return;
+	}
+	if (oldFp) {
+		// same content if the old file ends with the text in buffer
+		if (compareData(buf.data(), buf.size()) && fgetc(oldFp) == EOF) {
+			hasher.Update(buf.data(), buf.size());
+			const auto size = flushedBytes + buf.size();
+			fclose(oldFp);
+			oldFp = nullptr;
+			buf.clear();
+			closeIncremental(size, false);
+			return;
+		}
+		beginWrite();
+	}
+	if (fp == nullptr)
+		return;
+
+	if (writer.joinable()) {
+		{
+			std::unique_lock lock(mutex);
+			cv.wait(lock, [this] { return !hasPending; });
+			stopWriter = true;
+		}
+		cv.notify_all();
+		writer.join();
+	}
+	if (!manifestName.empty())
+		hasher.Update(buf.data(), buf.size());
+	const auto size = flushedBytes + buf.size();
+	bool ok = !writeError && writeData(buf.data(), buf.size());
+	buf.clear();
+	ok = fclose(fp) == 0 && ok;
+	fp = nullptr;
+	if (!ok) {
+		if (!manifestName.empty()) {
+			manifestName.clear();
+			std::error_code ec;
+			std::filesystem::remove(writePath, ec);
+		}
+		throw std::runtime_error(std::format("cannot write {}", path.string()));
+	}
+	if (!manifestName.empty())
+		closeIncremental(size, true);
+}
+
+bool OutputSink::writeData(const char* data, size_t size)
+{
+	if (size == 0)
+		return true;
+	totalBytes += size;
+	return fwrite(data, 1, size, fp) == size;
+}
+
+void OutputSink::flushEntry()
+{
+	if (spool == nullptr) {
+		spool = tmpfile();
+		if (spool == nullptr)
+			throw std::runtime_error(std::format("cannot create temporary file for {}", entryName));
+	}
+	if (fwrite(buf.data(), 1, buf.size(), spool) != buf.size())
+		throw std::runtime_error(std::format("cannot write temporary file for {}", entryName));
+	flushedBytes += buf.size();
+	buf.clear();
+}
+
+void OutputSink::closeEntry()
+{
+	if (entryName.empty())
+		return;
+
+	bool ownsEntry = false;
+	try {
+		if (spool && (fflush(spool) != 0 || fseek(spool, 0, SEEK_SET) != 0))
+			throw std::runtime_error(std::format("cannot read temporary file for {}", entryName));
+		archive->BeginEntry(entryName);
+		ownsEntry = true;
+		if (spool) {
+			// copy through the pending buffer. it is not used for archive entry
+			pending.resize(std::min<size_t>(bufferSize, 1024 * 1024));
+			uint64_t copied = 0;
+			while (copied < flushedBytes) {
+				const auto size = fread(pending.data(), 1, (size_t)std::min<uint64_t>(pending.size(), flushedBytes - copied), spool);
+				if (size == 0)
+					throw std::runtime_error(std::format("cannot read temporary file for {}", entryName));
+				archive->Write(pending.data(), size);
+				copied += size;
+			}
+		}
+		archive->Write(buf.data(), buf.size());
+		ownsEntry = false;
+		archive->EndEntry();
+		totalBytes += flushedBytes + buf.size();
+	}
+	catch (...) {
+		if (ownsEntry)
+			archive->AbortEntry();
+		if (spool) {
+			fclose(spool);
+			spool = nullptr;
+		}
+		entryName.clear();
+		buf.clear();
+		throw;
+	}
+	if (spool) {
+		fclose(spool);
+		spool = nullptr;
+	}
+	pending.clear();
+	entryName.clear();
+	buf.clear();
+}
+
+bool OutputSink::compareData(const char* data, size_t size)
+{
+	if (size == 0)
+		return true;
+	// pending buffer is not used before writing
+	pending.resize(size);
+	const bool same = fread(pending.data(), 1, size, oldFp) == size && memcmp(pending.data(), data, size) == 0;
+	pending.clear();
+	return same;
+}
+
+void OutputSink::beginWrite()
+{
+	fp = openFile(writePath, "wb");
+	if (fp == nullptr) {
+		fclose(oldFp);
+		oldFp = nullptr;
+		manifestName.clear();
+		throw std::runtime_error(std::format("cannot open {}", writePath.string()));
+	}
+	setvbuf(fp, nullptr, _IONBF, 0);
+
+	// copy the flushed text from the old file. it is same as the text
+	bool ok = fseek(oldFp, 0, SEEK_SET) == 0;
+	pending.resize(std::min<size_t>(bufferSize, 1024 * 1024));
+	uint64_t copied = 0;
+	while (ok && copied < flushedBytes) {
+		const auto size = fread(pending.data(), 1, (size_t)std::min<uint64_t>(pending.size(), flushedBytes - copied), oldFp);
+		ok = size != 0 && writeData(pending.data(), size);
+		copied += size;
+	}
+	pending.clear();
+	fclose(oldFp);
+	oldFp = nullptr;
+	if (!ok) {
+		fclose(fp);
+		fp = nullptr;
+		manifestName.clear();
+		std::error_code ec;
+		std::filesystem::remove(writePath, ec);
+		throw std::runtime_error(std::format("cannot write {}", path.string()));
+	}
+}
+
+void OutputSink::closeIncremental(uint64_t size, bool written)
+{
+	const auto name = std::move(manifestName);
+	manifestName.clear();
+	outputManifest->Record(name, hasher.Final(), size, written);
+	// the temporary file is written only if the content is changed
+	if (written)
+		std::filesystem::rename(writePath, path);
+}
+
+void OutputSink::flushBuffer()
+{
+	if (archive) {
+		flushEntry();
+		return;
+	}
+	if (!manifestName.empty())
+		hasher.Update(buf.data(), buf.size());
+	if (oldFp) {
+		if (compareData(buf.data(), buf.size())) {
+			flushedBytes += buf.size();
+			buf.clear();
+			return;
+		}
+		beginWrite();
+	}
+	if (!backgroundWrite) {
+		if (!writeData(buf.data(), buf.size()))
+			throw std::runtime_error(std::format("cannot write {}", path.string()));
+		flushedBytes += buf.size();
+		buf.clear();
+		return;
+	}
+
+	std::unique_lock lock(mutex);
+	if (!writer.joinable())
+		writer = std::thread(&OutputSink::writerLoop, this);
+	// previous buffer must be written before handing the next one. the buffers are swapped, so no allocation
+	cv.wait(lock, [this] { return !hasPending; });
+	if (writeError)
+		throw std::runtime_error(std::format("cannot write {}", path.string()));
+	flushedBytes += buf.size();
+	std::swap(buf, pending);
+	hasPending = true;
+	lock.unlock();
+	cv.notify_all();
+}
+
+void OutputSink::writerLoop()
+{
+	std::unique_lock lock(mutex);
+	while (true) {
+		cv.wait(lock, [this] { return hasPending || stopWriter; });
+		if (!hasPending)
+			break;
+		lock.unlock();
+		const bool ok = writeData(pending.data(), pending.size());
+		lock.lock();
+		pending.clear();
+		hasPending = false;
+		if (!ok)
+			writeError = true;
+		cv.notify_all();
+	}
+}
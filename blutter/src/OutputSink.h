@@ -0,0 +1,146 @@
+#pragma once
+#include "fmt/format.h"
+#include "OutputManifest.h"
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+class ArchiveWriter;
+
+// buffered text writer for all dump files.
+// text is formatted directly into a large reusable buffer (no temporary string per line) and
+//   the buffer is written to the file with one big write call when it is full.
+// with background writing, a full buffer is handed to a writer thread and formatting continues on the other buffer.
+//   the writer thread is started on first full buffer, so small files never create a thread.
+// with an archive (see UseArchive()), a file under the archive directory becomes an archive entry. a full buffer is
+//   spooled to a temporary file and the entry is copied to the archive on Close(). the archive is locked only while
+//   copying an entry (not while rendering), so a sink never keeps more than its buffer in memory.
+// with a manifest (see UseManifest()), the text is hashed for the manifest. if the file is in previous run, the text is
+//   compared with the old file and nothing is written while they are same. at the first difference, "<path>.tmp" is
+//   created with the same prefix and the rest is written to it. on Close(), the temporary file replaces the file.
+//   an unchanged file is never written.
+class OutputSink
+{
+public:
+	static constexpr size_t DefaultBufferSize = 4 * 1024 * 1024;
+
+	explicit OutputSink(const std::filesystem::path& path, bool append = false, bool backgroundWrite = false, size_t bufferSize = DefaultBufferSize);
+	OutputSink() = delete;
+	OutputSink(const OutputSink&) = delete;
+	OutputSink& operator=(const OutputSink&) = delete;
+	~OutputSink();
+
+	template <typename... T>
+	void Print(fmt::format_string<T...> fmtStr, T&&... args) {
+		fmt::format_to(std::back_inserter(buf), fmtStr, std::forward<T>(args)...);
+		if (buf.size() >= flushSize)
+			flushBuffer();
+	}
+
+	OutputSink& operator<<(std::string_view s) {
+		buf.append(s.data(), s.data() + s.size());
+		if (buf.size() >= flushSize)
+			flushBuffer();
+		return *this;
+	}
+	OutputSink& operator<<(char c) {
+		buf.push_back(c);
+		return *this;
+	}
+	// number is written as decimal like std::ostream. Dart VM constants (class id) are enum
+	template <typename T, std::enable_if_t<(std::is_arithmetic_v<T> || std::is_enum_v<T>) && !std::is_same_v<T, char>, int> = 0>
+	OutputSink& operator<<(T val) {
+		if constexpr (std::is_enum_v<T>)
+			fmt::format_to(std::back_inserter(buf), "{}", static_cast<std::underlying_type_t<T>>(val));
+		else
+			fmt::format_to(std::back_inserter(buf), "{}", val);
+		return *this;
+	}
+
+	// render an object that can append its text to a buffer (IL, value and type) without temporary string
+	template <typename T>
+	OutputSink& Append(T& obj) {
+		obj.AppendTo(buf);
+		if (buf.size() >= flushSize)
+			flushBuffer();
+		return *this;
+	}
+
+	// write all buffered text and close the file. throw if some text cannot be written
+	void Close();
+
+	// byte offset in the file of the next text (files are written in binary mode. offset from the old end with append)
+	uint64_t Position() const { return flushedBytes + buf.size(); }
+
+	// bytes written by all sinks (for measuring output throughput)
+	static uint64_t TotalBytes() { return totalBytes; }
+
+	// files under baseDir are written to the archive. nullptr for writing files again.
+	//   it must be called when no sink is open
+	static void UseArchive(ArchiveWriter* archive, std::filesystem::path baseDir);
+	// files in the manifest directory are written only if they are changed. nullptr for always writing.
+	//   it must be called when no sink is open
+	static void UseManifest(OutputManifest* manifest) { outputManifest = manifest; }
+	// true if the file is written to the archive. the directories of archived files must not be created
+	static bool InArchive(const std::filesystem::path& path) { return !archiveEntryName(path).empty(); }
+	// archive file and offset of the content of a closed file in the archive. false if the file is not in the archive
+	static bool ArchiveLocation(const std::filesystem::path& path, std::filesystem::path& archivePath, uint64_t& dataOffset);
+
+private:
+	void flushBuffer();
+	void flushEntry();
+	void closeEntry();
+	// true if the data is the next data in the old file
+	bool compareData(const char* data, size_t size);
+	// the text is different from the old file. create the temporary file with the flushed text (same as the old file)
+	void beginWrite();
+	// replace the file with the written temporary file if the content is changed
+	void closeIncremental(uint64_t size, bool written);
+	// empty if the file is not in the archive
+	static std::string archiveEntryName(const std::filesystem::path& path);
+	// false on error
+	bool writeData(const char* data, size_t size);
+	void writerLoop();
+
+	FILE* fp{ nullptr };
+	std::filesystem::path path;
+	size_t bufferSize;
+	// buffer size that triggers flushing
+	size_t flushSize;
+	bool backgroundWrite;
+	fmt::memory_buffer buf;
+	// bytes that are not in buf anymore (written or handed to writer thread)
+	uint64_t flushedBytes{ 0 };
+
+	// background writing. pending is owned by writer thread while hasPending is true
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable cv;
+	fmt::memory_buffer pending;
+	bool hasPending{ false };
+	bool stopWriter{ false };
+	bool writeError{ false };
+
+	// archive entry. empty name when the entry is closed
+	ArchiveWriter* archive{ nullptr };
+	std::string entryName;
+	// text of the entry that is flushed before Close(). nullptr if the entry fits in the buffer
+	FILE* spool{ nullptr };
+	// name in manifest. empty if the file is written as usual
+	std::string manifestName;
+	// file that is opened. it is temporary file with a manifest
+	std::filesystem::path writePath;
+	// old file that is compared with the text. nullptr after the first difference (then fp is opened)
+	FILE* oldFp{ nullptr };
+	OutputManifest::Hasher hasher;
+
+	static inline std::atomic<uint64_t> totalBytes{ 0 };
+	static inline ArchiveWriter* outputArchive{ nullptr };
+	static inline OutputManifest* outputManifest{ nullptr };
+	static inline std::filesystem::path archiveBaseDir;
+};
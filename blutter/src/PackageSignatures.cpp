@@ -0,0 +1,219 @@
+#include "pch.h"
+#include "PackageSignatures.h"
+#include "DartApp.h"
+#include "A64Decoder.h"
+#include <fstream>
+#include <sstream>
+
+static constexpr char SIGNATURES_HEADER[] = "blutter-package-signatures 1";
+
+PackageSignatures::PackageSignatures(std::filesystem::path path) : path(std::move(path))
+{
+	load();
+}
+
+void PackageSignatures::load()
+{
+	std::ifstream is(path);
+	if (!is)
+		return;
+
+	// text format. first line is header. then 2 lines for each signature
+	//   <library url> <label> <number of hashes>
+	//   <hash> <hash> ...
+	std::string line;
+	if (!std::getline(is, line) || line != SIGNATURES_HEADER) {
+		std::cerr << std::format("Ignore unknown package signatures file {}\n", path.string());
+		return;
+	}
+	while (std::getline(is, line)) {
+		std::istringstream ls(line);
+		std::string url;
+		Signature sig;
+		size_t num = 0;
+		if (!(ls >> url >> sig.label >> num))
+			break;
+		std::string hashLine;
+		std::getline(is, hashLine);
+		std::istringstream hs(hashLine);
+		sig.hashes.reserve(num);
+		uint64_t hash;
+		while (hs >> std::hex >> hash)
+			sig.hashes.push_back(hash);
+		if (sig.hashes.size() != num)
+			throw std::runtime_error(std::format("broken package signature of {} in {}", url, path.string()));
+		std::sort(sig.hashes.begin(), sig.hashes.end());
+		libSigs[url].push_back(std::move(sig));
+	}
+}
+
+void PackageSignatures::Save()
+{
+	std::ofstream os(path);
+	os << SIGNATURES_HEADER << '\n';
+	for (const auto& [url, sigs] : libSigs) {
+		for (const auto& sig : sigs) {
+			os << std::format("{} {} {}\n", url, sig.label, sig.hashes.size());
+			for (size_t i = 0; i < sig.hashes.size(); i++) {
+				if (i != 0)
+					os << ' ';
+				os << std::format("{:x}", sig.hashes[i]);
+			}
+			os << '\n';
+		}
+	}
+	if (!os)
+		throw std::runtime_error(std::format("failed to write package signatures {}", path.string()));
+}
+
+size_t PackageSignatures::NumSignatures() const
+{
+	size_t num = 0;
+	for (const auto& [url, sigs] : libSigs)
+		num += sigs.size();
+	return num;
+}
+
+size_t PackageSignatures::Match(DartApp& app, double threshold)
+{
+	size_t numMatched = 0;
+	size_t numFn = 0;
+	for (auto lib : app.libs) {
+		if (lib->isInternal)
+			continue;
+		auto itr = libSigs.find(lib->url);
+		if (itr == libSigs.end())
+			continue;
+
+		const auto hashes = libraryHashes(app, *lib);
+		if (hashes.empty())
+			continue;
+		const Signature* bestSig = nullptr;
+		double bestScore = 0;
+		for (const auto& sig : itr->second) {
+			size_t common = 0;
+			auto it1 = hashes.begin();
+			auto it2 = sig.hashes.begin();
+			while (it1 != hashes.end() && it2 != sig.hashes.end()) {
+				if (*it1 < *it2)
+					++it1;
+				else if (*it2 < *it1)
+					++it2;
+				else {
+					common++;
+					++it1;
+					++it2;
+				}
+			}
+			// both sides must be mostly same. a library that adds or removes many functions is another version
+			const double score = (double)common / std::max(hashes.size(), sig.hashes.size());
+			if (score > bestScore) {
+				bestScore = score;
+				bestSig = &sig;
+			}
+		}
+
+		if (bestSig && bestScore >= threshold) {
+			lib->knownPackage = bestSig->label;
+			numMatched++;
+			numFn += hashes.size();
+		}
+	}
+
+	std::cout << std::format("Matched {} libraries ({} functions) with known package signatures\n", numMatched, numFn);
+	return numMatched;
+}
+
+void PackageSignatures::Add(DartApp& app, const std::string& label)
+{
+	// label is saved as a word
+	std::string word = label;
+	std::replace_if(word.begin(), word.end(), [](char c) { return std::isspace((unsigned char)c); }, '_');
+
+	size_t numLib = 0;
+	for (auto lib : app.libs) {
+		// only packages are shared between apps
+		if (lib->isInternal || !lib->url.starts_with("package:"))
+			continue;
+		auto hashes = libraryHashes(app, *lib);
+		if (hashes.empty())
+			continue;
+
+		auto& sigs = libSigs[lib->url];
+		auto itr = std::find_if(sigs.begin(), sigs.end(), [&word](const Signature& sig) { return sig.label == word; });
+		if (itr != sigs.end())
+			itr->hashes = std::move(hashes);
+		else
+			sigs.push_back(Signature{ word, std::move(hashes) });
+		numLib++;
+	}
+	std::cout << std::format("Added signatures of {} libraries as {}\n", numLib, word);
+}
+
+std::vector<uint64_t> PackageSignatures::libraryHashes(DartApp& app, DartLibrary& lib)
+{
+	std::vector<uint64_t> hashes;
+	for (auto cls : lib.classes) {
+		for (auto dartFn : cls->Functions()) {
+			if (dartFn->Size() > 0)
+				hashes.push_back(functionHash(app, *dartFn));
+		}
+	}
+	std::sort(hashes.begin(), hashes.end());
+	hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+	return hashes;
+}
+
+// arm64 specific
+uint64_t PackageSignatures::functionHash(DartApp& app, DartFunction& dartFn)
+{
+	const auto code = (const uint32_t*)dartFn.MemAddress();
+	const uint64_t start = dartFn.Address();
+	const uint64_t end = dartFn.AddressEnd();
+	const auto numWords = dartFn.Size() / 4;
+	constexpr uint32_t ppBase = (uint32_t)dart::PP << 5;
+
+	uint64_t hash = 0xcbf29ce484222325;
+	auto mix = [&hash](uint64_t val) { hash = (hash ^ val) * 0x100000001b3; };
+	auto mixName = [&mix](const std::string& name) {
+		for (auto c : name)
+			mix((uint8_t)c);
+	};
+	mixName(dartFn.FullName());
+
+	// pool layout and code address are different in every app. pool offsets are masked out and
+	//   call target outside function is replaced with its name
+	for (int64_t i = 0; i < numWords; i++) {
+		const uint32_t word = code[i];
+		if ((word & 0xffc003e0) == (0xf9400000 | ppBase)) {
+			// LDR Xt, [PP, #imm]
+			mix(word & ~0x003ffc00u);
+			continue;
+		}
+		if ((word & 0xffc003e0) == (0x91400000 | ppBase)) {
+			// ADD Xd, PP, #imm, LSL 12. the next instruction has low bits of offset
+			mix(word & ~0x003ffc00u);
+			if (i + 1 < numWords && ((code[i + 1] >> 5) & 0x1f) == (word & 0x1f)) {
+				i++;
+				mix(code[i] & ~0x003ffc00u);
+			}
+			continue;
+		}
+
+		uint32_t immMask;
+		uint64_t target;
+		if (!A64::DecodePcRelative(word, start + i * 4, immMask, target)) {
+			mix(word);
+			continue;
+		}
+		mix(word & ~immMask);
+		if (target >= start && target < end) {
+			mix(target - start);
+		}
+		else {
+			auto fn = app.GetFunction(target);
+			mixName(fn ? fn->FullName() : "?");
+		}
+	}
+	return hash;
+}
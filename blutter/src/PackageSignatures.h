@@ -0,0 +1,45 @@
+#pragma once
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+class DartApp;
+class DartFunction;
+class DartLibrary;
+
+// signatures of libraries from previously analyzed apps. a library signature is a set of normalized
+//   function hashes (name and code without pool offsets and addresses), so same package version
+//   in other app has mostly same set.
+class PackageSignatures
+{
+public:
+	explicit PackageSignatures(std::filesystem::path path);
+	PackageSignatures() = delete;
+	PackageSignatures(const PackageSignatures&) = delete;
+	PackageSignatures& operator=(const PackageSignatures&) = delete;
+
+	// set DartLibrary::knownPackage of libraries that match a known signature. return number of matched libraries
+	size_t Match(DartApp& app, double threshold = DefaultThreshold);
+	// add package libraries of the app with label (e.g. "http-1.1.0"). existing signature of same label is replaced
+	void Add(DartApp& app, const std::string& label);
+	void Save();
+
+	size_t NumSignatures() const;
+
+	static constexpr double DefaultThreshold = 0.9;
+
+private:
+	struct Signature {
+		std::string label;
+		std::vector<uint64_t> hashes; // sorted
+	};
+
+	void load();
+	std::vector<uint64_t> libraryHashes(DartApp& app, DartLibrary& lib);
+	// implementation is specific to architecture
+	static uint64_t functionHash(DartApp& app, DartFunction& dartFn);
+
+	std::filesystem::path path;
+	// library url to signatures of different package versions
+	std::unordered_map<std::string, std::vector<Signature>> libSigs;
+};
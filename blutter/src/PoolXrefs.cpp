@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "PoolXrefs.h"
+#include "DartApp.h"
+#include "CodeAnalyzer.h"
+
+static constexpr char POOLXREFS_MAGIC[8] = { 'B', 'L', 'T', 'R', 'X', 'R', 'E', 'F' };
+static constexpr uint32_t POOLXREFS_VERSION = 1;
+
+struct PoolXrefsHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t numEntries;
+	uint64_t numRefs;
+	uint64_t textsSize;
+};
+
+PoolXrefs::PoolXrefs(const std::filesystem::path& path) : file(path)
+{
+	const auto hdr = file.At<PoolXrefsHeader>(0);
+	if (memcmp(hdr->magic, POOLXREFS_MAGIC, sizeof(POOLXREFS_MAGIC)) != 0 || hdr->version != POOLXREFS_VERSION)
+		throw std::runtime_error(std::format("{} is not a pool xrefs file of this blutter version", path.string()));
+
+	numEntries = hdr->numEntries;
+	size_t offset = sizeof(PoolXrefsHeader);
+	refOffsets = file.At<uint32_t>(offset, numEntries + 1);
+	offset = MappedFile::AlignUp(offset + sizeof(uint32_t) * (numEntries + 1));
+	refs = file.At<Ref>(offset, hdr->numRefs);
+	offset += sizeof(Ref) * hdr->numRefs;
+	textOffsets = file.At<uint32_t>(offset, numEntries + 1);
+	offset = MappedFile::AlignUp(offset + sizeof(uint32_t) * (numEntries + 1));
+	kinds = file.At<uint8_t>(offset, numEntries);
+	offset = MappedFile::AlignUp(offset + numEntries);
+	texts = file.At<char>(offset, hdr->textsSize);
+}
+
+std::span<const PoolXrefs::Ref> PoolXrefs::Refs(uint32_t idx) const
+{
+	return std::span<const Ref>(refs + refOffsets[idx], refOffsets[idx + 1] - refOffsets[idx]);
+}
+
+std::string_view PoolXrefs::Text(uint32_t idx) const
+{
+	return std::string_view(texts + textOffsets[idx], textOffsets[idx + 1] - textOffsets[idx]);
+}
+
+std::vector<uint32_t> PoolXrefs::FindStrings(std::string_view text) const
+{
+	std::vector<uint32_t> result;
+	for (uint32_t i = 0; i < numEntries; i++) {
+		if (kinds[i] == DartPoolEntry::String && Text(i).find(text) != std::string_view::npos)
+			result.push_back(i);
+	}
+	return result;
+}
+
+#ifndef NO_CODE_ANALYSIS
+void PoolXrefs::Create(DartApp& app, const std::filesystem::path& path)
+{
+	const auto& pool = app.GetPool();
+	const auto num = (uint32_t)pool.Length();
+
+	// (pool index, ref)
+	std::vector<std::pair<uint32_t, Ref>> rawRefs;
+	for (auto lib : app.libs) {
+		if (lib->isInternal)
+			continue;
+		for (auto cls : lib->classes) {
+			for (auto dartFn : cls->Functions()) {
+				auto fnData = dartFn->GetAnalyzedData();
+				if (dartFn->Size() == 0 || fnData == nullptr)
+					continue;
+				for (const auto& block : fnData->Blocks()) {
+					for (auto offset : block.poolRefs) {
+						const auto& asmText = fnData->asmTexts.AtAddr(dartFn->Address() + offset);
+						const auto idx = dart::ObjectPool::IndexFromOffset(asmText.poolOffset);
+						if (idx >= 0 && idx < (intptr_t)num)
+							rawRefs.emplace_back((uint32_t)idx, Ref{ asmText.addr, dartFn->Address() });
+					}
+				}
+			}
+		}
+	}
+	std::sort(rawRefs.begin(), rawRefs.end(), [](const auto& a, const auto& b) {
+		return a.first != b.first ? a.first < b.first : a.second.addr < b.second.addr;
+	});
+
+	std::vector<uint32_t> refOffsets(num + 1, 0);
+	std::vector<Ref> refs;
+	refs.reserve(rawRefs.size());
+	for (const auto& [idx, ref] : rawRefs) {
+		refOffsets[idx + 1]++;
+		refs.push_back(ref);
+	}
+	for (uint32_t i = 0; i < num; i++)
+		refOffsets[i + 1] += refOffsets[i];
+
+	std::vector<uint32_t> textOffsets(num + 1, 0);
+	std::vector<uint8_t> kinds(num);
+	std::string texts;
+	for (uint32_t i = 0; i < num; i++) {
+		const auto& entry = pool.EntryAt(i);
+		kinds[i] = entry.kind;
+		texts += entry.kind == DartPoolEntry::String || !pool.HasDescriptions() ? entry.text : entry.desc;
+		textOffsets[i + 1] = (uint32_t)texts.size();
+	}
+
+	IndexFileWriter of(path);
+	PoolXrefsHeader hdr{};
+	memcpy(hdr.magic, POOLXREFS_MAGIC, sizeof(POOLXREFS_MAGIC));
+	hdr.version = POOLXREFS_VERSION;
+	hdr.numEntries = num;
+	hdr.numRefs = refs.size();
+	hdr.textsSize = texts.size();
+	of.WriteVal(hdr);
+	of.WriteArray(refOffsets);
+	of.Pad();
+	of.WriteArray(refs);
+	of.WriteArray(textOffsets);
+	of.Pad();
+	of.WriteArray(kinds);
+	of.Pad();
+	of.Write(texts.data(), texts.size());
+	of.Commit();
+
+	std::cout << std::format("Pool xrefs: {} references to {} pool entries\n", refs.size(), num);
+}
+#endif // NO_CODE_ANALYSIS
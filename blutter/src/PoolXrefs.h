@@ -0,0 +1,50 @@
+#pragma once
+#include "MappedFile.h"
+#include <span>
+#include <string_view>
+#include <vector>
+
+class DartApp;
+
+// cross reference from object pool entries to the instructions that load them.
+// the index is saved as a file that can be queried later without loading the app.
+// file layout (every section is 8 bytes aligned):
+//   Header
+//   uint32_t refOffsets[numEntries + 1], Ref refs[numRefs] (sorted by pool index then address)
+//   uint32_t textOffsets[numEntries + 1], uint8_t kinds[numEntries], char texts[]
+class PoolXrefs
+{
+public:
+	struct Ref {
+		uint64_t addr; // instruction address
+		uint64_t fnAddr; // function that contains the instruction
+	};
+
+	explicit PoolXrefs(const std::filesystem::path& path);
+	PoolXrefs() = delete;
+	PoolXrefs(const PoolXrefs&) = delete;
+	PoolXrefs& operator=(const PoolXrefs&) = delete;
+
+#ifndef NO_CODE_ANALYSIS
+	// create index file from analyzed functions. pool descriptions must be rendered (after dumping)
+	static void Create(DartApp& app, const std::filesystem::path& path);
+#endif
+
+	uint32_t NumEntries() const { return numEntries; }
+	std::span<const Ref> Refs(uint32_t idx) const;
+	// DartPoolEntry::Kind
+	uint8_t Kind(uint32_t idx) const { return kinds[idx]; }
+	// string value for String entry. simple description for others
+	std::string_view Text(uint32_t idx) const;
+	// String entries that contain the text
+	std::vector<uint32_t> FindStrings(std::string_view text) const;
+
+private:
+	MappedFile file;
+	uint32_t numEntries;
+	const uint32_t* refOffsets;
+	const Ref* refs;
+	const uint32_t* textOffsets;
+	const uint8_t* kinds;
+	const char* texts;
+};
@@ -7,5 +7,8 @@ public:
 	static std::string UnescapeWithQuote(const char* s);
 	static std::string Quote(const std::string& s);
 	static std::string Unquote(const std::string& s);
+
+	// append text to a rendering buffer (see AppendTo() of IL, value and type)
+	static void Append(fmt::memory_buffer& out, std::string_view s) { out.append(s.data(), s.data() + s.size()); }
 };
 
@@ -1,28 +1,44 @@
 #include "pch.h"
 #include "VarValue.h"
-#include <sstream>
+#include <array>
 
 static_assert(sizeof(bool) == 1, "bool size is not 1 byte");
 
 std::string VarStorage::Name()
 {
+	fmt::memory_buffer out;
+	AppendName(out);
+	return fmt::to_string(out);
+}
+
+void VarStorage::AppendName(fmt::memory_buffer& out)
+{
+	auto it = std::back_inserter(out);
 	switch (kind) {
 	case Register:
-		return reg.Name();
+		Util::Append(out, reg.Name());
+		break;
 	case Local:
-		return std::format("local_{:x}", -offset);
+		fmt::format_to(it, "local_{:x}", -offset);
+		break;
 	case Argument:
-		return std::format("arg_{}", idx);
+		fmt::format_to(it, "arg_{}", idx);
+		break;
 	case Static:
-		return std::format("static_{:x}", offset);
+		fmt::format_to(it, "static_{:x}", offset);
+		break;
 	case Pool:
-		return std::format("PP_{:x}", offset);
+		fmt::format_to(it, "PP_{:x}", offset);
+		break;
 	case Thread:
-		return std::format("THR_{:x}", offset);
+		fmt::format_to(it, "THR_{:x}", offset);
+		break;
 	case SmallImm:
-		return std::to_string(offset);
+		fmt::format_to(it, "{}", offset);
+		break;
 	case InInstruction:
-		return "tmp";
+		Util::Append(out, "tmp");
+		break;
 	default:
 		// Immediate has no storage type
 		FATAL("Unknown storage type");
@@ -53,28 +69,28 @@ void VarValue::SetSmiIfInt()
 	}
 }
 
-std::string VarArray::ToString()
+void VarArray::AppendTo(fmt::memory_buffer& out)
 {
-	std::string out;
 	if ((intptr_t)ptr == (intptr_t)dart::Object::null()) {
 		// no data
-		out = "List";
+		Util::Append(out, "List");
 		if (eleType) {
-			out += "<" + eleType->ToString() + ">";
+			out.push_back('<');
+			eleType->AppendTo(out);
+			out.push_back('>');
 		}
-		out += "(";
+		out.push_back('(');
 		if (length != -1) {
-			out += std::to_string(length);
+			fmt::format_to(std::back_inserter(out), "{}", length);
 		}
-		out += ")";
+		out.push_back(')');
 	}
 	else {
 		// has data (const array)
 		const auto& arr = dart::Array::Handle(ptr);
 		const auto arr_len = arr.Length();
 		//const auto& type_args = dart::TypeArguments::Handle(arr.GetTypeArguments());
-		std::ostringstream ss;
-		ss << "const [";
+		Util::Append(out, "const [");
 		if (arr_len > 0) {
 			// in ImmutableList, only Dart type (native type is not used)
 			const auto heap_base = dart::Thread::Current()->heap_base();
@@ -82,34 +98,46 @@ std::string VarArray::ToString()
 			auto arrPtr = dart::Array::DataOf(arr.ptr());
 			for (intptr_t i = 0; i < arr_len; i++) {
 				if (i != 0)
-					ss << ", ";
+					Util::Append(out, ", ");
 
 				if (arrPtr->IsHeapObject()) {
 					obj = arrPtr->Decompress(heap_base);
 					// TODO: better string representation
-					ss << obj.ToCString();
+					Util::Append(out, obj.ToCString());
 				}
 				else {
 					obj = arrPtr->DecompressSmi();
-					ss << std::hex << std::showbase << dart::Smi::Cast(obj).Value();
+					// same as std::hex with std::showbase (no prefix for zero)
+					const auto val = dart::Smi::Cast(obj).Value();
+					if (val == 0)
+						out.push_back('0');
+					else
+						fmt::format_to(std::back_inserter(out), "{:#x}", (uint64_t)val);
 				}
 				arrPtr++;
 			}
 		}
-		ss << "]";
-		out = ss.str();
+		out.push_back(']');
 	}
-	return out;
 }
 
 std::string VarItem::Name()
+{
+	fmt::memory_buffer out;
+	AppendName(out);
+	return fmt::to_string(out);
+}
+
+void VarItem::AppendName(fmt::memory_buffer& out)
 {
 	switch (storage.kind) {
 	case VarStorage::Immediate:
 	case VarStorage::Pool:
-		return val->ToString();
+		val->AppendTo(out);
+		break;
 	default:
-		return storage.Name();
+		storage.AppendName(out);
+		break;
 	}
 }
 
@@ -124,3 +152,45 @@ std::string VarItem::CallArgName()
 		return storage.Name();
 	}
 }
+
+template <typename T>
+static T* newShared(T* val)
+{
+	val->shared = true;
+	return val;
+}
+
+VarValue* VarConstants::Null()
+{
+	static auto val = newShared(new VarNull());
+	return val;
+}
+
+VarValue* VarConstants::Boolean(bool val)
+{
+	static auto valTrue = newShared(new VarBoolean(true));
+	static auto valFalse = newShared(new VarBoolean(false));
+	return val ? valTrue : valFalse;
+}
+
+VarValue* VarConstants::Integer(int64_t val, ValueType intTypeId)
+{
+	using SharedInts = std::array<VarValue*, kMaxSharedInt - kMinSharedInt>;
+	static const auto createInts = [](ValueType tid) {
+		SharedInts vals;
+		for (int64_t i = kMinSharedInt; i < kMaxSharedInt; i++)
+			vals[i - kMinSharedInt] = newShared(new VarInteger(i, tid));
+		return vals;
+	};
+	// only native int (from mov instruction) and Smi (from pool) are common
+	static const SharedInts nativeInts = createInts(VarValue::NativeInt);
+	static const SharedInts smiInts = createInts(dart::kSmiCid);
+
+	if (val >= kMinSharedInt && val < kMaxSharedInt) {
+		if (intTypeId == VarValue::NativeInt)
+			return nativeInts[val - kMinSharedInt];
+		if (intTypeId == dart::kSmiCid)
+			return smiInts[val - kMinSharedInt];
+	}
+	return new VarInteger(val, intTypeId);
+}
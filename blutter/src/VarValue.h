@@ -41,6 +41,7 @@ struct VarStorage {
 	bool IsPredefinedValue() const { return kind == Immediate || kind == Pool; }
 
 	std::string Name();
+	void AppendName(fmt::memory_buffer& out);
 
 	Kind kind;
 	union {
@@ -72,8 +73,13 @@ struct VarValue {
 	VarValue(ValueType typeId, bool hasValue = false) : typeId(typeId), hasValue(hasValue) {}
 	//VarValue() : kind(Unknown), hasValue(false) {}
 	virtual ~VarValue() {}
-	//virtual std::string ToString() = 0;
-	virtual std::string ToString() { return "unknown"; }
+	std::string ToString() {
+		fmt::memory_buffer out;
+		AppendTo(out);
+		return fmt::to_string(out);
+	}
+	// render value at the end of buffer without temporary string
+	virtual void AppendTo(fmt::memory_buffer& out) { Util::Append(out, "unknown"); }
 	bool HasValue() const { return hasValue; }
 	virtual ValueType TypeId() { return typeId; }
 	ValueType RawTypeId() const { return typeId; }
@@ -89,19 +95,32 @@ struct VarValue {
 		return reinterpret_cast<VarParam*>(this);
 	}
 
+	// shared (flyweight) value is never deleted by its owner. see VarConstants
+	bool IsShared() const { return shared; }
+
 	ValueType typeId;
 	bool hasValue;
+	bool shared{ false };
+};
+
+// VarItem owns its value except shared one
+struct VarValueDeleter {
+	void operator()(VarValue* val) const {
+		if (!val->IsShared())
+			delete val;
+	}
 };
+using VarValuePtr = std::unique_ptr<VarValue, VarValueDeleter>;
 
 struct VarNull : public VarValue {
 	explicit VarNull() : VarValue(dart::kNullCid, true) {}
-	virtual std::string ToString() { return "Null"; }
+	virtual void AppendTo(fmt::memory_buffer& out) { Util::Append(out, "Null"); }
 };
 
 struct VarBoolean : public VarValue {
 	explicit VarBoolean(bool val) : VarValue(dart::kBoolCid, true), val(val) {}
 	explicit VarBoolean() : VarValue(dart::kBoolCid, false), val(false) {}
-	virtual std::string ToString() { return val ? "true" : "false"; }
+	virtual void AppendTo(fmt::memory_buffer& out) { Util::Append(out, val ? "true" : "false"); }
 
 	bool val;
 };
@@ -111,7 +130,7 @@ struct VarInteger : public VarValue {
 	// Note: VarInteger = unknown integer type (maybe native, smi, mint)
 	explicit VarInteger(int64_t val, ValueType intTypeId = dart::kIntegerCid) : VarValue(dart::kIntegerCid, true), intTypeId(intTypeId), val(val) {}
 	explicit VarInteger(ValueType intTypeId = dart::kIntegerCid) : VarValue(dart::kIntegerCid, false), intTypeId(intTypeId), val(0) {}
-	virtual std::string ToString() { return std::to_string(Value()); }
+	virtual void AppendTo(fmt::memory_buffer& out) { fmt::format_to(std::back_inserter(out), "{}", Value()); }
 	int64_t Value() const { return (intTypeId == dart::kSmiCid) ? val >> dart::kSmiTagSize : val; }
 
 	ValueType intTypeId;
@@ -121,7 +140,7 @@ struct VarInteger : public VarValue {
 struct VarDouble : public VarValue {
 	explicit VarDouble(double val, ValueType doubleTypeId = dart::kDoubleCid) : VarValue(dart::kDoubleCid, true), doubleTypeId(doubleTypeId), val(val) {}
 	explicit VarDouble(ValueType doubleTypeId = dart::kDoubleCid) : VarValue(dart::kDoubleCid, false), doubleTypeId(doubleTypeId), val(0.0) {}
-	virtual std::string ToString() { return std::to_string(val); }
+	virtual void AppendTo(fmt::memory_buffer& out) { fmt::format_to(std::back_inserter(out), "{:f}", val); } // same as std::to_string()
 
 	ValueType doubleTypeId;
 	double val;
@@ -130,21 +149,21 @@ struct VarDouble : public VarValue {
 struct VarString : public VarValue {
 	explicit VarString(std::string str) : VarValue(dart::kStringCid, true), str(std::move(str)) {}
 	explicit VarString() : VarValue(dart::kStringCid, false) {}
-	virtual std::string ToString() { return Util::UnescapeWithQuote(str.c_str()); }
+	virtual void AppendTo(fmt::memory_buffer& out) { Util::Append(out, Util::UnescapeWithQuote(str.c_str())); }
 
 	std::string str;
 };
 
 struct VarFunctionCode : public VarValue {
 	explicit VarFunctionCode(DartFnBase& fn) : VarValue(dart::kFunctionCid, true), fn(fn) {}
-	virtual std::string ToString() { return fn.FullName(); }
+	virtual void AppendTo(fmt::memory_buffer& out) { Util::Append(out, fn.FullName()); }
 
 	DartFnBase& fn;
 };
 
 struct VarField : public VarValue {
 	explicit VarField(DartField& field) : VarValue(dart::kFieldCid, true), field(field) {}
-	virtual std::string ToString() { return field.Name(); }
+	virtual void AppendTo(fmt::memory_buffer& out) { Util::Append(out, field.Name()); }
 
 	DartField& field;
 };
@@ -152,7 +171,7 @@ struct VarField : public VarValue {
 struct VarExpression : public VarValue {
 	explicit VarExpression(std::string txt) : VarValue(Expression, false), txt(std::move(txt)), cid(dart::kIllegalCid) {}
 	explicit VarExpression(std::string txt, ValueType cid) : VarValue(Expression, false), txt(std::move(txt)), cid(cid) {}
-	virtual std::string ToString() { return txt; }
+	virtual void AppendTo(fmt::memory_buffer& out) { Util::Append(out, txt); }
 	void SetText(std::string txt) { this->txt = std::move(txt); }
 	virtual ValueType TypeId() { return cid; }
 	void SetType(ValueType cid) { this->cid = cid; }
@@ -165,7 +184,7 @@ struct VarArray : public VarValue {
 	explicit VarArray(dart::ArrayPtr ptr) : VarValue(dart::kArrayCid, true), ptr(ptr), eleType(nullptr), length(-1) {}
 	explicit VarArray(DartAbstractType* eleType, int length = -1) : VarValue(dart::kArrayCid, false), ptr(dart::Object::null()), eleType(eleType), length(length) {}
 	explicit VarArray() : VarValue(dart::kArrayCid, false), ptr(dart::Object::null()), eleType(nullptr), length(-1) {}
-	virtual std::string ToString();
+	virtual void AppendTo(fmt::memory_buffer& out);
 	int64_t DataOffset() {
 		// TODO: typedArray has no type argument. so, offset is not the same
 		return dart::Array::data_offset();
@@ -190,7 +209,7 @@ struct VarArray : public VarValue {
 struct VarGrowableArray : public VarValue {
 	explicit VarGrowableArray(DartAbstractType* eleType) : VarValue(dart::kGrowableObjectArrayCid, false), eleType(eleType) {}
 	explicit VarGrowableArray() : VarValue(dart::kGrowableObjectArrayCid, false), eleType(nullptr) {}
-	virtual std::string ToString() { return "GrowableArray"; }
+	virtual void AppendTo(fmt::memory_buffer& out) { Util::Append(out, "GrowableArray"); }
 
 	int ElementSize() {
 		// TODO: typedArray has fixed size
@@ -214,7 +233,7 @@ struct VarGrowableArray : public VarValue {
 
 struct VarUnlinkedCall : public VarValue {
 	explicit VarUnlinkedCall(DartStub& stub) : VarValue(dart::kUnlinkedCallCid, true), stub(stub) {}
-	virtual std::string ToString() { return std::format("UnlinkedCall_{:#x}", stub.Address()); }
+	virtual void AppendTo(fmt::memory_buffer& out) { fmt::format_to(std::back_inserter(out), "UnlinkedCall_{:#x}", stub.Address()); }
 
 	DartStub& stub;
 };
@@ -224,7 +243,7 @@ struct VarInstance : public VarValue {
 	explicit VarInstance(DartClass* cls) : VarValue(dart::kInstanceCid, true), cls(cls) {}
 	explicit VarInstance() : VarValue(dart::kInstanceCid, false), cls(nullptr) {}
 	virtual ValueType TypeId() { return cls->Id(); }
-	virtual std::string ToString() { return std::format("Instance_{}", cls->Name()); }
+	virtual void AppendTo(fmt::memory_buffer& out) { fmt::format_to(std::back_inserter(out), "Instance_{}", cls->Name()); }
 
 	DartClass* cls;
 	//TODO: TypeArguments;
@@ -232,7 +251,7 @@ struct VarInstance : public VarValue {
 
 struct VarType : public VarValue {
 	explicit VarType(const DartType& type) : VarValue(dart::kTypeCid, true), type(type) {}
-	virtual std::string ToString() { return type.ToString(); }
+	virtual void AppendTo(fmt::memory_buffer& out) { type.AppendTo(out); }
 
 	const DartType& type;
 };
@@ -240,7 +259,7 @@ struct VarType : public VarValue {
 #ifdef HAS_RECORD_TYPE
 struct VarRecordType : public VarValue {
 	explicit VarRecordType(const DartRecordType& recordType) : VarValue(dart::kRecordTypeCid, true), recordType(recordType) {}
-	virtual std::string ToString() { return recordType.ToString(); }
+	virtual void AppendTo(fmt::memory_buffer& out) { recordType.AppendTo(out); }
 
 	const DartRecordType& recordType;
 };
@@ -248,21 +267,21 @@ struct VarRecordType : public VarValue {
 
 struct VarTypeParameter : public VarValue {
 	explicit VarTypeParameter(const DartTypeParameter& typeParam) : VarValue(dart::kTypeParameterCid, true), typeParam(typeParam) {}
-	virtual std::string ToString() { return typeParam.ToString(); }
+	virtual void AppendTo(fmt::memory_buffer& out) { typeParam.AppendTo(out); }
 
 	const DartTypeParameter& typeParam;
 };
 
 struct VarFunctionType : public VarValue {
 	explicit VarFunctionType(const DartFunctionType& fnType) : VarValue(dart::kFunctionTypeCid, true), fnType(fnType) {}
-	virtual std::string ToString() { return fnType.ToString(); }
+	virtual void AppendTo(fmt::memory_buffer& out) { fnType.AppendTo(out); }
 
 	const DartFunctionType& fnType;
 };
 
 struct VarTypeArgument : public VarValue {
 	explicit VarTypeArgument(const DartTypeArguments& typeArgs) : VarValue(dart::kTypeArgumentsCid, true), typeArgs(typeArgs) {}
-	virtual std::string ToString() { return typeArgs.ToString(); }
+	virtual void AppendTo(fmt::memory_buffer& out) { typeArgs.AppendTo(out); }
 
 	const DartTypeArguments& typeArgs;
 };
@@ -270,12 +289,12 @@ struct VarTypeArgument : public VarValue {
 // uninitialized object in dart
 struct VarSentinel : public VarValue {
 	explicit VarSentinel() : VarValue(dart::kSentinelCid, false) {}
-	virtual std::string ToString() { return "Sentinel"; }
+	virtual void AppendTo(fmt::memory_buffer& out) { Util::Append(out, "Sentinel"); }
 };
 
 struct VarSubtypeTestCache : public VarValue {
 	explicit VarSubtypeTestCache() : VarValue(dart::kSubtypeTestCacheCid, false) {}
-	virtual std::string ToString() { return "SubtypeTestCache"; }
+	virtual void AppendTo(fmt::memory_buffer& out) { Util::Append(out, "SubtypeTestCache"); }
 };
 
 // A special integer type to represent class id
@@ -283,7 +302,12 @@ struct VarSubtypeTestCache : public VarValue {
 struct VarCid : public VarValue {
 	explicit VarCid(int cid, bool isSmi) : VarValue(dart::kClassCid, cid != 0), isSmi(isSmi), cid(cid) {}
 	explicit VarCid() : VarValue(dart::kClassCid, false), isSmi(false), cid(0) {}
-	virtual std::string ToString() { return isSmi ? std::format("TaggedCid_{}", cid >> dart::kSmiTagSize) : std::format("cid_{}", cid); }
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		if (isSmi)
+			fmt::format_to(std::back_inserter(out), "TaggedCid_{}", cid >> dart::kSmiTagSize);
+		else
+			fmt::format_to(std::back_inserter(out), "cid_{}", cid);
+	}
 
 	bool isSmi;
 	int cid;
@@ -297,11 +321,11 @@ struct VarParam : public VarValue {
 struct VarItem {
 	explicit VarItem() : storage(VarStorage::Uninit) {}
 	explicit VarItem(VarStorage storage) : storage(storage) {}
-	explicit VarItem(VarStorage storage, std::unique_ptr<VarValue> val) : storage(storage), val(std::move(val)) {}
-	explicit VarItem(VarStorage storage, VarValue* val) : storage(storage), val(std::unique_ptr<VarValue>(val)) {}
+	explicit VarItem(VarStorage storage, VarValuePtr val) : storage(storage), val(std::move(val)) {}
+	explicit VarItem(VarStorage storage, VarValue* val) : storage(storage), val(VarValuePtr(val)) {}
 	// register storage is common and also special type
-	explicit VarItem(A64::Register reg, std::unique_ptr<VarValue> val) : storage(VarStorage(reg)), val(std::move(val)) {}
-	explicit VarItem(A64::Register reg, VarValue* val) : storage(VarStorage(reg)), val(std::unique_ptr<VarValue>(val)) {}
+	explicit VarItem(A64::Register reg, VarValuePtr val) : storage(VarStorage(reg)), val(std::move(val)) {}
+	explicit VarItem(A64::Register reg, VarValue* val) : storage(VarStorage(reg)), val(VarValuePtr(val)) {}
 
 	VarStorage Storage() const { return storage; }
 	std::string StorageName() { return storage.Name(); }
@@ -309,7 +333,7 @@ struct VarItem {
 	template <typename T, typename = std::enable_if<std::is_base_of<VarValue, T>::value>>
 	T* Get() const { return reinterpret_cast<T*>(val.get()); }
 	VarValue* Value() const { return val.get(); }
-	std::unique_ptr<VarValue> TakeValue() { return std::move(val); }
+	VarValuePtr TakeValue() { return std::move(val); }
 	std::string ValueString() const { return val ? val->ToString() : "BUG_NO_ASSIGN_VALUE"; }
 	ValueType ValueTypeId() const { return val->RawTypeId(); }
 	VarItem* MoveTo(VarStorage storage) { return new VarItem(storage, std::move(val)); }
@@ -317,9 +341,22 @@ struct VarItem {
 
 	// TODO: more clever name or value when it is known type
 	std::string Name();
+	void AppendName(fmt::memory_buffer& out);
 	std::string CallArgName();
 
 	VarStorage storage;
 	//VarType type;
-	std::unique_ptr<VarValue> val;
+	VarValuePtr val;
+};
+
+// shared immutable values for common constants. an analyzed IL just references them instead of allocating a new value
+class VarConstants {
+public:
+	static VarValue* Null();
+	static VarValue* Boolean(bool val);
+	// shared value for small integer. a new value for others
+	static VarValue* Integer(int64_t val, ValueType intTypeId);
+
+	static constexpr int64_t kMinSharedInt = -128;
+	static constexpr int64_t kMaxSharedInt = 1024;
 };
@@ -2,15 +2,63 @@
 #include "il.h"
 #include "CodeAnalyzer.h"
 #include "DartThreadInfo.h"
+#include "DartApp.h"
 
-std::string SetupParametersInstr::ToString()
+thread_local ILArena* ILArena::current = nullptr;
+
+void* ILArena::Allocate(size_t size)
+{
+	// no IL class has over-aligned member
+	size = (size + alignof(void*) - 1) & ~(alignof(void*) - 1);
+	if ((size_t)(end - ptr) < size) {
+		// grow block size for big functions, so small functions do not waste much memory
+		const auto blockSize = std::max(nextBlockSize, size);
+		blocks.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[blockSize]));
+		ptr = blocks.back().get();
+		end = ptr + blockSize;
+		bytesReserved += blockSize;
+		nextBlockSize = std::min(nextBlockSize * 2, kMaxBlockSize);
+	}
+
+	auto mem = ptr;
+	ptr += size;
+	numAllocs++;
+	// approximate glibc malloc chunk size (8 bytes header, 16 bytes alignment, 32 bytes minimum)
+	heapBytesEstimate += std::max<size_t>(32, (size + 8 + 15) & ~(size_t)15);
+	return mem;
+}
+
+void SetupParametersInstr::AppendTo(fmt::memory_buffer& out)
 {
-	return "SetupParameters(" + params->ToString() + ")";
+	Util::Append(out, "SetupParameters(");
+	params->AppendTo(out);
+	out.push_back(')');
 }
 
-std::string CallLeafRuntimeInstr::ToString()
+void GdtCallInstr::AppendTo(fmt::memory_buffer& out)
+{
+	fmt::format_to(std::back_inserter(out), "r0 = GDT[cid_x0 + {:#x}]()", offset);
+	if (targets.empty())
+		return;
+
+	// too many targets are not useful. show only first few of them
+	constexpr size_t maxShown = 3;
+	if (targets.size() == 1)
+		Util::Append(out, " -> ");
+	else
+		fmt::format_to(std::back_inserter(out), " -> {} targets: ", targets.size());
+	for (size_t i = 0; i < std::min(targets.size(), maxShown); i++) {
+		if (i != 0)
+			Util::Append(out, ", ");
+		Util::Append(out, targets[i]->FullName());
+	}
+	if (targets.size() > maxShown)
+		Util::Append(out, ", ...");
+}
+
+void CallLeafRuntimeInstr::AppendTo(fmt::memory_buffer& out)
 {
 	const auto& name = GetThreadOffsetName(thrOffset);
 	const auto info = GetThreadLeafFunction(thrOffset);
-	return std::format("CallRuntime_{}({}) -> {}", name, info->params, info->returnType);
-}
\ No newline at end of file
+	fmt::format_to(std::back_inserter(out), "CallRuntime_{}({}) -> {}", name, info->params, info->returnType);
+}
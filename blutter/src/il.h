@@ -1,10 +1,54 @@
 #pragma once
 #include "Disassembler.h"
 #include "VarValue.h"
+#include <span>
 
 // forward declaration
 struct AsmText;
 struct FnParams;
+class DartFunction;
+
+// bump allocator for ILs of one function. memory of all ILs is released at once with the arena
+class ILArena {
+public:
+	ILArena() {}
+	ILArena(const ILArena&) = delete;
+	ILArena& operator=(const ILArena&) = delete;
+
+	void* Allocate(size_t size);
+
+	size_t NumAllocs() const { return numAllocs; }
+	// bytes taken from heap (including unused space at the end of blocks)
+	size_t BytesReserved() const { return bytesReserved; }
+	// estimated heap bytes if each IL is allocated separately
+	size_t HeapBytesEstimate() const { return heapBytesEstimate; }
+
+	// ILs are created in the arena of current thread
+	static ILArena* Current() { return current; }
+	class Scope {
+	public:
+		explicit Scope(ILArena& arena) : prev(current) { current = &arena; }
+		~Scope() { current = prev; }
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		ILArena* prev;
+	};
+
+private:
+	static constexpr size_t kMinBlockSize = 256;
+	static constexpr size_t kMaxBlockSize = 64 * 1024;
+
+	std::vector<std::unique_ptr<uint8_t[]>> blocks;
+	uint8_t* ptr{ nullptr };
+	uint8_t* end{ nullptr };
+	size_t nextBlockSize{ kMinBlockSize };
+	size_t numAllocs{ 0 };
+	size_t bytesReserved{ 0 };
+	size_t heapBytesEstimate{ 0 };
+
+	static thread_local ILArena* current;
+};
 
 class ILInstr {
 public:
@@ -41,6 +85,7 @@ public:
 		StoreStaticField,
 		WriteBarrier,
 		TestType,
+		Cached, // loaded from analysis cache (only text)
 	};
 
 	ILInstr(const ILInstr&) = delete;
@@ -48,8 +93,25 @@ public:
 	ILInstr& operator=(const ILInstr&) = delete;
 	virtual ~ILInstr() {}
 
-	virtual std::string ToString() = 0;
+	// IL memory is owned by ILArena. deleting an IL only calls its destructor
+	static void* operator new(size_t size) {
+		auto arena = ILArena::Current();
+		if (arena == nullptr)
+			FATAL("IL must be created inside ILArena::Scope");
+		return arena->Allocate(size);
+	}
+	static void operator delete(void*) {}
+
+	std::string ToString() {
+		fmt::memory_buffer out;
+		AppendTo(out);
+		return fmt::to_string(out);
+	}
+	// render IL at the end of buffer without temporary string
+	virtual void AppendTo(fmt::memory_buffer& out) = 0;
 	ILKind Kind() const { return kind; }
+	// kind from the analysis. it is different from Kind() only for IL from analysis cache
+	virtual ILKind OriginalKind() const { return kind; }
 	uint64_t Start() const { return addrRange.start; }
 	uint64_t End() const { return addrRange.end; }
 	AddrRange Range() const { return addrRange; }
@@ -69,14 +131,35 @@ public:
 	UnknownInstr(UnknownInstr&&) = delete;
 	UnknownInstr& operator=(const UnknownInstr&) = delete;
 
-	virtual std::string ToString() {
-		return "unknown";
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, "unknown");
 	}
 
 protected:
 	AsmText& asm_text;
 };
 
+// IL from analysis cache of previous run. only the text, address range and original kind are kept.
+//   Kind() is Unknown or Cached because there is no data of the original IL class
+class CachedInstr : public ILInstr {
+public:
+	// kind must be Unknown or Cached. originalKind is the kind of IL when it was analyzed
+	CachedInstr(ILKind kind, AddrRange addrRange, std::string text, ILKind originalKind)
+		: ILInstr(kind, addrRange), text(std::move(text)), originalKind(originalKind) {}
+	CachedInstr() = delete;
+	CachedInstr(CachedInstr&&) = delete;
+	CachedInstr& operator=(const CachedInstr&) = delete;
+
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, text);
+	}
+	virtual ILKind OriginalKind() const { return originalKind; }
+
+protected:
+	std::string text;
+	ILKind originalKind;
+};
+
 class EnterFrameInstr : public ILInstr {
 public:
 	// 2 assembly instructions (stp lr, fp, [sp, 8]!; mov fp, sp)
@@ -85,8 +168,8 @@ public:
 	EnterFrameInstr(EnterFrameInstr&&) = delete;
 	EnterFrameInstr& operator=(const EnterFrameInstr&) = delete;
 
-	virtual std::string ToString() {
-		return "EnterFrame";
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, "EnterFrame");
 	}
 };
 
@@ -97,8 +180,8 @@ public:
 	LeaveFrameInstr(LeaveFrameInstr&&) = delete;
 	LeaveFrameInstr& operator=(const LeaveFrameInstr&) = delete;
 
-	virtual std::string ToString() {
-		return "LeaveFrame";
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, "LeaveFrame");
 	}
 };
 
@@ -109,8 +192,8 @@ public:
 	AllocateStackInstr(AllocateStackInstr&&) = delete;
 	AllocateStackInstr& operator=(const AllocateStackInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("AllocStack({:#x})", allocSize);
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "AllocStack({:#x})", allocSize);
 	}
 	uint32_t AllocSize() { return allocSize; }
 
@@ -126,8 +209,8 @@ public:
 	CheckStackOverflowInstr(CheckStackOverflowInstr&&) = delete;
 	CheckStackOverflowInstr& operator=(const CheckStackOverflowInstr&) = delete;
 
-	virtual std::string ToString() {
-		return "CheckStackOverflow";
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, "CheckStackOverflow");
 	}
 
 protected:
@@ -141,8 +224,8 @@ public:
 	MoveRegInstr(MoveRegInstr&&) = delete;
 	MoveRegInstr& operator=(const MoveRegInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("{} = {}", dstReg.Name(), srcReg.Name());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "{} = {}", dstReg.Name(), srcReg.Name());
 	}
 
 	A64::Register dstReg;
@@ -158,7 +241,7 @@ public:
 	CallLeafRuntimeInstr(CallLeafRuntimeInstr&&) = delete;
 	CallLeafRuntimeInstr& operator=(const CallLeafRuntimeInstr&) = delete;
 
-	virtual std::string ToString();
+	virtual void AppendTo(fmt::memory_buffer& out);
 
 	int32_t thrOffset;
 	std::vector<std::unique_ptr<MoveRegInstr>> movILs;
@@ -171,8 +254,10 @@ public:
 	LoadValueInstr(LoadValueInstr&&) = delete;
 	LoadValueInstr& operator=(const LoadValueInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::string(dstReg.Name()) + " = " + val.Name();
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, dstReg.Name());
+		Util::Append(out, " = ");
+		val.AppendName(out);
 	}
 
 	VarItem& GetValue() {
@@ -190,8 +275,8 @@ public:
 	ClosureCallInstr(ClosureCallInstr&&) = delete;
 	ClosureCallInstr& operator=(const ClosureCallInstr&) = delete;
 
-	virtual std::string ToString() {
-		return "ClosureCall";
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, "ClosureCall");
 	}
 
 	int32_t numArg;
@@ -205,8 +290,9 @@ public:
 	DecompressPointerInstr(DecompressPointerInstr&&) = delete;
 	DecompressPointerInstr& operator=(const DecompressPointerInstr&) = delete;
 
-	virtual std::string ToString() {
-		return "DecompressPointer " + dst.Name();
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, "DecompressPointer ");
+		dst.AppendName(out);
 	}
 
 protected:
@@ -220,8 +306,9 @@ public:
 	SaveRegisterInstr(SaveRegisterInstr&&) = delete;
 	SaveRegisterInstr& operator=(const SaveRegisterInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::string("SaveReg ") + srcReg.Name();
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, "SaveReg ");
+		Util::Append(out, srcReg.Name());
 	}
 
 protected:
@@ -235,8 +322,9 @@ public:
 	RestoreRegisterInstr(RestoreRegisterInstr&&) = delete;
 	RestoreRegisterInstr& operator=(const RestoreRegisterInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::string("RestoreReg ") + dstReg.Name();
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, "RestoreReg ");
+		Util::Append(out, dstReg.Name());
 	}
 
 protected:
@@ -250,7 +338,7 @@ public:
 	SetupParametersInstr(SetupParametersInstr&&) = delete;
 	SetupParametersInstr& operator=(const SetupParametersInstr&) = delete;
 
-	virtual std::string ToString();
+	virtual void AppendTo(fmt::memory_buffer& out);
 
 	FnParams* params;
 };
@@ -262,8 +350,9 @@ public:
 	InitAsyncInstr(InitAsyncInstr&&) = delete;
 	InitAsyncInstr& operator=(const InitAsyncInstr&) = delete;
 
-	virtual std::string ToString() {
-		return "InitAsync() -> " + retType->ToString();
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, "InitAsync() -> ");
+		retType->AppendTo(out);
 	}
 
 protected:
@@ -272,17 +361,21 @@ protected:
 
 class GdtCallInstr : public ILInstr {
 public:
-	GdtCallInstr(AddrRange addrRange, int64_t offset) : ILInstr(GdtCall, addrRange), offset(offset) {}
+	GdtCallInstr(AddrRange addrRange, int64_t offset, std::span<DartFunction* const> targets)
+		: ILInstr(GdtCall, addrRange), offset(offset), targets(targets) {}
 	GdtCallInstr() = delete;
 	GdtCallInstr(GdtCallInstr&&) = delete;
 	GdtCallInstr& operator=(const GdtCallInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("r0 = GDT[cid_x0 + {:#x}]()", offset);
-	}
+	virtual void AppendTo(fmt::memory_buffer& out);
+
+	int64_t Offset() const { return offset; }
+	std::span<DartFunction* const> Targets() const { return targets; }
 
 protected:
 	int64_t offset;
+	// possible targets from dispatch table (owned by DartApp)
+	std::span<DartFunction* const> targets;
 };
 
 class CallInstr : public ILInstr {
@@ -292,10 +385,11 @@ public:
 	CallInstr(CallInstr&&) = delete;
 	CallInstr& operator=(const CallInstr&) = delete;
 
-	virtual std::string ToString() {
+	virtual void AppendTo(fmt::memory_buffer& out) {
 		if (fnBase != nullptr)
-			return std::format("r0 = {}()", fnBase->Name());
-		return std::format("r0 = call {:#x}", addr);
+			fmt::format_to(std::back_inserter(out), "r0 = {}()", fnBase->Name());
+		else
+			fmt::format_to(std::back_inserter(out), "r0 = call {:#x}", addr);
 	}
 
 	DartFnBase* GetFunction() {
@@ -318,8 +412,8 @@ public:
 	ReturnInstr(ReturnInstr&&) = delete;
 	ReturnInstr& operator=(const ReturnInstr&) = delete;
 
-	virtual std::string ToString() {
-		return "ret";
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		Util::Append(out, "ret");
 	}
 };
 
@@ -330,8 +424,8 @@ public:
 	BranchIfSmiInstr(BranchIfSmiInstr&&) = delete;
 	BranchIfSmiInstr& operator=(const BranchIfSmiInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("branchIfSmi({}, {:#x})", objReg.Name(), branchAddr);
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "branchIfSmi({}, {:#x})", objReg.Name(), branchAddr);
 	}
 
 	A64::Register objReg;
@@ -345,8 +439,8 @@ public:
 	LoadClassIdInstr(LoadClassIdInstr&&) = delete;
 	LoadClassIdInstr& operator=(const LoadClassIdInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("{} = LoadClassIdInstr({})", cidReg.Name(), objReg.Name());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "{} = LoadClassIdInstr({})", cidReg.Name(), objReg.Name());
 	}
 
 	A64::Register objReg;
@@ -363,8 +457,8 @@ public:
 	LoadTaggedClassIdMayBeSmiInstr(LoadTaggedClassIdMayBeSmiInstr&&) = delete;
 	LoadTaggedClassIdMayBeSmiInstr& operator=(const LoadTaggedClassIdMayBeSmiInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("{} = LoadTaggedClassIdMayBeSmiInstr({})", taggedCidReg.Name(), objReg.Name());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "{} = LoadTaggedClassIdMayBeSmiInstr({})", taggedCidReg.Name(), objReg.Name());
 	}
 
 	A64::Register taggedCidReg;
@@ -381,8 +475,8 @@ public:
 	BoxInt64Instr(BoxInt64Instr&&) = delete;
 	BoxInt64Instr& operator=(const BoxInt64Instr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("{} = BoxInt64Instr({})", objReg.Name(), srcReg.Name());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "{} = BoxInt64Instr({})", objReg.Name(), srcReg.Name());
 	}
 
 	A64::Register objReg;
@@ -396,8 +490,8 @@ public:
 	LoadInt32Instr(LoadInt32Instr&&) = delete;
 	LoadInt32Instr& operator=(const LoadInt32Instr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("{} = LoadInt32Instr({})", dstReg.Name(), srcObjReg.Name());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "{} = LoadInt32Instr({})", dstReg.Name(), srcObjReg.Name());
 	}
 
 	A64::Register dstReg;
@@ -412,8 +506,8 @@ public:
 	AllocateObjectInstr(AllocateObjectInstr&&) = delete;
 	AllocateObjectInstr& operator=(const AllocateObjectInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("{} = inline_Allocate{}()", dstReg.Name(), dartCls.Name());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "{} = inline_Allocate{}()", dstReg.Name(), dartCls.Name());
 	}
 
 	A64::Register dstReg;
@@ -442,14 +536,14 @@ struct ArrayOp {
 		if (size == 2) return 1;
 		return 0;
 	}
-	std::string ToString() {
+	void AppendTo(fmt::memory_buffer& out) {
 		switch (arrType) {
-		case List: return std::format("List_{}", size);
-		case TypedUnknown: return std::format("TypeUnknown_{}", size);
-		case TypedSigned: return std::format("TypedSigned_{}", size);
-		case TypedUnsigned: return std::format("TypedUnsigned_{}", size);
-		case Unknown: return std::format("Unknown_{}", size);
-		default: return "";
+		case List: fmt::format_to(std::back_inserter(out), "List_{}", size); break;
+		case TypedUnknown: fmt::format_to(std::back_inserter(out), "TypeUnknown_{}", size); break;
+		case TypedSigned: fmt::format_to(std::back_inserter(out), "TypedSigned_{}", size); break;
+		case TypedUnsigned: fmt::format_to(std::back_inserter(out), "TypedUnsigned_{}", size); break;
+		case Unknown: fmt::format_to(std::back_inserter(out), "Unknown_{}", size); break;
+		default: break;
 		}
 	}
 };
@@ -462,8 +556,11 @@ public:
 	LoadArrayElementInstr(LoadArrayElementInstr&&) = delete;
 	LoadArrayElementInstr& operator=(const LoadArrayElementInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("ArrayLoad: {} = {}[{}]  ; {}", dstReg.Name(), arrReg.Name(), idx.Name(), arrayOp.ToString());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "ArrayLoad: {} = {}[", dstReg.Name(), arrReg.Name());
+		idx.AppendName(out);
+		Util::Append(out, "]  ; ");
+		arrayOp.AppendTo(out);
 	}
 
 	A64::Register dstReg;
@@ -480,8 +577,11 @@ public:
 	StoreArrayElementInstr(StoreArrayElementInstr&&) = delete;
 	StoreArrayElementInstr& operator=(const StoreArrayElementInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("ArrayStore: {}[{}] = {}  ; {}", arrReg.Name(), idx.Name(), valReg.Name(), arrayOp.ToString());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "ArrayStore: {}[", arrReg.Name());
+		idx.AppendName(out);
+		fmt::format_to(std::back_inserter(out), "] = {}  ; ", valReg.Name());
+		arrayOp.AppendTo(out);
 	}
 
 	A64::Register valReg;
@@ -498,8 +598,8 @@ public:
 	LoadFieldInstr(LoadFieldInstr&&) = delete;
 	LoadFieldInstr& operator=(const LoadFieldInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("LoadField: {} = {}->field_{:x}", dstReg.Name(), objReg.Name(), offset);
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "LoadField: {} = {}->field_{:x}", dstReg.Name(), objReg.Name(), offset);
 	}
 
 	A64::Register dstReg;
@@ -517,8 +617,8 @@ public:
 	StoreFieldInstr(StoreFieldInstr&&) = delete;
 	StoreFieldInstr& operator=(const StoreFieldInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("StoreField: {}->field_{:x} = {}", objReg.Name(), offset, valReg.Name());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "StoreField: {}->field_{:x} = {}", objReg.Name(), offset, valReg.Name());
 	}
 
 	A64::Register valReg;
@@ -535,14 +635,17 @@ public:
 	InitLateStaticFieldInstr(InitLateStaticFieldInstr&&) = delete;
 	InitLateStaticFieldInstr& operator=(const InitLateStaticFieldInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("{} = InitLateStaticField({:#x}) // {}", dst.Name(), field.Offset(), field.FullName());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		dst.AppendName(out);
+		fmt::format_to(std::back_inserter(out), " = InitLateStaticField({:#x}) // {}", field.Offset(), field.FullName());
 	}
 
 	std::string ValueExpression() {
 		return field.Name();
 	}
 
+	DartField& Field() { return field; }
+
 protected:
 	VarStorage dst;
 	DartField& field;
@@ -556,10 +659,12 @@ public:
 	LoadStaticFieldInstr(LoadStaticFieldInstr&&) = delete;
 	LoadStaticFieldInstr& operator=(const LoadStaticFieldInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("{} = LoadStaticField({:#x})", dstReg.Name(), fieldOffset);
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "{} = LoadStaticField({:#x})", dstReg.Name(), fieldOffset);
 	}
 
+	uint32_t FieldOffset() const { return fieldOffset; }
+
 protected:
 	A64::Register dstReg;
 	uint32_t fieldOffset;
@@ -568,15 +673,17 @@ protected:
 class StoreStaticFieldInstr : public ILInstr {
 public:
 	StoreStaticFieldInstr(AddrRange addrRange, A64::Register valReg, uint32_t fieldOffset)
-		: ILInstr(LoadStaticField, addrRange), valReg(valReg), fieldOffset(fieldOffset) {}
+		: ILInstr(StoreStaticField, addrRange), valReg(valReg), fieldOffset(fieldOffset) {}
 	StoreStaticFieldInstr() = delete;
 	StoreStaticFieldInstr(StoreStaticFieldInstr&&) = delete;
 	StoreStaticFieldInstr& operator=(const StoreStaticFieldInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("StoreStaticField({:#x}, {})", fieldOffset, valReg.Name());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "StoreStaticField({:#x}, {})", fieldOffset, valReg.Name());
 	}
 
+	uint32_t FieldOffset() const { return fieldOffset; }
+
 protected:
 	A64::Register valReg;
 	uint32_t fieldOffset;
@@ -590,8 +697,8 @@ public:
 	WriteBarrierInstr(WriteBarrierInstr&&) = delete;
 	WriteBarrierInstr& operator=(const WriteBarrierInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("{}WriteBarrierInstr(obj = {}, val = {})", isArray ? "Array" : "", objReg.Name(), valReg.Name());
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "{}WriteBarrierInstr(obj = {}, val = {})", isArray ? "Array" : "", objReg.Name(), valReg.Name());
 	}
 
 	A64::Register objReg;
@@ -607,8 +714,8 @@ public:
 	TestTypeInstr(TestTypeInstr&&) = delete;
 	TestTypeInstr& operator=(const TestTypeInstr&) = delete;
 
-	virtual std::string ToString() {
-		return std::format("{} as {}", srcReg.Name(), typeName);
+	virtual void AppendTo(fmt::memory_buffer& out) {
+		fmt::format_to(std::back_inserter(out), "{} as {}", srcReg.Name(), typeName);
 	}
 
 	A64::Register srcReg;
@@ -3,23 +3,182 @@
 #include "DartDumper.h"
 #include "CodeAnalyzer.h"
 #include "FridaWriter.h"
+#include "A64Decoder.h"
+#include "PackageSignatures.h"
+#include "CallGraph.h"
+#include "PoolXrefs.h"
+#include "FieldXrefs.h"
+#include "AsmIndex.h"
+#include "AnalysisDbWriter.h"
+#include "ArchiveWriter.h"
+#include "OutputSink.h"
+#include "OutputManifest.h"
 #include "args.hxx"
 #include <filesystem>
+#include <thread>
+
+// function is an address (with 0x prefix) or full name
+static uint32_t findCallGraphNode(const CallGraph& graph, const std::string& fn)
+{
+	const auto node = fn.starts_with("0x") ? graph.FindNode(std::stoull(fn, nullptr, 16)) : graph.FindNode(fn);
+	if (node == CallGraph::UnknownNode)
+		throw std::runtime_error(std::format("function {} is not in call graph", fn));
+	return node;
+}
+
+static void printCallGraphEdges(const CallGraph& graph, std::span<const CallGraph::Edge> edges)
+{
+	for (const auto& edge : edges) {
+		if (edge.node == CallGraph::UnknownNode)
+			std::cout << std::format("  {:<8}  ?\n", CallGraph::KindName(edge.kind));
+		else
+			std::cout << std::format("  {:<8}  {:#x}  {}\n", CallGraph::KindName(edge.kind), graph.Address(edge.node), graph.Name(edge.node));
+	}
+}
+
+static void printPoolXrefs(const PoolXrefs& xrefs, const CallGraph* graph, uint32_t idx)
+{
+	std::cout << std::format("[pp+{:#x}] {}\n", dart::ObjectPool::OffsetFromIndex(idx), xrefs.Text(idx));
+	for (const auto& ref : xrefs.Refs(idx)) {
+		const auto node = graph ? graph->FindNode(ref.fnAddr) : CallGraph::UnknownNode;
+		if (node != CallGraph::UnknownNode)
+			std::cout << std::format("  {:#x}  {}\n", ref.addr, graph->Name(node));
+		else
+			std::cout << std::format("  {:#x}  in function {:#x}\n", ref.addr, ref.fnAddr);
+	}
+}
+
+static void printFieldXrefs(const FieldXrefs& xrefs, const CallGraph* graph, uint32_t idx)
+{
+	std::cout << std::format("{}\n", xrefs.Name(idx));
+	for (const auto& access : xrefs.Accesses(idx)) {
+		const auto node = graph ? graph->FindNode(access.fnAddr) : CallGraph::UnknownNode;
+		const auto kind = access.isStore ? "write" : "read";
+		if (node != CallGraph::UnknownNode)
+			std::cout << std::format("  {:<5}  {:#x}  {}\n", kind, access.addr, graph->Name(node));
+		else
+			std::cout << std::format("  {:<5}  {:#x}  in function {:#x}\n", kind, access.addr, access.fnAddr);
+	}
+}
+
+static void printFunctionAsm(const AsmIndex& index, uint32_t idx)
+{
+	const auto& cls = index.ClassAt(index.At(idx).cls);
+	std::cout << std::format("// {} (class {} in {})\n", index.FunctionName(idx), index.ClassName(index.At(idx).cls), index.FilePath(cls.file));
+	std::cout << index.ReadText(idx);
+}
 
 int main(int argc, char** argv)
 {
 	args::ArgumentParser parser("B(l)utter - Reversing flutter application", "");
 	args::HelpFlag help(parser, "help", "Display this help menu", { 'h', "help" });
-	args::Group reqGrp(parser, "Required arguments", args::Group::Validators::All);
+	// infile is not needed for queries. it is checked after parsing
+	args::Group reqGrp(parser, "Required arguments", args::Group::Validators::DontCare);
 	args::ValueFlag<std::string> infile(reqGrp, "infile", "libapp file", { 'i', "in" });
 	args::ValueFlag<std::string> outdir(reqGrp, "outdir", "out path", { 'o', "out"});
+	args::Flag benchDecoder(parser, "bench-decoder", "Compare native instruction decoder throughput against capstone, then exit", { "bench-decoder" });
+	args::Flag disasmAll(parser, "disasm-all", "Disassemble whole code once and share it for analysis and dumping (faster but keeps a full capstone instruction and detail of every instruction in memory)", { "disasm-all" });
+	args::ValueFlag<unsigned int> dumpThreads(parser, "count", "Number of threads for generating asm files. 0 for all CPU cores (default: 1)", { "dump-threads" });
+	args::ValueFlag<int> benchAnalysis(parser, "count", "Print analysis cost (value tracking with branches) of the largest functions", { "bench-analysis" });
+	args::ValueFlag<std::string> analysisCache(parser, "file", "Reuse analysis results of unchanged functions from previous run (the file is created if not exist)", { "analysis-cache" });
+	args::ValueFlag<std::string> sigDb(parser, "file", "Known package signatures. libraries that match a signature are marked in output", { "sigdb" });
+	args::ValueFlag<std::string> sigDbAdd(parser, "label", "Add package libraries of this app to the signatures file of --sigdb with label (e.g. app name and version)", { "sigdb-add" });
+	args::Flag skipKnown(parser, "skip-known", "Do not analyze libraries that match known package signatures of --sigdb (only disassemble)", { "skip-known" });
+	args::ValueFlag<size_t> typedDataLimit(parser, "count", "Show at most count elements of typed data in pp.txt, objs.txt and asm (default: all)", { "typed-data-limit" });
+	args::ValueFlag<std::string> archiveName(parser, "name", "Write text outputs (asm, pp.txt, objs.txt, ida_script, blutter_frida.js) into one zip file in outdir instead of separate files", { "archive" });
+	args::Flag analysisDb(parser, "analysis-db", "Write all loaded and analyzed information to analysis.db for other tools (read with AnalysisDb.h)", { "analysis-db" });
+	args::Flag incremental(parser, "incremental", "Write only text outputs that are changed from previous run in outdir", { "incremental" });
+	args::ValueFlag<size_t> typedDataBin(parser, "bytes", "Write typed data of at least bytes size to typed_data folder as raw .bin files instead of text", { "typed-data-bin" });
+	args::Group queryGrp(parser, "Queries on output of previous run (only outdir is needed). function is 0x<address> or full name");
+	args::ValueFlag<std::string> qCallers(queryGrp, "function", "Show callers of the function", { "callers" });
+	args::ValueFlag<std::string> qCallees(queryGrp, "function", "Show callees of the function", { "callees" });
+	args::ValueFlag<std::string> qReachable(queryGrp, "function", "Show all functions that can be reached from the function", { "reachable" });
+	args::ValueFlag<std::string> qPoolXrefs(queryGrp, "offset", "Show instructions that load the object pool entry (offset in [pp+offset])", { "pool-xrefs" });
+	args::ValueFlag<std::string> qStringXrefs(queryGrp, "text", "Show instructions that load the strings containing the text", { "string-xrefs" });
+	args::ValueFlag<std::string> qFieldXrefs(queryGrp, "field", "Show instructions that read or write the field (full name \"[url] Class::field\" or Class.field for all matches)", { "field-xrefs" });
+	args::ValueFlag<std::string> qAsm(queryGrp, "function", "Show asm of the function", { "asm" });
 
 	try {
 		parser.ParseCLI(argc, argv);
 
+		if (!outdir)
+			throw args::ValidationError("outdir is required");
+		std::filesystem::path outDir{ args::get(outdir) };
+
+		if (qCallers || qCallees || qReachable) {
+			CallGraph graph{ outDir / "callgraph.bin" };
+			if (qCallers) {
+				const auto node = findCallGraphNode(graph, args::get(qCallers));
+				std::cout << std::format("Callers of {}\n", graph.Name(node));
+				printCallGraphEdges(graph, graph.Callers(node));
+			}
+			if (qCallees) {
+				const auto node = findCallGraphNode(graph, args::get(qCallees));
+				std::cout << std::format("Callees of {}\n", graph.Name(node));
+				printCallGraphEdges(graph, graph.Callees(node));
+			}
+			if (qReachable) {
+				const auto node = findCallGraphNode(graph, args::get(qReachable));
+				const auto reachable = graph.Reachable(node);
+				std::cout << std::format("{} functions are reachable from {}\n", reachable.size(), graph.Name(node));
+				for (auto n : reachable)
+					std::cout << std::format("  {:#x}  {}\n", graph.Address(n), graph.Name(n));
+			}
+		}
+		if (qPoolXrefs || qStringXrefs) {
+			PoolXrefs xrefs{ outDir / "poolxrefs.bin" };
+			// function names are from call graph
+			std::unique_ptr<CallGraph> graph;
+			if (std::filesystem::exists(outDir / "callgraph.bin"))
+				graph = std::make_unique<CallGraph>(outDir / "callgraph.bin");
+			if (qPoolXrefs) {
+				const auto idx = dart::ObjectPool::IndexFromOffset(std::stoll(args::get(qPoolXrefs), nullptr, 0));
+				if (idx < 0 || idx >= xrefs.NumEntries())
+					throw std::runtime_error(std::format("invalid pool offset {}", args::get(qPoolXrefs)));
+				printPoolXrefs(xrefs, graph.get(), (uint32_t)idx);
+			}
+			if (qStringXrefs) {
+				for (auto idx : xrefs.FindStrings(args::get(qStringXrefs)))
+					printPoolXrefs(xrefs, graph.get(), idx);
+			}
+		}
+		if (qFieldXrefs) {
+			FieldXrefs xrefs{ outDir / "fieldxrefs.bin" };
+			std::unique_ptr<CallGraph> graph;
+			if (std::filesystem::exists(outDir / "callgraph.bin"))
+				graph = std::make_unique<CallGraph>(outDir / "callgraph.bin");
+			const auto found = xrefs.FindFields(args::get(qFieldXrefs));
+			if (found.empty())
+				throw std::runtime_error(std::format("field {} is not found", args::get(qFieldXrefs)));
+			for (auto idx : found)
+				printFieldXrefs(xrefs, graph.get(), idx);
+		}
+		if (qAsm) {
+			AsmIndex index{ outDir / "asm.idx" };
+			const auto& fn = args::get(qAsm);
+			std::vector<uint32_t> found;
+			if (fn.starts_with("0x")) {
+				const auto idx = index.FindFunction(std::stoull(fn, nullptr, 16));
+				if (idx != AsmIndex::NotFound)
+					found.push_back(idx);
+			}
+			else {
+				found = index.FindFunctions(fn);
+			}
+			if (found.empty())
+				throw std::runtime_error(std::format("function {} is not in asm index", fn));
+			for (auto idx : found)
+				printFunctionAsm(index, idx);
+		}
+		if (qCallers || qCallees || qReachable || qPoolXrefs || qStringXrefs || qFieldXrefs || qAsm)
+			return 0;
+
+		if (!infile)
+			throw args::ValidationError("infile is required");
+		if ((sigDbAdd || skipKnown) && !sigDb)
+			throw args::ValidationError("--sigdb-add and --skip-known need --sigdb");
 		auto& libappPath = args::get(infile);
 
-		std::filesystem::path outDir{ args::get(outdir) };
 		std::error_code ec;
 		if (!std::filesystem::create_directory(outDir, ec) && ec.value() != 0) {
 			std::cerr << "Failed to create output directory: " << ec.message() << "\n";
@@ -34,14 +193,57 @@ int main(int argc, char** argv)
 		app.LoadInfo();
 		app.ExitScope();
 
+		if (benchDecoder) {
+			const auto range = app.CodeRange();
+			A64::BenchmarkDecoder((const uint8_t*)app.base() + range.start, range.end - range.start, range.start);
+			return 0;
+		}
+
+		if (sigDb) {
+			PackageSignatures signatures{ args::get(sigDb) };
+			std::cout << std::format("Loaded {} known package signatures\n", signatures.NumSignatures());
+			signatures.Match(app);
+			if (sigDbAdd) {
+				signatures.Add(app, args::get(sigDbAdd));
+				signatures.Save();
+			}
+		}
+
 		app.EnterScope();
+		if (disasmAll) {
+			std::cout << "Disassembling the application code\n";
+			app.DisasmAllCode();
+		}
 #ifndef NO_CODE_ANALYSIS
 		std::cout << "Analyzing the application\n";
 		CodeAnalyzer analyzer{ app };
+		if (analysisCache)
+			analyzer.UseCache(args::get(analysisCache));
+		analyzer.SkipKnownPackages(skipKnown);
+		if (benchAnalysis)
+			analyzer.BenchmarkLargestFunctions(args::get(benchAnalysis));
 		analyzer.AnalyzeAll();
+		CallGraph::Create(app, outDir / "callgraph.bin");
+		FieldXrefs::Create(app, outDir / "fieldxrefs.bin");
 #endif
 
+		std::unique_ptr<OutputManifest> manifest;
+		if (incremental) {
+			manifest = std::make_unique<OutputManifest>(outDir);
+			OutputSink::UseManifest(manifest.get());
+		}
+		// binary index files above are not in archive. they are read back by queries
+		std::unique_ptr<ArchiveWriter> archive;
+		if (archiveName) {
+			archive = std::make_unique<ArchiveWriter>(outDir / args::get(archiveName));
+			OutputSink::UseArchive(archive.get(), outDir);
+		}
+
 		DartDumper dumper{ app };
+		if (typedDataLimit)
+			dumper.SetTypedDataLimit(args::get(typedDataLimit));
+		if (typedDataBin)
+			dumper.ExtractTypedData(outDir / "typed_data", args::get(typedDataBin));
 		std::cout << "Dumping Object Pool\n";
 		dumper.DumpObjectPool((outDir / "pp.txt").string().c_str());
 		dumper.DumpObjects((outDir / "objs.txt").string().c_str());
@@ -50,13 +252,30 @@ int main(int argc, char** argv)
 #else
 		std::cout << "Generating application functions in asm folder\n";
 #endif
-		dumper.DumpCode((outDir / "asm").string().c_str());
+		unsigned int numDumpThreads = dumpThreads ? args::get(dumpThreads) : 1;
+		if (numDumpThreads == 0)
+			numDumpThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		dumper.DumpCode((outDir / "asm").string().c_str(), numDumpThreads);
+#ifndef NO_CODE_ANALYSIS
+		PoolXrefs::Create(app, outDir / "poolxrefs.bin");
+#endif
 		dumper.Dump4Ida(outDir / "ida_script");
+		if (analysisDb)
+			AnalysisDbWriter::Create(app, outDir / "analysis.db", outDir / "callgraph.bin");
 
 		std::cout << "Generating Frida script\n";
 		FridaWriter fwriter{ app };
 		fwriter.Create((outDir / "blutter_frida.js").string().c_str());
 
+		if (archive) {
+			OutputSink::UseArchive(nullptr, {});
+			archive->Close();
+		}
+		if (manifest) {
+			OutputSink::UseManifest(nullptr);
+			manifest->Save();
+		}
+
 		app.ExitScope();
 	}
 	catch (args::Help&) {